@@ -25,10 +25,16 @@
 #include <string>
 #include <iostream>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <functional>
 #include "tbb/atomic.h"
 #include "tbb/task_scheduler_init.h"
 #include "tbb/tick_count.h"
 #include "tbb/flow_graph.h"
+#include "tbb/parallel_sort.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 #include "../../common/utility/utility.h"
 
 using namespace std;
@@ -59,6 +65,9 @@ bool silent = false;             // suppress all output except for time
 int num_bin_packers=-1;          // number of concurrent bin packers in operation; default is #threads;
                                  // larger values can result in more bins at less than full capacity
 size_type optimality=1;          // 1 (default) is highest the algorithm can obtain; larger numbers run faster
+bool engine = false;             // also pack with the first-fit-decreasing engine and compare
+bool no_graph = false;           // skip the flow graph packer, which is slow for large N
+int num_shards = 1;              // number of item ranges the engine packs concurrently before merging
 
 // Calculated globals
 size_type min_B;                 // lower bound on the optimal number of bins
@@ -221,6 +230,127 @@ public:
     }
 };
 
+//! Segment tree over the free capacity of bins, for first-fit queries in O(log n)
+/** Leaves are the bins in the order they are opened; every inner node holds the largest
+    free capacity below it.  Unopened bins are empty, so the first fit for an item that
+    fits no open bin is the next unopened one. */
+class bin_tree {
+    size_type leaves;
+    vector<value_type> free_cap;
+public:
+    bin_tree(size_type max_bins) : leaves(1) {
+        while (leaves < max_bins) leaves *= 2;
+        free_cap.assign(2*leaves, V);
+    }
+    //! Index of the first bin with at least x free capacity
+    size_type first_fit(value_type x) const {
+        size_type node = 1;
+        while (node < leaves)
+            node = free_cap[2*node] >= x ? 2*node : 2*node+1;
+        return node - leaves;
+    }
+    //! Put an item of size x into bin b
+    void add(size_type b, value_type x) {
+        size_type node = leaves + b;
+        free_cap[node] -= x;
+        for (node /= 2; node >= 1; node /= 2)
+            free_cap[node] = max(free_cap[2*node], free_cap[2*node+1]);
+    }
+};
+
+//! Packs n items, taken with the given stride from an array sorted in decreasing order, first fit
+/** Appends the load of every bin used to loads and, if bin_of is given, stores there the
+    bin of every item, counting from the first bin appended. */
+void ffd_pack(const value_type* items, size_type n, size_type stride, vector<value_type>& loads,
+              size_type* bin_of = NULL) {
+    bin_tree tree(n);
+    const size_type base = loads.size();
+    for (size_type i=0; i<n; ++i) {
+        value_type x = items[i*stride];
+        size_type b = tree.first_fit(x);
+        tree.add(b, x);
+        if (base+b == loads.size())
+            loads.push_back(0);
+        loads[base+b] += x;
+        if (bin_of) bin_of[i] = b;
+    }
+}
+
+//! Threshold below which bin_filler considers a bin ill-utilized
+value_type well_utilized_load() {
+    return value_type(V/(1+optimality*.1));
+}
+
+//! Packs every shard of the sorted items into bins of its own
+/** Shard s takes every num_shards-th item from item s, so each shard sees the same mix of
+    sizes.  The items of the ill-utilized bins of a shard are handed back for the merge. */
+class shard_packer {
+    const value_type* my_items;
+    vector<value_type>* my_loads;
+    vector<value_type>* my_rest;
+public:
+    shard_packer(const value_type* items, vector<value_type>* loads, vector<value_type>* rest) :
+        my_items(items), my_loads(loads), my_rest(rest) {}
+    void operator()(const blocked_range<int>& r) const {
+        const value_type well_utilized = well_utilized_load();
+        for (int s=r.begin(); s!=r.end(); ++s) {
+            size_type n = (N - s + num_shards - 1) / num_shards;
+            vector<size_type> bin_of(n);
+            vector<value_type>& loads = my_loads[s];
+            ffd_pack(my_items + s, n, num_shards, loads, n ? &bin_of[0] : NULL);
+            for (size_type i=0; i<n; ++i)
+                if (loads[bin_of[i]] < well_utilized)
+                    my_rest[s].push_back(my_items[s + i*num_shards]);
+        }
+    }
+};
+
+//! Summary of a packing, in the terms of bin_printer
+struct packing_summary {
+    size_type bins;
+    value_type total, min_load, max_load;
+    packing_summary() : bins(0), total(0), min_load(V), max_load(0) {}
+    void add(value_type load) {
+        ++bins;
+        total += load;
+        if (load < min_load) min_load = load;
+        if (load > max_load) max_load = load;
+    }
+};
+
+//! First-fit-decreasing packing of input_array, in num_shards concurrent shards if more than one
+packing_summary ffd_engine() {
+    vector<value_type> items(input_array, input_array+N);
+    tbb::parallel_sort(items.begin(), items.end(), std::greater<value_type>());
+
+    packing_summary result;
+    vector<value_type> rest;
+    if (num_shards <= 1 || size_type(num_shards) > N) {
+        rest.swap(items);
+    } else {
+        vector< vector<value_type> > loads(num_shards), shard_rest(num_shards);
+        parallel_for(blocked_range<int>(0, num_shards), shard_packer(&items[0], &loads[0], &shard_rest[0]));
+
+        // Merge: keep the well-utilized bins of every shard and repack the items of the
+        // others together.  These are the last bins of a shard, which hold small items only.
+        const value_type well_utilized = well_utilized_load();
+        for (int s=0; s<num_shards; ++s) {
+            for (size_type b=0; b<loads[s].size(); ++b)
+                if (loads[s][b] >= well_utilized)
+                    result.add(loads[s][b]);
+            rest.insert(rest.end(), shard_rest[s].begin(), shard_rest[s].end());
+        }
+        sort(rest.begin(), rest.end(), std::greater<value_type>());
+    }
+
+    vector<value_type> loads;
+    if (!rest.empty())
+        ffd_pack(&rest[0], rest.size(), 1, loads);
+    for (size_type b=0; b<loads.size(); ++b)
+        result.add(loads[b]);
+    return result;
+}
+
 int get_default_num_threads() {
     static int threads = 0;
     if (threads == 0)
@@ -243,7 +373,11 @@ int main(int argc, char *argv[]) {
                                           "(default=#threads)")
                                      .arg(optimality,"optimality","controls optimality of solution; 1 is highest, use\n"
                                           "              larger numbers for less optimal but faster solution")
+                                     .arg(engine,"engine","    also pack with the first-fit-decreasing engine and compare")
+                                     .arg(num_shards,"shards","    number of item ranges the engine packs concurrently")
+                                     .arg(no_graph,"no-graph","  skip the flow graph packer; implies engine")
         );
+        if (no_graph) engine = true;
 
         if (silent) verbose = false;  // make silent override verbose
         // Generate random input data
@@ -259,35 +393,56 @@ int main(int argc, char *argv[]) {
         tick_count start = tick_count::now();
         for(int p = threads.first; p <= threads.last; p = threads.step(p)) {
             task_scheduler_init init(p);
-            packed_sum = 0;
-            packed_items = 0;
-            B = 0;
-            if (num_bin_packers == -1) num_bin_packers = p;
-            active_bins = num_bin_packers;
-            if (!silent)
-                cout << "binpack running with " << item_sum << " capacity over " << N << " items, optimality="
-                     << optimality << ", " << num_bin_packers << " bins of capacity=" << V << " on " << p
-                     << " threads.\n";
-            graph g;
-            value_source the_source(g, item_generator(), false);
-            value_pool the_value_pool(g);
-            make_edge(the_source, the_value_pool);
-            bin_buffer the_bin_buffer(g);
-            bins = new bin_packer*[num_bin_packers];
-            for (int i=0; i<num_bin_packers; ++i) {
-                bins[i] = new bin_packer(g, 1, bin_filler(i, &the_value_pool));
-                make_edge(the_value_pool, *(bins[i]));
-                make_edge(output_port<0>(*(bins[i])), the_value_pool);
-                make_edge(output_port<1>(*(bins[i])), the_bin_buffer);
+            tick_count graph_start = tick_count::now();
+            if (!no_graph) {
+                packed_sum = 0;
+                packed_items = 0;
+                B = 0;
+                if (num_bin_packers == -1) num_bin_packers = p;
+                active_bins = num_bin_packers;
+                if (!silent)
+                    cout << "binpack running with " << item_sum << " capacity over " << N << " items, optimality="
+                         << optimality << ", " << num_bin_packers << " bins of capacity=" << V << " on " << p
+                         << " threads.\n";
+                graph g;
+                value_source the_source(g, item_generator(), false);
+                value_pool the_value_pool(g);
+                make_edge(the_source, the_value_pool);
+                bin_buffer the_bin_buffer(g);
+                bins = new bin_packer*[num_bin_packers];
+                for (int i=0; i<num_bin_packers; ++i) {
+                    bins[i] = new bin_packer(g, 1, bin_filler(i, &the_value_pool));
+                    make_edge(the_value_pool, *(bins[i]));
+                    make_edge(output_port<0>(*(bins[i])), the_value_pool);
+                    make_edge(output_port<1>(*(bins[i])), the_bin_buffer);
+                }
+                bin_writer the_writer(g, 1, bin_printer());
+                make_edge(the_bin_buffer, the_writer);
+                the_source.activate();
+                g.wait_for_all();
+                for (int i=0; i<num_bin_packers; ++i) {
+                    delete bins[i];
+                }
+                delete[] bins;
             }
-            bin_writer the_writer(g, 1, bin_printer());
-            make_edge(the_bin_buffer, the_writer);
-            the_source.activate();
-            g.wait_for_all();
-            for (int i=0; i<num_bin_packers; ++i) {
-                delete bins[i];
+            if (engine) {
+                tick_count engine_start = tick_count::now();
+                packing_summary ps = ffd_engine();
+                tick_count engine_end = tick_count::now();
+                if (ps.total != item_sum) {
+                    cerr << "engine packed " << ps.total << " of " << item_sum << " capacity\n";
+                    return 1;
+                }
+                if (!silent) {
+                    if (!no_graph)
+                        cout << "graph:  " << B << " bins, " << N/(engine_start-graph_start).seconds()
+                             << " items/sec\n";
+                    cout << "engine: " << ps.bins << " bins, " << N/(engine_end-engine_start).seconds()
+                         << " items/sec with " << num_shards << " shard(s) on " << p << " threads"
+                         << "\n        Avg size: " << (double)ps.total/ps.bins << "; Max size: " << ps.max_load
+                         << "; Min size: " << ps.min_load << "; Lower bound on optimal #bins: " << min_B << endl;
+                }
             }
-            delete[] bins;
         }
         utility::report_elapsed_time((tick_count::now() - start).seconds());
         delete[] input_array;
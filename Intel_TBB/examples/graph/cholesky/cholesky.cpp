@@ -24,14 +24,16 @@
 #include <cmath>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <cassert>
 
-#include "mkl_lapack.h"
-#include "mkl.h"
+#include "kernels.h"
 
 #include "tbb/tbb_config.h"
 #include "tbb/flow_graph.h"
 #include "tbb/tick_count.h"
 #include "tbb/task_scheduler_init.h"
+#include "tbb/cache_aligned_allocator.h"
 
 // Application command line arguments parsing
 #include "../../common/utility/utility.h"
@@ -62,60 +64,88 @@ void matrix_write ( double *A, int n, const char *fname, bool is_triangular = fa
  GLOBAL VARIABLES
 ************************************************************/
 bool g_benchmark_run = false;
+bool g_kernel_run = false;
 int g_num_tbb_threads = tbb::task_scheduler_init::default_num_threads();
 int g_n = -1, g_b = -1, g_num_trials = 1;
 char *g_input_file_name = NULL;
 char *g_output_prefix = NULL;
 std::string g_alg_name;
 
-// Creates tiled array
-static double ***create_tile_array( double *A, int n, int b ) {
-    const int p = n/b;
-    double ***tile = (double ***)calloc( sizeof( double ** ), p );
+// Lower triangular tiles of the matrix packed into one cache-aligned buffer.
+// Tile (j,i), i >= j, is block column j, block row i; tiles are stored
+// column by column and each tile is column-major with leading dimension b.
+class tile_matrix {
+    int p;
+    int b;
+    size_t size;
+    double *data;
 
-    for ( int j = 0; j < p; ++j ) {
-        tile[j] = (double **)calloc( sizeof( double * ), p );
+    tile_matrix( const tile_matrix& );
+    tile_matrix& operator=( const tile_matrix& );
+public:
+    tile_matrix( int p_, int b_ ) : p(p_), b(b_), size(size_t(p)*(p+1)/2*b*b) {
+        data = tbb::cache_aligned_allocator<double>().allocate( size );
     }
+    ~tile_matrix() {
+        tbb::cache_aligned_allocator<double>().deallocate( data, size );
+    }
+    double *operator()( int j, int i ) const {
+        assert( j <= i && i < p );
+        return data + ( size_t(j)*p - size_t(j)*(j-1)/2 + (i-j) )*b*b;
+    }
+};
+
+// Creates tiled array
+static tile_matrix *create_tile_array( double *A, int n, int b ) {
+    const int p = n/b;
+    tile_matrix *tile = new tile_matrix( p, b );
 
     for ( int j = 0; j < p; ++j ) {
-        for ( int i = 0; i < p; ++i ) {
-            double *temp_block = (double *)calloc( sizeof( double ), b*b );
+        for ( int i = j; i < p; ++i ) {
+            double *temp_block = (*tile)( j, i );
 
             for ( int A_j = j*b, T_j = 0; T_j < b; ++A_j, ++T_j ) {
                 for ( int A_i = i*b, T_i = 0; T_i < b; ++A_i, ++T_i ) {
                     temp_block[T_j*b+T_i] = A[A_j*n+A_i];
                 }
             }
-
-            tile[j][i] = temp_block;
         }
     }
     return tile;
 }
 
-static void collapse_tile_array( double ***tile, double *A, int n, int b ) {
+static void collapse_tile_array( tile_matrix *tile, double *A, int n, int b ) {
     const int p = n/b;
 
     for ( int j = 0; j < p; ++j ) {
         for ( int i = 0; i < p; ++i ) {
-            double *temp_block = tile[j][i];
+            if ( i < j ) {
+                // Upper tiles are not stored
+                for ( int A_j = j*b, T_j = 0; T_j < b; ++A_j, ++T_j ) {
+                    memset( A + A_j*n + i*b, 0, sizeof( double )*b );
+                }
+                continue;
+            }
+
+            double *temp_block = (*tile)( j, i );
 
             for ( int A_j = j*b, T_j = 0; T_j < b; ++A_j, ++T_j ) {
                 for ( int A_i = i*b, T_i = 0; T_i < b; ++A_i, ++T_i ) {
                     A[A_j*n+A_i] = temp_block[T_j*b+T_i];
                 }
             }
-
-            free( temp_block );
-            tile[j][i] = NULL;
         }
-
-        free( tile[j] );
     }
 
-    free( tile );
+    delete tile;
 }
 
+// Flop counts of the tile kernels and of the whole factorization
+static double potrf_flops( int n ) { return double(n)*n*n/3.0; }
+static double trsm_flops( int n ) { return double(n)*n*n; }
+static double syrk_flops( int n ) { return double(n)*n*n; }
+static double gemm_flops( int n ) { return 2.0*n*n*n; }
+
 /************************************************************
  Helper base class: algorithm
 ************************************************************/
@@ -125,17 +155,14 @@ class algorithm {
     bool is_tiled;
 
     bool check_if_valid( double *A0, double *C, double *A, int n ) {
-        char transa = 'n', transb = 't';
-        double alpha = 1;
-        double beta = 0;
-
         for ( int i = 0; i < n; ++i ) {
             for ( int j = i+1; j < n; ++j ) {
                 A0[j*n+i] = 0.;
             }
         }
 
-        dgemm ( &transa, &transb, &n, &n, &n, &alpha, A0, &n, A0, &n, &beta, C, &n );
+        memset( C, 0, sizeof( double )*n*n );
+        kernel_dgemm_nt( n, n, n, 1.0, A0, n, A0, n, C, n );
 
         for ( int j = 0; j < n; ++j ) {
             for ( int i = 0; i < n; ++i ) {
@@ -163,7 +190,7 @@ public:
 
         for ( int t = 0; t < trials+1; ++t ) {
             if ( is_tiled ) {
-                double ***tile = create_tile_array( A, n, b );
+                tile_matrix *tile = create_tile_array( A, n, b );
                 t0 = tbb::tick_count::now();
                 func( tile, n, b );
                 t1 = tbb::tick_count::now();
@@ -197,7 +224,8 @@ public:
             matrix_write( A0, g_n, s.c_str(), true );
         }
 
-        printf( "%s %d %d %d %d %lf %lf\n", name.c_str(), g_num_tbb_threads, trials, n, b, elapsed_time, elapsed_time/trials );
+        printf( "%s %d %d %d %d %lf %lf %.2lf GFLOP/s\n", name.c_str(), g_num_tbb_threads, trials, n, b, elapsed_time, elapsed_time/trials,
+            trials*potrf_flops( n )/elapsed_time*1e-9 );
         free( A0 );
         free( C );
         return elapsed_time;
@@ -210,37 +238,29 @@ protected:
 
 /***********************************************************/
 
-static void call_dpotf2( double ***tile, int b, int k ) {
-    double *A_block = tile[k][k];
-    char uplo = 'l';
-    int info = 0;
-    dpotf2( &uplo, &b, A_block, &b, &info ); 
+static void call_dpotf2( tile_matrix *tile, int b, int k ) {
+    double *A_block = (*tile)( k, k );
+    kernel_dpotrf_l( b, A_block, b );
     return;
 }
 
-static void call_dtrsm( double ***tile, int b, int k, int j ) {
-    double *A_block = tile[k][j];
-    double *L_block = tile[k][k];
-    char uplo = 'l', side = 'r', transa = 't', diag = 'n';
-    double alpha = 1;
-    dtrsm( &side, &uplo, &transa, &diag, &b, &b, &alpha, L_block, &b, A_block, &b );
+static void call_dtrsm( tile_matrix *tile, int b, int k, int j ) {
+    double *A_block = (*tile)( k, j );
+    double *L_block = (*tile)( k, k );
+    kernel_dtrsm_rltn( b, b, L_block, b, A_block, b );
     return;
 }
 
-static void call_dsyr2k( double ***tile, int b, int k, int j, int i ) {
-    double *A_block = tile[i][j];
-    char transa = 'n', transb = 't';
-    char uplo = 'l';
-    double alpha = -1;
-    double beta = 1;
+static void call_dsyr2k( tile_matrix *tile, int b, int k, int j, int i ) {
+    double *A_block = (*tile)( i, j );
 
     if ( i == j ) {   // Diagonal block
-        double *L_block = tile[k][i];
-        dsyrk( &uplo, &transa, &b, &b, &alpha, L_block, &b, &beta, A_block, &b );
+        double *L_block = (*tile)( k, i );
+        kernel_dsyrk_ln( b, b, -1.0, L_block, b, A_block, b );
     } else {   // Non-diagonal block
-        double *L2_block = tile[k][i];
-        double *L1_block = tile[k][j];
-        dgemm( &transa, &transb, &b, &b, &b, &alpha, L1_block, &b, L2_block, &b, &beta, A_block, &b );
+        double *L2_block = (*tile)( k, i );
+        double *L1_block = (*tile)( k, j );
+        kernel_dgemm_nt( b, b, b, -1.0, L1_block, b, L2_block, b, A_block, b );
     }
     return;
 }
@@ -252,7 +272,7 @@ public:
 
 protected:
     virtual void func( void * ptr, int n, int b ) {
-        double ***tile = (double ***)ptr;
+        tile_matrix *tile = (tile_matrix *)ptr;
         const int p = n/b;
 
         for ( int k = 0; k < p; ++k ) {
@@ -277,10 +297,7 @@ public:
 protected:
     virtual void func( void * ptr, int n, int /* b */ ) {
         double *A = (double *)ptr;
-        int lda = n;
-        int info = 0;
-        char uplo = 'l';
-        dpotrf( &uplo, &n, A, &lda, &info );
+        kernel_dpotrf_l( n, A, n );
     }
 };
 
@@ -319,9 +336,7 @@ public:
         tag_t t;
         t.tag = 0;
         t.a[0] = k;
-        char uplo = 'l';
-        int info = 0;
-        dpotf2( &uplo, &b, A_block, &b, &info );
+        kernel_dpotrf_l( b, A_block, b );
 
         // Send to dtrsms in same column
         // k == k  j == k 
@@ -351,9 +366,7 @@ public:
         tag_t t;
         t.tag = 0;
         t.a[0] = k;
-        char uplo = 'l', side = 'r', transa = 't', diag = 'n';
-        double alpha = 1;
-        dtrsm( &side, &uplo, &transa, &diag, &b, &b, &alpha, L_block, &b, A_block, &b);
+        kernel_dtrsm_rltn( b, b, L_block, b, A_block, b );
 
         // Send to rest of my row
         t.a[1] = j;
@@ -382,10 +395,6 @@ public:
 
         tag_t t;
         t.tag = 0;
-        char transa = 'n', transb = 't';
-        char uplo = 'l';
-        double alpha = -1;
-        double beta = 1;
 
         tagged_tile_t in0 = get<0>( in );
         tagged_tile_t in1 = get<1>( in );
@@ -397,11 +406,11 @@ public:
         tile_t A_block = in2.second; 
         if ( i == j ) {   // Diagonal block
             tile_t L_block = in0.second;
-            dsyrk( &uplo, &transa, &b, &b, &alpha, L_block, &b, &beta, A_block, &b );
+            kernel_dsyrk_ln( b, b, -1.0, L_block, b, A_block, b );
         } else {   // Non-diagonal block
             tile_t L1_block = in0.second;
             tile_t L2_block = in1.second;
-            dgemm( &transa, &transb, &b, &b, &b, &alpha, L1_block, &b, L2_block, &b, &beta, A_block, &b );
+            kernel_dgemm_nt( b, b, b, -1.0, L1_block, b, L2_block, b, A_block, b );
         }
 
         // All outputs flow to next step
@@ -446,7 +455,7 @@ protected:
         using tbb::flow::output_port;
         using tbb::flow::input_port;
 
-        double ***tile = (double ***)ptr;
+        tile_matrix *tile = (tile_matrix *)ptr;
         const int p = n/b;
         tbb::flow::graph g;
 
@@ -476,13 +485,13 @@ protected:
 
         // Send to feedback input of first dpotf2
         // k == 0, j == 0, i == 0
-        dpotf2_node.try_put( std::make_pair( t, tile[0][0] ) );
+        dpotf2_node.try_put( std::make_pair( t, (*tile)( 0, 0 ) ) );
 
         // Send to feedback input (port 1) of each dtrsm
         // k == 0, j == 1..p-1
         for ( int j = 1; j < p; ++j ) {
             t.a[1] = j;
-            input_port<1>( dtrsm_join ).try_put( std::make_pair( t, tile[0][j] ) );
+            input_port<1>( dtrsm_join ).try_put( std::make_pair( t, (*tile)( 0, j ) ) );
         }
 
         // Send to feedback input (port 2) of each dsyr2k
@@ -492,7 +501,7 @@ protected:
 
             for ( int j = i; j < p; ++j ) {
                 t.a[1] = j;
-                input_port<2>( dsyr2k_join ).try_put( std::make_pair( t, tile[i][j] ) );
+                input_port<2>( dsyr2k_join ).try_put( std::make_pair( t, (*tile)( i, j ) ) );
             }
         }
 
@@ -515,10 +524,10 @@ typedef continue_type * continue_ptr_type;
 // Using helper functor classes (instead of built-in C++ 11 lambda functions)
 class call_dpotf2_functor
 {
-    double ***tile;
+    tile_matrix *tile;
     int b, k;
 public:
-    call_dpotf2_functor( double ***tile_, int b_, int k_ )
+    call_dpotf2_functor( tile_matrix *tile_, int b_, int k_ )
         : tile(tile_), b(b_), k(k_) {}
 
     void operator()( const tbb::flow::continue_msg & ) { call_dpotf2( tile, b, k ); }
@@ -526,10 +535,10 @@ public:
 
 class call_dtrsm_functor
 {
-    double ***tile;
+    tile_matrix *tile;
     int b, k, j;
 public:
-    call_dtrsm_functor( double ***tile_, int b_, int k_, int j_ )
+    call_dtrsm_functor( tile_matrix *tile_, int b_, int k_, int j_ )
         : tile(tile_), b(b_), k(k_), j(j_) {}
 
     void operator()( const tbb::flow::continue_msg & ) { call_dtrsm( tile, b, k, j ); }
@@ -537,10 +546,10 @@ public:
 
 class call_dsyr2k_functor
 {
-    double ***tile;
+    tile_matrix *tile;
     int b, k, j, i;
 public:
-    call_dsyr2k_functor( double ***tile_, int b_, int k_, int j_, int i_ )
+    call_dsyr2k_functor( tile_matrix *tile_, int b_, int k_, int j_, int i_ )
         : tile(tile_), b(b_), k(k_), j(j_), i(i_) {}
 
     void operator()( const tbb::flow::continue_msg & ) { call_dsyr2k( tile, b, k, j, i ); }
@@ -555,7 +564,7 @@ public:
 
 protected:
     virtual void func( void * ptr, int n, int b ) {
-        double ***tile = (double ***)ptr;
+        tile_matrix *tile = (tile_matrix *)ptr;
 
         const int p = n/b;
         continue_ptr_type *c = new continue_ptr_type[p];
@@ -638,6 +647,7 @@ bool process_args( int argc, char *argv[] ) {
 
         .arg( g_input_file_name, "input_file", "if provided it will be read to get the input matrix" )
         .arg( g_benchmark_run, "-x", "skips all validation" )
+        .arg( g_kernel_run, "-k", "reports GFLOP/s of the tile kernels for tile sizes up to blocksize" )
     );
 
     if ( g_n > 46000 ) {
@@ -663,6 +673,67 @@ bool process_args( int argc, char *argv[] ) {
     return true;
 }
 
+/************************************************************
+ Tile kernel benchmark
+************************************************************/
+
+static void benchmark_kernel( const char *name, int b, double flops, double *A, const double *A0, double *L, double *C ) {
+    // Repeat so that each measurement does at least ~1 GFLOP of work
+    const int reps = std::max( 1, int( 1e9/flops ) );
+    double elapsed_time = 0.0;
+
+    for ( int r = 0; r < reps; ++r ) {
+        memcpy( A, A0, sizeof( double )*b*b );
+        tbb::tick_count t0 = tbb::tick_count::now();
+        switch ( name[0] ) {
+        case 'p': kernel_dpotrf_l( b, A, b ); break;
+        case 't': kernel_dtrsm_rltn( b, b, L, b, A, b ); break;
+        case 's': kernel_dsyrk_ln( b, b, -1.0, L, b, A, b ); break;
+        default:  kernel_dgemm_nt( b, b, b, -1.0, L, b, C, b, A, b ); break;
+        }
+        elapsed_time += (tbb::tick_count::now()-t0).seconds();
+    }
+
+    printf( "%s %d %d %lf %.2lf GFLOP/s\n", name, b, reps, elapsed_time/reps, reps*flops/elapsed_time*1e-9 );
+}
+
+static void benchmark_tile_kernels( int max_b ) {
+    std::vector<int> sizes;
+    for ( int b = 16; b < max_b; b *= 2 ) {
+        sizes.push_back( b );
+    }
+    sizes.push_back( max_b );
+
+    for ( size_t s = 0; s < sizes.size(); ++s ) {
+        const int b = sizes[s];
+        double *A0 = NULL;
+        int n = b;
+        matrix_init( A0, n, NULL );
+
+        double *A = (double *)calloc( sizeof( double ), b*b );
+        double *L = (double *)calloc( sizeof( double ), b*b );
+        double *C = (double *)calloc( sizeof( double ), b*b );
+        memcpy( L, A0, sizeof( double )*b*b );
+        kernel_dpotrf_l( b, L, b );
+        for ( int j = 0; j < b; ++j ) {
+            for ( int i = 0; i < b; ++i ) {
+                C[j*b+i] = i < j ? 0.0 : L[j*b+i];
+                L[j*b+i] = C[j*b+i];
+            }
+        }
+
+        benchmark_kernel( "potrf", b, potrf_flops( b ), A, A0, L, C );
+        benchmark_kernel( "trsm", b, trsm_flops( b ), A, A0, L, C );
+        benchmark_kernel( "syrk", b, syrk_flops( b ), A, A0, L, C );
+        benchmark_kernel( "gemm", b, gemm_flops( b ), A, A0, L, C );
+
+        free( A0 );
+        free( A );
+        free( L );
+        free( C );
+    }
+}
+
 int main(int argc, char *argv[]) {
     typedef std::map< std::string, algorithm * > algmap_t;
     algmap_t algmap;
@@ -679,6 +750,12 @@ int main(int argc, char *argv[]) {
     }
 
     tbb::task_scheduler_init init( g_num_tbb_threads );
+
+    if ( g_kernel_run ) {
+        benchmark_tile_kernels( g_b );
+        return 0;
+    }
+
     double *A = NULL;
 
     // Read input matrix
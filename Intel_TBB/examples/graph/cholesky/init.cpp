@@ -22,17 +22,15 @@
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
-#include <mkl_cblas.h>
+
+#include "kernels.h"
 
 static void posdef_gen( double * A, int n )
 {
-    /* Allocate memory for the matrix and its transpose */
+    /* Allocate memory for the matrix */
     double *L = (double *)calloc( sizeof( double ), n*n );
     assert( L );
 
-    double *LT = (double *)calloc( sizeof( double ), n*n) ;
-    assert( LT );
-
     memset( A, 0, sizeof( double )*n*n );
 
     /* Generate a conditioned matrix and fill it with random numbers */
@@ -45,16 +43,10 @@ static void posdef_gen( double * A, int n )
         L[j*n+j] = 1;
     }
 
-    /* Compute transpose of the matrix */
-    for ( int i = 0; i < n; ++i ) {
-        for ( int j = 0; j < n; ++j ) {
-            LT[j*n+i] = L[i*n+j];
-        }
-    }
-    cblas_dgemm( CblasColMajor, CblasNoTrans, CblasNoTrans, n, n, n, 1, L, n, LT, n, 0, A, n );
+    /* A = L*L^T */
+    kernel_dgemm_nt( n, n, n, 1, L, n, L, n, A, n );
 
     free( L );
-    free( LT );
 }
 
 // Read the matrix from the input file
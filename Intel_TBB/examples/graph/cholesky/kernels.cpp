@@ -0,0 +1,234 @@
+/*
+    Copyright 2005-2016 Intel Corporation.  All Rights Reserved.
+
+    This file is part of Threading Building Blocks. Threading Building Blocks is free software;
+    you can redistribute it and/or modify it under the terms of the GNU General Public License
+    version 2  as  published  by  the  Free Software Foundation.  Threading Building Blocks is
+    distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+    implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See  the GNU General Public License for more details.   You should have received a copy of
+    the  GNU General Public License along with Threading Building Blocks; if not, write to the
+    Free Software Foundation, Inc.,  51 Franklin St,  Fifth Floor,  Boston,  MA 02110-1301 USA
+
+    As a special exception,  you may use this file  as part of a free software library without
+    restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+    functions from this file, or you compile this file and link it with other files to produce
+    an executable,  this file does not by itself cause the resulting executable to be covered
+    by the GNU General Public License. This exception does not however invalidate any other
+    reasons why the executable file might be covered by the GNU General Public License.
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#if __AVX2__ && __FMA__
+#include <immintrin.h>
+#endif
+
+#include "kernels.h"
+
+// Register block of the GEMM micro-kernel: MR rows of C by NR columns.
+static const int MR = 8;
+static const int NR = 4;
+
+// Depth of one pass over k, chosen so that the MR x KC and NR x KC
+// panels of A and B stay in L1 while the MR x NR block of C lives in registers.
+static const int KC = 256;
+
+// Column block used by the blocked triangular solve and factorization.
+static const int NB = 32;
+
+// C(0:mr,0:nr) += alpha*A(0:mr,0:k)*B(0:nr,0:k)^T for edge blocks
+static void gemm_nt_small( int mr, int nr, int k, double alpha,
+                           const double *A, int lda, const double *B, int ldb, double *C, int ldc ) {
+    for ( int j = 0; j < nr; ++j ) {
+        double *c = C + j*ldc;
+        for ( int p = 0; p < k; ++p ) {
+            const double *a = A + p*lda;
+            const double bjp = alpha*B[p*ldb+j];
+            for ( int i = 0; i < mr; ++i ) {
+                c[i] += a[i]*bjp;
+            }
+        }
+    }
+}
+
+// MR x NR micro-kernel: accumulates in registers, then C += alpha*acc
+static void gemm_nt_micro( int k, double alpha,
+                           const double *A, int lda, const double *B, int ldb, double *C, int ldc ) {
+#if __AVX2__ && __FMA__
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c02 = _mm256_setzero_pd(), c03 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd(), c12 = _mm256_setzero_pd(), c13 = _mm256_setzero_pd();
+
+    for ( int p = 0; p < k; ++p ) {
+        const double *a = A + p*lda;
+        const double *b = B + p*ldb;
+        __m256d a0 = _mm256_loadu_pd( a );
+        __m256d a1 = _mm256_loadu_pd( a+4 );
+        __m256d bj = _mm256_broadcast_sd( b );
+        c00 = _mm256_fmadd_pd( a0, bj, c00 );
+        c10 = _mm256_fmadd_pd( a1, bj, c10 );
+        bj = _mm256_broadcast_sd( b+1 );
+        c01 = _mm256_fmadd_pd( a0, bj, c01 );
+        c11 = _mm256_fmadd_pd( a1, bj, c11 );
+        bj = _mm256_broadcast_sd( b+2 );
+        c02 = _mm256_fmadd_pd( a0, bj, c02 );
+        c12 = _mm256_fmadd_pd( a1, bj, c12 );
+        bj = _mm256_broadcast_sd( b+3 );
+        c03 = _mm256_fmadd_pd( a0, bj, c03 );
+        c13 = _mm256_fmadd_pd( a1, bj, c13 );
+    }
+
+    const __m256d va = _mm256_set1_pd( alpha );
+    _mm256_storeu_pd( C,         _mm256_fmadd_pd( va, c00, _mm256_loadu_pd( C ) ) );
+    _mm256_storeu_pd( C+4,       _mm256_fmadd_pd( va, c10, _mm256_loadu_pd( C+4 ) ) );
+    _mm256_storeu_pd( C+ldc,     _mm256_fmadd_pd( va, c01, _mm256_loadu_pd( C+ldc ) ) );
+    _mm256_storeu_pd( C+ldc+4,   _mm256_fmadd_pd( va, c11, _mm256_loadu_pd( C+ldc+4 ) ) );
+    _mm256_storeu_pd( C+2*ldc,   _mm256_fmadd_pd( va, c02, _mm256_loadu_pd( C+2*ldc ) ) );
+    _mm256_storeu_pd( C+2*ldc+4, _mm256_fmadd_pd( va, c12, _mm256_loadu_pd( C+2*ldc+4 ) ) );
+    _mm256_storeu_pd( C+3*ldc,   _mm256_fmadd_pd( va, c03, _mm256_loadu_pd( C+3*ldc ) ) );
+    _mm256_storeu_pd( C+3*ldc+4, _mm256_fmadd_pd( va, c13, _mm256_loadu_pd( C+3*ldc+4 ) ) );
+#else
+    double acc[NR][MR] = { { 0 } };
+    for ( int p = 0; p < k; ++p ) {
+        const double *a = A + p*lda;
+        const double *b = B + p*ldb;
+        for ( int j = 0; j < NR; ++j ) {
+            for ( int i = 0; i < MR; ++i ) {
+                acc[j][i] += a[i]*b[j];
+            }
+        }
+    }
+    for ( int j = 0; j < NR; ++j ) {
+        for ( int i = 0; i < MR; ++i ) {
+            C[j*ldc+i] += alpha*acc[j][i];
+        }
+    }
+#endif
+}
+
+void kernel_dgemm_nt( int m, int n, int k, double alpha,
+                      const double *A, int lda, const double *B, int ldb, double *C, int ldc ) {
+    for ( int pc = 0; pc < k; pc += KC ) {
+        const int kc = std::min( KC, k-pc );
+        const double *Ap = A + pc*lda;
+        const double *Bp = B + pc*ldb;
+
+        for ( int jc = 0; jc < n; jc += NR ) {
+            const int nr = std::min( NR, n-jc );
+            for ( int ic = 0; ic < m; ic += MR ) {
+                const int mr = std::min( MR, m-ic );
+                if ( mr == MR && nr == NR )
+                    gemm_nt_micro( kc, alpha, Ap+ic, lda, Bp+jc, ldb, C+jc*ldc+ic, ldc );
+                else
+                    gemm_nt_small( mr, nr, kc, alpha, Ap+ic, lda, Bp+jc, ldb, C+jc*ldc+ic, ldc );
+            }
+        }
+    }
+}
+
+void kernel_dsyrk_ln( int n, int k, double alpha, const double *A, int lda, double *C, int ldc ) {
+    for ( int pc = 0; pc < k; pc += KC ) {
+        const int kc = std::min( KC, k-pc );
+        const double *Ap = A + pc*lda;
+
+        for ( int jc = 0; jc < n; jc += NR ) {
+            const int nr = std::min( NR, n-jc );
+
+            // The block on the diagonal goes through a scratch block so the upper triangle stays intact
+            const int diag_rows = std::min( MR, n-jc );
+            double diag[NR*MR] = { 0 };
+            if ( diag_rows == MR && nr == NR )
+                gemm_nt_micro( kc, alpha, Ap+jc, lda, Ap+jc, lda, diag, MR );
+            else
+                gemm_nt_small( diag_rows, nr, kc, alpha, Ap+jc, lda, Ap+jc, lda, diag, MR );
+            for ( int j = 0; j < nr; ++j ) {
+                double *c = C + (jc+j)*ldc + jc;
+                for ( int i = j; i < diag_rows; ++i ) {
+                    c[i] += diag[j*MR+i];
+                }
+            }
+
+            // Everything below it is a plain GEMM
+            for ( int ic = jc+MR; ic < n; ic += MR ) {
+                const int mr = std::min( MR, n-ic );
+                if ( mr == MR && nr == NR )
+                    gemm_nt_micro( kc, alpha, Ap+ic, lda, Ap+jc, lda, C+jc*ldc+ic, ldc );
+                else
+                    gemm_nt_small( mr, nr, kc, alpha, Ap+ic, lda, Ap+jc, lda, C+jc*ldc+ic, ldc );
+            }
+        }
+    }
+}
+
+void kernel_dtrsm_rltn( int m, int n, const double *L, int ldl, double *A, int lda ) {
+    for ( int jb = 0; jb < n; jb += NB ) {
+        const int nb = std::min( NB, n-jb );
+
+        // Solve the column block in place, one column at a time
+        for ( int j = jb; j < jb+nb; ++j ) {
+            double *x = A + j*lda;
+            const double r = 1.0/L[j*ldl+j];
+            for ( int i = 0; i < m; ++i ) {
+                x[i] *= r;
+            }
+            for ( int j2 = j+1; j2 < jb+nb; ++j2 ) {
+                double *y = A + j2*lda;
+                const double l = L[j*ldl+j2];
+                for ( int i = 0; i < m; ++i ) {
+                    y[i] -= l*x[i];
+                }
+            }
+        }
+
+        // Update the remaining columns with the solved block
+        if ( jb+nb < n ) {
+            kernel_dgemm_nt( m, n-jb-nb, nb, -1.0, A+jb*lda, lda, L+jb*ldl+jb+nb, ldl, A+(jb+nb)*lda, lda );
+        }
+    }
+}
+
+// Unblocked right-looking factorization of a small diagonal block
+static int potf2_l( int n, double *A, int lda ) {
+    for ( int j = 0; j < n; ++j ) {
+        double *a = A + j*lda;
+        if ( !(a[j] > 0.0) ) {
+            return j+1;
+        }
+        const double d = std::sqrt( a[j] );
+        a[j] = d;
+        const double r = 1.0/d;
+        for ( int i = j+1; i < n; ++i ) {
+            a[i] *= r;
+        }
+        for ( int j2 = j+1; j2 < n; ++j2 ) {
+            double *c = A + j2*lda;
+            const double l = a[j2];
+            for ( int i = j2; i < n; ++i ) {
+                c[i] -= l*a[i];
+            }
+        }
+    }
+    return 0;
+}
+
+int kernel_dpotrf_l( int n, double *A, int lda ) {
+    for ( int jb = 0; jb < n; jb += NB ) {
+        const int nb = std::min( NB, n-jb );
+        double *A11 = A + jb*lda + jb;
+
+        const int info = potf2_l( nb, A11, lda );
+        if ( info ) {
+            return jb+info;
+        }
+
+        const int m = n-jb-nb;
+        if ( m > 0 ) {
+            double *A21 = A11 + nb;
+            double *A22 = A11 + nb*lda + nb;
+            kernel_dtrsm_rltn( m, nb, A11, lda, A21, lda );
+            kernel_dsyrk_ln( m, nb, -1.0, A21, lda, A22, lda );
+        }
+    }
+    return 0;
+}
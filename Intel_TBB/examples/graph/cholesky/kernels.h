@@ -0,0 +1,46 @@
+/*
+    Copyright 2005-2016 Intel Corporation.  All Rights Reserved.
+
+    This file is part of Threading Building Blocks. Threading Building Blocks is free software;
+    you can redistribute it and/or modify it under the terms of the GNU General Public License
+    version 2  as  published  by  the  Free Software Foundation.  Threading Building Blocks is
+    distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+    implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See  the GNU General Public License for more details.   You should have received a copy of
+    the  GNU General Public License along with Threading Building Blocks; if not, write to the
+    Free Software Foundation, Inc.,  51 Franklin St,  Fifth Floor,  Boston,  MA 02110-1301 USA
+
+    As a special exception,  you may use this file  as part of a free software library without
+    restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+    functions from this file, or you compile this file and link it with other files to produce
+    an executable,  this file does not by itself cause the resulting executable to be covered
+    by the GNU General Public License. This exception does not however invalidate any other
+    reasons why the executable file might be covered by the GNU General Public License.
+*/
+
+#ifndef CHOLESKY_KERNELS_H_
+#define CHOLESKY_KERNELS_H_
+
+/************************************************************
+ Self-contained dense kernels used by the cholesky example
+ in place of MKL. All matrices are column-major; element
+ (i,j) of a matrix X with leading dimension ldx is X[j*ldx+i].
+ The inner loops are register-blocked and use AVX2/FMA when
+ compiled with -mavx2 -mfma, plain C++ otherwise.
+************************************************************/
+
+//! C += alpha*A*B^T, where C is m x n, A is m x k and B is n x k
+void kernel_dgemm_nt( int m, int n, int k, double alpha,
+                      const double *A, int lda, const double *B, int ldb, double *C, int ldc );
+
+//! Lower triangle of C += alpha*A*A^T, where C is n x n and A is n x k
+void kernel_dsyrk_ln( int n, int k, double alpha, const double *A, int lda, double *C, int ldc );
+
+//! A := A*L^-T, where A is m x n and L is n x n lower triangular
+void kernel_dtrsm_rltn( int m, int n, const double *L, int ldl, double *A, int lda );
+
+//! Cholesky factorization A = L*L^T of the lower triangle of n x n matrix A
+/** Returns 0 on success, or j+1 if the leading minor of order j+1 is not positive definite. */
+int kernel_dpotrf_l( int n, double *A, int lda );
+
+#endif /* CHOLESKY_KERNELS_H_ */
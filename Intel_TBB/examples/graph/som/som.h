@@ -84,8 +84,8 @@ public:
     friend std::ostream& operator<<( std::ostream &out, const SOM_element &s);
     friend void remark_SOM_element(const SOM_element &s);
     SOM_element() : w(nElements,0.0) {}
-    double &operator[](int indx) { return w.at(indx); }
-    const double &operator[](int indx) const { return w.at(indx); }
+    double &operator[](int indx) { return w[indx]; }
+    const double &operator[](int indx) const { return w[indx]; }
     bool operator==(SOM_element const &other) const {
         for(size_t i=0;i<size();++i) {
             if(w[i] != other.w[i]) {
@@ -50,6 +50,7 @@
 #include "tbb/blocked_range2d.h"
 #include "tbb/tick_count.h"
 #include "../examples/common/utility/utility.h"
+#include "som_soa.h"
 
 #define RED 0
 #define GREEN 1
@@ -306,6 +307,52 @@ void graph_teach(SOMap &map1, teaching_vector_type &in) {
 static const double serial_time_adjust = 1.25;
 static double radius_fraction = 3.0;
 
+static bool soa_test = false;
+static bool soa_float = false;
+static int soa_batch_size = 16;
+static int soa_map_size = 1000;
+
+// Train the map one exemplar per epoch with SOMap, then with mini-batches of
+// soa_batch_size exemplars per epoch with SOMapSoA, and report time per epoch.
+template<typename real_type>
+void compare_soa_training(const char *type_name) {
+    xMax = yMax = soa_map_size;
+    max_radius = xMax / 2;
+    radius_decay_rate = log((double)max_radius) / (double)nPasses;
+
+    double orig_seconds;
+    {
+        SOMap map1(xMax, yMax);
+        map1.initialize(InitializeGradient, max_range, min_range);
+        tick_count t0 = tick_count::now();
+        for(int epoch = 0; epoch < nPasses; ++epoch) {
+            int j = epoch % (int)my_teaching.size();
+            int min_x, min_y;
+            (void) map1.BMU(my_teaching[j], min_x, min_y);
+            double radius = max_radius * exp(-(double)epoch*radius_decay_rate);
+            double learning_rate = max_learning_rate * exp(-(double)epoch * learning_decay_rate);
+            map1.epoch_update(my_teaching[j], epoch, min_x, min_y, radius, learning_rate);
+        }
+        orig_seconds = (tick_count::now()-t0).seconds();
+    }
+
+    double soa_seconds;
+    {
+        SOMap map1(xMax, yMax);
+        map1.initialize(InitializeGradient, max_range, min_range);
+        SOMapSoA<real_type> map2(xMax, yMax);
+        map2.load(map1);
+        tick_count t0 = tick_count::now();
+        map2.teach_batch(my_teaching, nPasses, soa_batch_size);
+        soa_seconds = (tick_count::now()-t0).seconds();
+    }
+
+    printf("%d x %d map, %d epochs\n", xMax, yMax, nPasses);
+    printf("   SOMap                 : %g sec/epoch, %g sec/exemplar\n", orig_seconds/nPasses, orig_seconds/nPasses);
+    printf("   SOMapSoA<%-6s> batch %d: %g sec/epoch, %g sec/exemplar\n", type_name, soa_batch_size,
+           soa_seconds/nPasses, soa_seconds/nPasses/soa_batch_size);
+}
+
 int
 main(int argc, char** argv) {
     int l_speculation_start;
@@ -325,6 +372,10 @@ main(int argc, char** argv) {
             .arg(cancel_test, "cancel-test", "test for cancel signal while finding BMU")
             .arg(extra_debug, "debug", "additional output")
             .arg(dont_speculate,"nospeculate","don't speculate in SOM map teaching")
+            .arg(soa_test,"soa","compare mini-batch training of the structure-of-arrays map with SOMap")
+            .arg(soa_float,"float","use float weights in the structure-of-arrays map")
+            .arg(soa_batch_size,"batch-size","number of exemplars per epoch in mini-batch training")
+            .arg(soa_map_size,"map-size","side of the square map used for the structure-of-arrays comparison")
          );
 
     readInputData();
@@ -340,6 +391,15 @@ main(int argc, char** argv) {
         printf( "\n");
     }
 
+    if(soa_test) {
+        if(soa_batch_size < 1) soa_batch_size = 1;
+        task_scheduler_init init(threads.last);
+        if(soa_float) compare_soa_training<float>("float");
+        else compare_soa_training<double>("double");
+        printf("done\n");
+        return 0;
+    }
+
     // find how much time is taken for the single function_node case.
     // adjust nPasses so the 1x1 time is somewhere around serial_time_adjust seconds.
    // make sure the example test runs for at least 0.5 second.
@@ -0,0 +1,207 @@
+/*
+    Copyright 2005-2016 Intel Corporation.  All Rights Reserved.
+
+    This file is part of Threading Building Blocks. Threading Building Blocks is free software;
+    you can redistribute it and/or modify it under the terms of the GNU General Public License
+    version 2  as  published  by  the  Free Software Foundation.  Threading Building Blocks is
+    distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+    implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See  the GNU General Public License for more details.   You should have received a copy of
+    the  GNU General Public License along with Threading Building Blocks; if not, write to the
+    Free Software Foundation, Inc.,  51 Franklin St,  Fifth Floor,  Boston,  MA 02110-1301 USA
+
+    As a special exception,  you may use this file  as part of a free software library without
+    restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+    functions from this file, or you compile this file and link it with other files to produce
+    an executable,  this file does not by itself cause the resulting executable to be covered
+    by the GNU General Public License. This exception does not however invalidate any other
+    reasons why the executable file might be covered by the GNU General Public License.
+*/
+
+//
+// Self-organizing map with structure-of-arrays weights
+//
+//   The weights are kept as nElements planes of xSize*ySize values each, so
+//   the distance from an exemplar to a run of consecutive nodes is computed
+//   with one vector operation per plane for many nodes at once.  Training
+//   works on mini-batches: the BMUs of all exemplars of a batch are searched
+//   for in parallel against the same map, then the updates are applied in
+//   order with the same neighborhood rule as SOMap::epoch_update.
+//
+#ifndef __SOM_SOA_H__
+#define __SOM_SOA_H__
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+
+#include "som.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+#include "tbb/cache_aligned_allocator.h"
+
+template<typename real_type>
+class SOMapSoA {
+    typedef std::vector<real_type, tbb::cache_aligned_allocator<real_type> > weights_type;
+
+    // nodes evaluated together by the distance kernel
+    static const int kernel_width = 64;
+    // planes are padded to a multiple of a cache line
+    static const int plane_alignment = 64 / sizeof(real_type);
+
+    int my_xsize;
+    int my_ysize;
+    int my_stride;          // distance between planes, in elements
+    weights_type my_weights;
+
+    real_type *plane(int i) { return &my_weights[(size_t)i*my_stride]; }
+    const real_type *plane(int i) const { return &my_weights[(size_t)i*my_stride]; }
+
+    // BMU among nodes [first,last) for an exemplar of nElements values
+    int BMU_range(const real_type *s, int first, int last, real_type &min_distance_squared) const {
+        real_type best = std::numeric_limits<real_type>::max();
+        int best_node = -1;
+        real_type acc[kernel_width];
+        for(int base = first; base < last; base += kernel_width) {
+            const int n = (last - base < kernel_width) ? last - base : kernel_width;
+            for(int k = 0; k < n; ++k) acc[k] = 0;
+            for(int i = 0; i < nElements; ++i) {
+                const real_type *w = plane(i) + base;
+                const real_type si = s[i];
+                for(int k = 0; k < n; ++k) {
+                    const real_type diff = w[k] - si;
+                    acc[k] += diff*diff;
+                }
+            }
+            // strict '<' keeps the first node in x-major order, as SOMap::BMU_range does
+            for(int k = 0; k < n; ++k) {
+                if(acc[k] < best) {
+                    best = acc[k];
+                    best_node = base + k;
+                }
+            }
+        }
+        min_distance_squared = best;
+        return best_node;
+    }
+
+    struct BMU_batch_body {
+        const SOMapSoA &my_map;
+        const real_type *my_batch;
+        search_result_type *my_results;
+        BMU_batch_body(const SOMapSoA &m, const real_type *b, search_result_type *r) : my_map(m), my_batch(b), my_results(r) {}
+        void operator()(const tbb::blocked_range<int> &r) const {
+            for(int j = r.begin(); j != r.end(); ++j) {
+                real_type d;
+                int node = my_map.BMU_range(my_batch + (size_t)j*nElements, 0, my_map.my_xsize*my_map.my_ysize, d);
+                my_results[j] = search_result_type(std::sqrt((double)d), node / my_map.my_ysize, node % my_map.my_ysize);
+            }
+        }
+    };
+
+    struct update_body {
+        SOMapSoA &my_map;
+        const real_type *my_s;
+        int my_min_x, my_min_y;
+        double my_radius, my_learning_rate;
+        update_body(SOMapSoA &m, const real_type *s, int min_x, int min_y, double radius, double learning_rate)
+            : my_map(m), my_s(s), my_min_x(min_x), my_min_y(min_y), my_radius(radius), my_learning_rate(learning_rate) {}
+        void operator()(const tbb::blocked_range<int> &r) const {
+            std::vector<real_type> frac;
+            for(int xx = r.begin(); xx != r.end(); ++xx) {
+                double xrsq = (xx-my_min_x)*(xx-my_min_x);
+                double ysq = my_radius*my_radius - xrsq;  // max extent of y influence
+                if(ysq <= 0) continue;
+                double yd = std::sqrt(ysq);
+                int lb = (int)(my_min_y - yd);
+                int ub = (int)(my_min_y + yd);
+                if(lb < 0) lb = 0;
+                if(ub > my_map.my_ysize) ub = my_map.my_ysize;
+                if(lb >= ub) continue;
+                frac.resize(ub - lb);
+                for(int yy = lb; yy < ub; ++yy) {
+                    double my_rsq = xrsq + (yy-my_min_y)*(yy-my_min_y);  // distance from BMU squared
+                    double theta = std::exp(-(my_radius*my_radius) /(2.0* my_rsq));
+                    frac[yy-lb] = (real_type)(theta * my_learning_rate);
+                }
+                const size_t row = (size_t)xx*my_map.my_ysize;
+                for(int i = 0; i < nElements; ++i) {
+                    real_type *w = my_map.plane(i) + row + lb;
+                    const real_type si = my_s[i];
+                    for(int k = 0; k < ub - lb; ++k) {
+                        w[k] += frac[k]*(si - w[k]);
+                    }
+                }
+            }
+        }
+    };
+
+public:
+    SOMapSoA(int xSize, int ySize) : my_xsize(xSize), my_ysize(ySize) {
+        my_stride = (xSize*ySize + plane_alignment - 1) / plane_alignment * plane_alignment;
+        my_weights.assign((size_t)my_stride*nElements, real_type(0));
+    }
+
+    int xsize() const { return my_xsize; }
+    int ysize() const { return my_ysize; }
+
+    void load(SOMap &m) {
+        for(int x = 0; x < my_xsize; ++x)
+            for(int y = 0; y < my_ysize; ++y)
+                for(int i = 0; i < nElements; ++i)
+                    plane(i)[x*my_ysize+y] = (real_type)m.at(x,y)[i];
+    }
+    void store(SOMap &m) const {
+        for(int x = 0; x < my_xsize; ++x)
+            for(int y = 0; y < my_ysize; ++y)
+                for(int i = 0; i < nElements; ++i)
+                    m.at(x,y)[i] = plane(i)[x*my_ysize+y];
+    }
+
+    // find BMU given an input, returns distance
+    double BMU(const real_type *s, int &xval, int &yval) const {
+        real_type d;
+        int node = BMU_range(s, 0, my_xsize*my_ysize, d);
+        xval = node / my_ysize;
+        yval = node % my_ysize;
+        return std::sqrt((double)d);
+    }
+
+    // BMUs of n exemplars stored one after another, searched for in parallel
+    void BMU_batch(const real_type *batch, int n, search_result_type *results) const {
+        tbb::parallel_for(tbb::blocked_range<int>(0, n, 1), BMU_batch_body(*this, batch, results));
+    }
+
+    void epoch_update(const real_type *s, int min_x, int min_y, double radius, double learning_rate) {
+        int min_xiter = (int)((double)min_x - radius);
+        if(min_xiter < 0) min_xiter = 0;
+        int max_xiter = (int)((double)min_x + radius);
+        if(max_xiter > my_xsize-1) max_xiter = my_xsize-1;
+        // update circle is min_xiter to max_xiter inclusive.
+        tbb::parallel_for(tbb::blocked_range<int>(min_xiter, max_xiter+1, 8),
+                          update_body(*this, s, min_x, min_y, radius, learning_rate));
+    }
+
+    // Mini-batch training: each epoch takes the next batch_size exemplars in order.
+    void teach_batch(teaching_vector_type &in, int epochs, int batch_size) {
+        std::vector<real_type> batch((size_t)batch_size*nElements);
+        std::vector<search_result_type> results(batch_size);
+        int next_j = 0;
+        for(int epoch = 0; epoch < epochs; ++epoch) {
+            for(int b = 0; b < batch_size; ++b) {
+                for(int i = 0; i < nElements; ++i)
+                    batch[(size_t)b*nElements+i] = (real_type)in[next_j][i];
+                next_j = (next_j+1) % (int)in.size();
+            }
+            BMU_batch(&batch[0], batch_size, &results[0]);
+            double radius = max_radius * exp(-(double)epoch*radius_decay_rate);
+            double learning_rate = max_learning_rate * exp(-(double)epoch * learning_decay_rate);
+            for(int b = 0; b < batch_size; ++b) {
+                epoch_update(&batch[(size_t)b*nElements], get<XV>(results[b]), get<YV>(results[b]), radius, learning_rate);
+            }
+        }
+    }
+};
+
+#endif // __SOM_SOA_H__
@@ -99,3 +99,73 @@ void Cell::update() {
     }
 }
 
+void CompactGraph::create_random_dag( size_t number_of_nodes ) {
+    // The same sequence of rand() calls as Graph::create_random_dag
+    cell.resize(number_of_nodes);
+    root_set.clear();
+    for( size_t k=0; k<number_of_nodes; ++k ) {
+        Cell& c = cell[k];
+        int op = int((rand()>>8)%5u);
+        if( op>int(k) ) op = int(k);
+        switch( op ) {
+            default:
+                c.op = OP_VALUE;
+                c.value = (float)k;
+                break;
+            case 1:
+                c.op = OP_NEGATE;
+                break;
+            case 2:
+                c.op = OP_SUB;
+                break;
+            case 3: 
+                c.op = OP_ADD;
+                break;
+            case 4: 
+                c.op = OP_MUL;
+                break;
+        }
+        c.input[0] = c.input[1] = 0;
+        for( int j=0; j<ArityOfOp[c.op]; ++j )
+            c.input[j] = int(rand()%k);
+        if( ArityOfOp[c.op]==0 )
+            root_set.push_back(int(k));
+    }
+
+    // Successor lists in CSR form: count, prefix sum, then fill in the order of the cells
+    successor_begin.assign(number_of_nodes+1, 0);
+    for( size_t k=0; k<number_of_nodes; ++k )
+        for( int j=0; j<arity(int(k)); ++j )
+            ++successor_begin[cell[k].input[j]+1];
+    for( size_t k=0; k<number_of_nodes; ++k )
+        successor_begin[k+1] += successor_begin[k];
+    successor.resize(successor_begin[number_of_nodes]);
+    std::vector<int> fill(successor_begin.begin(), successor_begin.end()-1);
+    for( size_t k=0; k<number_of_nodes; ++k )
+        for( int j=0; j<arity(int(k)); ++j )
+            successor[fill[cell[k].input[j]]++] = int(k);
+
+    ref_count.resize(number_of_nodes);
+    for( size_t k=0; k<number_of_nodes; ++k )
+        ref_count[k] = arity(int(k));
+}
+
+void CompactGraph::Cell::update( const Cell* cells ) {
+    switch( op ) {
+        case OP_VALUE:
+            break;
+        case OP_NEGATE:
+            value = -cells[input[0]].value;
+            break;
+        case OP_ADD:
+            value = cells[input[0]].value + cells[input[1]].value;
+            break;
+        case OP_SUB:
+            value = cells[input[0]].value - cells[input[1]].value;
+            break;
+        case OP_MUL:
+            value = cells[input[0]].value * cells[input[1]].value;
+            break;
+    }
+}
+
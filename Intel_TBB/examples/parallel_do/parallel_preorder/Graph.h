@@ -78,3 +78,37 @@ public:
     void get_root_set( std::vector<Cell*>& root_set );
 };
 
+//! A directed acyclic graph of scalar cells, stored compactly for large graphs.
+/** Cells are kept in one array in topological order, with their inputs as indices.
+    The successors of cell k are successor[successor_begin[k]..successor_begin[k+1]),
+    and the counts of inputs not yet updated are in an array of their own. */
+class CompactGraph {
+public:
+    struct Cell {
+        //! Operation for this cell
+        OpKind op;
+        //! Indices of the inputs to this cell
+        int input[2];
+        //! Value associated with this cell
+        float value;
+
+        //! Update the cell's value from the values of the cells of the graph
+        void update( const Cell* cells );
+    };
+
+    std::vector<Cell> cell;
+    std::vector<int> successor_begin;
+    std::vector<int> successor;
+    std::vector< tbb::atomic<int> > ref_count;
+    std::vector<int> root_set;
+
+    //! Create a random acyclic directed graph, of the same shape as Graph::create_random_dag
+    void create_random_dag( size_t number_of_nodes );
+
+    //! Number of cells
+    size_t size() const { return cell.size(); }
+
+    //! Number of inputs of cell k
+    int arity( int k ) const { return ArityOfOp[cell[k].op]; }
+};
+
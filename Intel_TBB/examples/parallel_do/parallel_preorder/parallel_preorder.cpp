@@ -53,4 +53,67 @@ void ParallelPreorderTraversal( const std::vector<Cell*>& root_set ) {
     tbb::parallel_do(root_set.begin(), root_set.end(),Body());
 }
 
+#if __GNUC__ || __INTEL_COMPILER
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)0)
+#endif
+
+class CompactBody {
+    CompactGraph& g;
+
+    //! Number of ready cells a body keeps for itself before it feeds them to parallel_do
+    static const int local_capacity = 64;
+public:
+    CompactBody( CompactGraph& g_ ) : g(g_) {}
+
+    typedef int argument_type;
+
+    void operator()( int k, tbb::parallel_do_feeder<int>& feeder ) const {
+        CompactGraph::Cell* cells = &g.cell[0];
+        // The successors made ready by a cell go to a small queue local to this
+        // body and are updated here, by the current worker, while the values
+        // they just read are still in cache.  Only the overflow is fed; the
+        // feeder puts it in the deque of the current worker too, so it runs
+        // here next unless another thread steals it.  Queued cells are
+        // prefetched, so that their misses overlap with the work on the cells
+        // in front of them.
+        int queue[local_capacity];
+        int head = 0, tail = 0;
+        for(;;) {
+            const int first = g.successor_begin[k], last = g.successor_begin[k+1];
+            // The atomic decrements below do not overlap their misses
+            for( int i=first; i<last; ++i )
+                PREFETCH( &g.ref_count[g.successor[i]] );
+            cells[k].update( cells );
+            // Restore ref_count in preparation for subsequent traversal.
+            g.ref_count[k] = g.arity(k);
+            for( int i=first; i<last; ++i ) {
+                int s = g.successor[i];
+                if( 0 == --g.ref_count[s] ) {
+                    if( tail-head<local_capacity ) {
+                        queue[tail++ % local_capacity] = s;
+                        PREFETCH( &cells[s] );
+                        PREFETCH( &g.successor_begin[s] );
+                    } else {
+                        feeder.add( s );
+                    }
+                }
+            }
+            if( head==tail )
+                break;
+            k = queue[head++ % local_capacity];
+            if( head<tail ) {
+                const int n = queue[head % local_capacity];
+                PREFETCH( &cells[cells[n].input[0]] );
+                PREFETCH( &cells[cells[n].input[1]] );
+                PREFETCH( &g.successor[g.successor_begin[n]] );
+            }
+        }
+    }
+};
+
+void CompactPreorderTraversal( CompactGraph& g ) {
+    tbb::parallel_do(g.root_set.begin(), g.root_set.end(), CompactBody(g));
+}
 
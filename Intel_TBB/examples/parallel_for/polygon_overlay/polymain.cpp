@@ -29,6 +29,7 @@
 #include <iomanip>
 #include <algorithm>
 #include <cstring>
+#include <queue>
 
 #include "tbb/tick_count.h"
 #include "tbb/task_scheduler_init.h"
@@ -63,6 +64,8 @@ int main( int argc, char **argv) {
             exit(1);
         }
     }
+    // the index benchmark never draws, so it keeps the map size given on the command line
+    if(gIndexOnly) gIsGraphicalVersion = false;
 
     if(gCsvFilename != NULL) {
 #define BUFLEN 1000
@@ -124,6 +127,7 @@ void Usage(int argc, char **argv) {
     cout << "   --csv filename - write timing data to CSV-format file" << std::endl;
     cout << "   --grainsize n - set grainsize to n" << std::endl;
     cout << "   --use_malloc - allocate polygons with malloc instead of scalable allocator" << std::endl;
+    cout << "   --index_only - build tiled maps quickly and run only the grid-indexed overlay" << std::endl;
     cout << std::endl;
     cout << "npolys must be smaller than the size of the map" << std::endl;
     cout << std::endl;
@@ -138,6 +142,7 @@ bool ParseCmdLine(int argc, char **argv ) {
     bool csvSpecified = false;
     bool grainsizeSpecified = false;
     bool mallocSpecified = false;
+    bool indexOnlySpecified = false;
     int origArgc = argc;
     char** origArgv = argv;
     unsigned int newnPolygons = gNPolygons;
@@ -266,6 +271,17 @@ bool ParseCmdLine(int argc, char **argv ) {
                 gMBehavior = UseMalloc;
             }
         }
+        else if(!strncmp("--index_only", *argv, (size_t)12)) {
+            argv++; argc--;
+            if(indexOnlySpecified) {
+                cout << "Error: --index_only multiply-specified" << std::endl;
+                error_found = true;
+            }
+            else {
+                indexOnlySpecified = true;
+                gIndexOnly = true;
+            }
+        }
         else {
             cout << "Error: unrecognized argument: " << *argv << std::endl;
             error_found = true;
@@ -476,6 +492,60 @@ bool GenerateMap(Polygon_map_t **newMap, int xSize, int ySize, int gNPolygons, c
     return true;
 }
 
+// A polygon of a tiled map, ordered by area so the largest is split first.
+struct TileCandidate {
+    int xl, yl, xh, yh;
+    TileCandidate(int x0, int y0, int x1, int y1) : xl(x0), yl(y0), xh(x1), yh(y1) {}
+    long long area() const { return (long long)(xh-xl+1)*(yh-yl+1); }
+    bool operator<(const TileCandidate &other) const { return area() < other.area(); }
+};
+
+// create a polygon map with exactly gNPolygons polygons by repeatedly cutting the
+// largest polygon in two across its longer side.  Unlike GenerateMap this takes
+// O(n log n) time, so it can build maps far larger than the defaults.
+bool GenerateTiledMap(Polygon_map_t **newMap, int xSize, int ySize, int gNPolygons, colorcomp_t maxR, colorcomp_t maxG, colorcomp_t maxB) {
+    if(xSize <= 0 || ySize <= 0) {
+        cout << "map size (" << xSize << "x" << ySize << ") should be > 0." << std::endl;
+        return false;
+    }
+    if((long long)gNPolygons > (long long)xSize * ySize) {
+        cout << "gNPolygons (" << gNPolygons << ") should be less than " << ((long long)xSize * ySize) << std::endl;
+        return false;
+    }
+    std::priority_queue<TileCandidate> tiles;
+    tiles.push(TileCandidate(0, 0, xSize-1, ySize-1));
+    while((int)tiles.size() < gNPolygons) {
+        TileCandidate t = tiles.top();
+        tiles.pop();
+        // cut somewhere in the middle half of the longer side
+        if(t.xh - t.xl >= t.yh - t.yl) {
+            int len = t.xh - t.xl + 1;
+            int cut = t.xl + len/4 + NextRan(len/2 > 0 ? len/2 : 1);
+            if(cut >= t.xh) cut = t.xh - 1;
+            tiles.push(TileCandidate(t.xl, t.yl, cut, t.yh));
+            tiles.push(TileCandidate(cut+1, t.yl, t.xh, t.yh));
+        }
+        else {
+            int len = t.yh - t.yl + 1;
+            int cut = t.yl + len/4 + NextRan(len/2 > 0 ? len/2 : 1);
+            if(cut >= t.yh) cut = t.yh - 1;
+            tiles.push(TileCandidate(t.xl, t.yl, t.xh, cut));
+            tiles.push(TileCandidate(t.xl, cut+1, t.xh, t.yh));
+        }
+    }
+    *newMap = new Polygon_map_t;
+    (*newMap)->reserve(gNPolygons + 1);
+    (*newMap)->push_back(RPolygon(0,0,xSize-1, ySize-1));
+    for(; !tiles.empty(); tiles.pop()) {
+        const TileCandidate &t = tiles.top();
+        int nR = (maxR * NextRan(1000)) / 999;
+        int nG = (maxG * NextRan(1000)) / 999;
+        int nB = (maxB * NextRan(1000)) / 999;
+        (*newMap)->push_back(RPolygon(t.xl,t.yl,t.xh,t.yh,nR,nG,nB));
+    }
+    return true;
+}
+
 void CheckPolygonMap(Polygon_map_t *checkMap) {
 #define indx(i,j) (i*gMapYSize + j)
 #define rangeCheck(str,n,limit) if(((n)<0)||((n)>=limit)) {cout << "checkMap error: " << str << " out of range (" << n << ")" << std::endl;anError=true;}
@@ -30,6 +30,8 @@ extern bool ParseCmdLine(int argc, char **argv );
 
 extern bool GenerateMap(Polygon_map_t **newMap, int xSize, int ySize, int gNPolygons, colorcomp_t maxR, colorcomp_t maxG, colorcomp_t maxB);
 
+extern bool GenerateTiledMap(Polygon_map_t **newMap, int xSize, int ySize, int gNPolygons, colorcomp_t maxR, colorcomp_t maxG, colorcomp_t maxB);
+
 extern bool PolygonsOverlap(RPolygon *p1, RPolygon *p2, int &xl, int &yl, int &xh, int &yh);
 
 extern void CheckPolygonMap(Polygon_map_t *checkMap);
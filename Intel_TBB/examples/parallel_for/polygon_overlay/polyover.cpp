@@ -25,12 +25,15 @@
 #include <string.h>
 #include <cstdlib>
 #include <assert.h>
+#include <math.h>
+#include <vector>
 #include "tbb/tick_count.h"
 #include "tbb/blocked_range.h"
 #include "tbb/task_scheduler_init.h"
 #include "tbb/parallel_for.h"
 #include "tbb/mutex.h"
 #include "tbb/spin_mutex.h"
+#include "tbb/atomic.h"
 #include "polyover.h"
 #include "polymain.h"
 #include "pover_video.h"
@@ -666,3 +669,225 @@ void SplitParallelOverlayETS(ETS_Polygon_map_t **result_map, Polygon_map_t *poly
     }
 
 }
+
+// ------------------------------------------------------
+
+/*!
+* @class PolygonGrid
+* @brief uniform grid over the bounding boxes of one map
+*
+* Cell (cx,cy) covers squares [cx*cellSize, (cx+1)*cellSize) x [cy*cellSize, (cy+1)*cellSize).
+* The polygons touching each cell are stored contiguously (compressed rows):
+* m_polys[m_cellStart[c] .. m_cellStart[c+1]) are the indices into the map.
+*/
+class PolygonGrid {
+    Polygon_map_t *m_map;
+    int m_cellSize;
+    int m_xCells, m_yCells;
+    std::vector<int> m_cellStart;
+    std::vector<int> m_polys;
+    std::vector<tbb::atomic<int> > m_cursor;
+
+    void cellRange(const RPolygon &p, int &cxl, int &cyl, int &cxh, int &cyh) const {
+        cxl = p.xmin() / m_cellSize;
+        cyl = p.ymin() / m_cellSize;
+        cxh = p.xmax() / m_cellSize;
+        cyh = p.ymax() / m_cellSize;
+        if(cxh >= m_xCells) cxh = m_xCells - 1;
+        if(cyh >= m_yCells) cyh = m_yCells - 1;
+    }
+
+    // pass 1: count the polygons touching each cell
+    class CountBody {
+        PolygonGrid *m_grid;
+    public:
+        CountBody(PolygonGrid *grid) : m_grid(grid) {}
+        void operator()(const tbb::blocked_range<int> &r) const {
+            for(int i = r.begin(); i != r.end(); ++i) {
+                int cxl, cyl, cxh, cyh;
+                m_grid->cellRange((*m_grid->m_map)[i], cxl, cyl, cxh, cyh);
+                for(int cx = cxl; cx <= cxh; ++cx)
+                    for(int cy = cyl; cy <= cyh; ++cy)
+                        m_grid->m_cursor[cx*m_grid->m_yCells + cy].fetch_and_increment();
+            }
+        }
+    };
+
+    // pass 2: place each polygon index at the next free slot of each cell it touches
+    class FillBody {
+        PolygonGrid *m_grid;
+    public:
+        FillBody(PolygonGrid *grid) : m_grid(grid) {}
+        void operator()(const tbb::blocked_range<int> &r) const {
+            for(int i = r.begin(); i != r.end(); ++i) {
+                int cxl, cyl, cxh, cyh;
+                m_grid->cellRange((*m_grid->m_map)[i], cxl, cyl, cxh, cyh);
+                for(int cx = cxl; cx <= cxh; ++cx)
+                    for(int cy = cyl; cy <= cyh; ++cy)
+                        m_grid->m_polys[m_grid->m_cursor[cx*m_grid->m_yCells + cy].fetch_and_increment()] = i;
+            }
+        }
+    };
+
+public:
+    /*!
+    * @brief bulk-load the grid in parallel
+    * @param[in] map polygons to index (polygon 0, the map extent, is skipped)
+    * @param[in] grain_size grain size for the loading loops
+    */
+    PolygonGrid(Polygon_map_t *map, int grain_size) : m_map(map) {
+        int mapxSize, mapySize, ignore1, ignore2;
+        (*map)[0].get(&ignore1, &ignore2, &mapxSize, &mapySize);
+        // cells about twice the area of an average polygon keep the candidate lists short
+        double avgArea = double(mapxSize+1)*(mapySize+1) / (map->size() > 1 ? map->size()-1 : 1);
+        m_cellSize = (int)sqrt(2.0*avgArea);
+        if(m_cellSize < 1) m_cellSize = 1;
+        m_xCells = mapxSize / m_cellSize + 1;
+        m_yCells = mapySize / m_cellSize + 1;
+        int nCells = m_xCells*m_yCells;
+
+        m_cursor.resize(nCells);
+        for(int c = 0; c < nCells; ++c) m_cursor[c] = 0;
+        tbb::parallel_for(tbb::blocked_range<int>(1, (int)map->size(), grain_size), CountBody(this));
+
+        m_cellStart.resize(nCells+1);
+        m_cellStart[0] = 0;
+        for(int c = 0; c < nCells; ++c) {
+            m_cellStart[c+1] = m_cellStart[c] + m_cursor[c];
+            m_cursor[c] = m_cellStart[c];
+        }
+        m_polys.resize(m_cellStart[nCells]);
+        tbb::parallel_for(tbb::blocked_range<int>(1, (int)map->size(), grain_size), FillBody(this));
+    }
+
+    int cellSize() const { return m_cellSize; }
+    int xCells() const { return m_xCells; }
+    int yCells() const { return m_yCells; }
+    const int *cellBegin(int cx, int cy) const { return &m_polys[0] + m_cellStart[cx*m_yCells + cy]; }
+    const int *cellEnd(int cx, int cy) const { return &m_polys[0] + m_cellStart[cx*m_yCells + cy + 1]; }
+    RPolygon *polygon(int i) const { return &(*m_map)[i]; }
+};
+
+/*!
+* @class ApplyGridOverlayETS
+* @brief intersects polygons of map1 with their candidates from a grid over map2
+*/
+class ApplyGridOverlayETS {
+    Polygon_map_t *m_map1;
+    const PolygonGrid *m_grid;
+    ETS_Polygon_map_t *m_resultMap;
+public:
+    /*!
+    * @brief functor for the indexed version
+    * @param[in] r range of polygons of map1
+    */
+    void operator()(const tbb::blocked_range<int> & r) const {
+        int r1, g1, b1, r2, g2, b2;
+        const int cellSize = m_grid->cellSize();
+        Polygon_map_t &local = m_resultMap->local();
+        for(int i = r.begin(); i != r.end(); ++i) {
+            RPolygon *p1 = &((*m_map1)[i]);
+            int parea = p1->area();
+            p1->getColor(&r1, &g1, &b1);
+            int cxl = p1->xmin() / cellSize, cxh = p1->xmax() / cellSize;
+            int cyl = p1->ymin() / cellSize, cyh = p1->ymax() / cellSize;
+            if(cxh >= m_grid->xCells()) cxh = m_grid->xCells() - 1;
+            if(cyh >= m_grid->yCells()) cyh = m_grid->yCells() - 1;
+            for(int cx = cxl; cx <= cxh && parea > 0; ++cx) {
+                for(int cy = cyl; cy <= cyh && parea > 0; ++cy) {
+                    for(const int *c = m_grid->cellBegin(cx, cy); c != m_grid->cellEnd(cx, cy); ++c) {
+                        int xl, yl, xh, yh;
+                        RPolygon *p2 = m_grid->polygon(*c);
+                        // a pair may share several cells; only the cell holding the
+                        // low corner of the intersection reports it.
+                        if(PolygonsOverlap(p1, p2, xl, yl, xh, yh) && xl / cellSize == cx && yl / cellSize == cy) {
+                            p2->getColor(&r2, &g2, &b2);
+                            local.push_back(RPolygon(xl, yl, xh, yh, r1 + r2, g1 + g2, b1 + b2));
+                            parea -= (xh-xl+1)*(yh-yl+1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    ApplyGridOverlayETS(ETS_Polygon_map_t *resultMap, Polygon_map_t *map1, const PolygonGrid *grid) :
+    m_map1(map1), m_grid(grid), m_resultMap(resultMap) {}
+};
+
+/*!
+* @brief intersects two maps through a uniform grid index over the second map,
+* accumulating into an ets variable
+*
+* @param[out] resultMap output map (must be allocated)
+* @param[in] polymap1 map to be intersected
+* @param[in] polymap2 map to be intersected (indexed)
+*/
+void GridParallelOverlayETS(ETS_Polygon_map_t **result_map, Polygon_map_t *polymap1, Polygon_map_t *polymap2) {
+    int nthreads;
+    bool automatic_threadcount = false;
+    double gridParallelTime, indexTime;
+    tbb::tick_count t0, t1, t2;
+    if(gThreadsLow == THREADS_UNSET || gThreadsLow == tbb::task_scheduler_init::automatic ) {
+        gThreadsLow = gThreadsHigh = tbb::task_scheduler_init::automatic;
+        automatic_threadcount = true;
+    }
+    *result_map = new ETS_Polygon_map_t;
+
+    RPolygon *p0 = &((*polymap1)[0]);
+    int mapxSize, mapySize, ignore1, ignore2;
+    p0->get(&ignore1, &ignore2, &mapxSize, &mapySize);
+
+    int grain_size;
+#ifdef _DEBUG
+    grain_size = 4;
+#else
+    grain_size = gGrainSize;
+#endif
+    for(nthreads = gThreadsLow; nthreads <= gThreadsHigh; nthreads++) {
+        tbb::task_scheduler_init init(nthreads);
+        if(gIsGraphicalVersion) {
+            RPolygon *xp = new RPolygon(0, 0, gMapXSize-1, gMapYSize-1, 0, 0, 0);  // Clear the output space
+            delete xp;
+        }
+        t0 = tbb::tick_count::now();
+        PolygonGrid grid(polymap2, grain_size);
+        t1 = tbb::tick_count::now();
+        tbb::parallel_for (tbb::blocked_range<int>(1, (int)polymap1->size(), grain_size), ApplyGridOverlayETS((*result_map), polymap1, &grid));
+        t2 = tbb::tick_count::now();
+        indexTime = (t1-t0).seconds()*1000;
+        gridParallelTime = (t2-t0).seconds()*1000;
+        size_t nResults = 0;
+        for(ETS_Polygon_map_t::const_iterator ci = (*result_map)->begin(); ci != (*result_map)->end(); ++ci) {
+            nResults += ci->size();
+        }
+        cout << "Grid index with ETS and ";
+        if(automatic_threadcount) cout << "automatic";
+        else cout << nthreads;
+        cout << ((nthreads == 1) ? " thread" : " threads");
+        cout << " took " << gridParallelTime << " msec (index " << indexTime << " msec, "
+             << grid.xCells() << "x" << grid.yCells() << " cells, " << nResults << " polygons)";
+        if(gSerialTime > 0) cout << " : speedup over serial " << (gSerialTime / gridParallelTime);
+        cout << std::endl;
+        if(gCsvFile.is_open()) {
+            gCsvFile << "," << gridParallelTime;
+        }
+#if _DEBUG
+        {
+            Polygon_map_t s_result_map;
+            flattened2d<ETS_Polygon_map_t> psv = flatten2d(**result_map);
+            s_result_map.push_back(RPolygon(0,0,mapxSize, mapySize));
+            for(flattened2d<ETS_Polygon_map_t>::const_iterator ci = psv.begin(); ci != psv.end(); ++ci) {
+                s_result_map.push_back(*ci);
+            }
+            CheckPolygonMap(&s_result_map);
+            if(gResultMap) ComparePolygonMaps(&s_result_map, gResultMap);
+        }
+#endif
+        (*result_map)->clear();
+    }
+
+    if(gCsvFile.is_open()) {
+        gCsvFile << std::endl;
+    }
+}
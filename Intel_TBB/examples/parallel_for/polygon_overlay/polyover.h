@@ -35,6 +35,7 @@ extern void NaiveParallelOverlay(Polygon_map_t *&result_map, Polygon_map_t &poly
 extern void SplitParallelOverlay(Polygon_map_t **result_map, Polygon_map_t *polymap1, Polygon_map_t *polymap2);
 extern void SplitParallelOverlayCV(concurrent_Polygon_map_t **result_map, Polygon_map_t *polymap1, Polygon_map_t *polymap2);
 extern void SplitParallelOverlayETS(ETS_Polygon_map_t **result_map, Polygon_map_t *polymap1, Polygon_map_t *polymap2);
+extern void GridParallelOverlayETS(ETS_Polygon_map_t **result_map, Polygon_map_t *polymap1, Polygon_map_t *polymap2);
 
 extern void CheckPolygonMap(Polygon_map_t *checkMap);
 extern bool ComparePolygonMaps(Polygon_map_t *map1, Polygon_map_t *map2);
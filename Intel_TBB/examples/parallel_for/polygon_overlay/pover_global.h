@@ -75,6 +75,7 @@ DEFINE int gGrainSize INIT(20);
 DEFINE int gMyRandomSeed INIT(2453185);
 
 DEFINE bool gIsGraphicalVersion INIT(false);
+DEFINE bool gIndexOnly INIT(false);    // headless run of the grid-indexed overlay only
 
 typedef enum {
     NORTH_SIDE,
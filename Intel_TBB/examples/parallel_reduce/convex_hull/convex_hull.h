@@ -48,6 +48,8 @@ namespace cfg {
     const size_t generateGrainSize = 25000;
     const size_t findExtremumGrainSize  = 25000;
     const size_t divideGrainSize   = 25000;
+    // subproblems of the in-place version smaller than this recurse serially
+    const size_t serialHullCutoff  = 100000;
 };
 
 namespace util {
@@ -183,6 +183,11 @@ int main(int argc, char* argv[]) {
 #include "tbb/parallel_for.h"
 #include "tbb/parallel_reduce.h"
 #include "tbb/blocked_range.h"
+#include "tbb/parallel_invoke.h"
+
+#if __AVX2__
+#include <immintrin.h>
+#endif
 
 typedef tbb::blocked_range<size_t> range_t;
 
@@ -569,6 +574,394 @@ void quickhull(const pointVec_t &points, pointVec_t &hull, bool buffered) {
 #endif // USECONCVEC
 }
 
+// In-place partitioning version: no intermediate vectors are grown. Each step
+// classifies the points of a subproblem against the two edges through its
+// farthest point with vectorized cross products, packs the survivors of both
+// edges into the matching region of a second buffer in parallel, and the two
+// resulting subproblems recurse as tasks until they fall below a serial cutoff.
+
+typedef util::edge<point_t> edge_t;
+
+// The first pack classifies against up to four edges, every other one against two
+static const size_t maxPackEdges = 4;
+// Points classified at once by cross_products()
+static const size_t orientationBlock = 64;
+
+// cp[k] = util::cross_product(e.start, e.end, p[k]) for k < n
+void cross_products(const point_t* p, size_t n, const edge_t& e, double* cp) {
+    const double sx = e.start.x, sy = e.start.y;
+    const double dx = e.end.x - sx, dy = e.end.y - sy;
+    size_t k = 0;
+#if __AVX2__
+    const __m256d vsx = _mm256_set1_pd(sx), vsy = _mm256_set1_pd(sy);
+    const __m256d vdx = _mm256_set1_pd(dx), vdy = _mm256_set1_pd(dy);
+    for(; k+4 <= n; k += 4) {
+        // two points per register: [x0 y0 x1 y1] and [x2 y2 x3 y3]
+        __m256d lo = _mm256_loadu_pd(&p[k].x);
+        __m256d hi = _mm256_loadu_pd(&p[k+2].x);
+        // lanes come out as points 0,2,1,3
+        __m256d x = _mm256_sub_pd(_mm256_unpacklo_pd(lo, hi), vsx);
+        __m256d y = _mm256_sub_pd(_mm256_unpackhi_pd(lo, hi), vsy);
+        __m256d r = _mm256_sub_pd(_mm256_mul_pd(vdx, y), _mm256_mul_pd(x, vdy));
+        _mm256_storeu_pd(cp+k, _mm256_permute4x64_pd(r, _MM_SHUFFLE(3,1,2,0)));
+    }
+#endif
+    for(; k < n; ++k) {
+        cp[k] = dx*(p[k].y-sy) - (p[k].x-sx)*dy;
+    }
+}
+
+// group[k] is the first edge the point is strictly left of, or -1;
+// cp[k] is its cross product against that edge.
+void classify_points(const point_t* p, size_t n, const edge_t* edges, size_t nEdges,
+                     signed char* group, double* cp) {
+    double cpe[orientationBlock];
+    for(size_t k = 0; k < n; ++k) {
+        group[k] = -1;
+    }
+    for(size_t e = 0; e < nEdges; ++e) {
+        cross_products(p, n, edges[e], cpe);
+        for(size_t k = 0; k < n; ++k) {
+            const bool take = group[k] < 0 && cpe[k] > 0;
+            group[k] = take ? (signed char)e : group[k];
+            cp[k] = take ? cpe[k] : cp[k];
+        }
+    }
+}
+
+// Contiguous view of points [i, i+n) of the input, copying if they are not contiguous
+inline const point_t* load_points(const point_t* src, size_t i, size_t, point_t*) {
+    return src + i;
+}
+
+inline const point_t* load_points(const pointVec_t& src, size_t i, size_t n, point_t* tmp) {
+    const point_t *first = &src[i];
+    if(&src[i+n-1] == first+n-1) {
+        return first;
+    }
+    for(size_t k = 0; k < n; ++k) {
+        tmp[k] = src[i+k];
+    }
+    return tmp;
+}
+
+// Per-block result of the counting pass
+struct pack_block_t {
+    size_t  count[maxPackEdges];
+    size_t  offset[maxPackEdges];
+    point_t farPoint[maxPackEdges];
+    double  howFar[maxPackEdges];
+};
+
+template <typename Source>
+class PackCount {
+    const Source        &src;
+    size_t               n;
+    const edge_t        *edges;
+    size_t               nEdges;
+    pack_block_t        *blocks;
+public:
+    static const size_t  grainSize = cfg::divideGrainSize;
+
+    PackCount(const Source& _src, size_t _n, const edge_t* _edges, size_t _nEdges, pack_block_t* _blocks)
+        : src(_src), n(_n), edges(_edges), nEdges(_nEdges), blocks(_blocks) {}
+
+    void operator()(const range_t& range) const {
+        point_t     tmp[orientationBlock];
+        signed char group[orientationBlock];
+        double      cp[orientationBlock];
+        for(size_t b = range.begin(); b != range.end(); ++b) {
+            pack_block_t &block = blocks[b];
+            for(size_t e = 0; e < nEdges; ++e) {
+                block.count[e]  = 0;
+                block.howFar[e] = 0;
+            }
+            const size_t i_end = std::min(n, (b+1)*grainSize);
+            for(size_t i = b*grainSize; i < i_end; i += orientationBlock) {
+                const size_t m = std::min(orientationBlock, i_end-i);
+                const point_t *p = load_points(src, i, m, tmp);
+                classify_points(p, m, edges, nEdges, group, cp);
+                for(size_t k = 0; k < m; ++k) {
+                    const int g = group[k];
+                    if(g >= 0) {
+                        ++block.count[g];
+                        if(cp[k] > block.howFar[g]) {
+                            block.howFar[g]   = cp[k];
+                            block.farPoint[g] = p[k];
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+template <typename Source>
+class PackScatter {
+    const Source        &src;
+    size_t               n;
+    const edge_t        *edges;
+    size_t               nEdges;
+    const pack_block_t  *blocks;
+    point_t             *dst;
+public:
+    static const size_t  grainSize = cfg::divideGrainSize;
+
+    PackScatter(const Source& _src, size_t _n, const edge_t* _edges, size_t _nEdges,
+                const pack_block_t* _blocks, point_t* _dst)
+        : src(_src), n(_n), edges(_edges), nEdges(_nEdges), blocks(_blocks), dst(_dst) {}
+
+    void operator()(const range_t& range) const {
+        point_t     tmp[orientationBlock];
+        signed char group[orientationBlock];
+        double      cp[orientationBlock];
+        for(size_t b = range.begin(); b != range.end(); ++b) {
+            point_t *out[maxPackEdges];
+            for(size_t e = 0; e < nEdges; ++e) {
+                out[e] = dst + blocks[b].offset[e];
+            }
+            const size_t i_end = std::min(n, (b+1)*grainSize);
+            for(size_t i = b*grainSize; i < i_end; i += orientationBlock) {
+                const size_t m = std::min(orientationBlock, i_end-i);
+                const point_t *p = load_points(src, i, m, tmp);
+                classify_points(p, m, edges, nEdges, group, cp);
+                for(size_t k = 0; k < m; ++k) {
+                    const int g = group[k];
+                    if(g >= 0) {
+                        *out[g]++ = p[k];
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Sizes and farthest points of the groups formed by classifying src against edges
+template <typename Source>
+void pack_count(const Source& src, size_t n, const edge_t* edges, size_t nEdges,
+                std::vector<pack_block_t>& blocks, size_t* groupSize, point_t* farPoint) {
+    const size_t nBlocks = (n + PackCount<Source>::grainSize - 1) / PackCount<Source>::grainSize;
+    blocks.resize(nBlocks);
+    PackCount<Source> body(src, n, edges, nEdges, &blocks[0]);
+    if(nBlocks > 1) {
+        tbb::parallel_for(range_t(0, nBlocks, 1), body);
+    } else {
+        body(range_t(0, nBlocks, 1));
+    }
+
+    // groups are laid out one after another; blocks write their part of each group in order
+    double howFar[maxPackEdges];
+    size_t start = 0;
+    for(size_t e = 0; e < nEdges; ++e) {
+        howFar[e]   = 0;
+        farPoint[e] = edges[e].start;
+        size_t offset = start;
+        for(size_t b = 0; b < nBlocks; ++b) {
+            blocks[b].offset[e] = offset;
+            offset += blocks[b].count[e];
+            if(blocks[b].count[e] && blocks[b].howFar[e] > howFar[e]) {
+                howFar[e]   = blocks[b].howFar[e];
+                farPoint[e] = blocks[b].farPoint[e];
+            }
+        }
+        groupSize[e] = offset - start;
+        start = offset;
+    }
+}
+
+template <typename Source>
+void pack_scatter(const Source& src, size_t n, const edge_t* edges, size_t nEdges,
+                  const std::vector<pack_block_t>& blocks, point_t* dst) {
+    PackScatter<Source> body(src, n, edges, nEdges, &blocks[0], dst);
+    if(blocks.size() > 1) {
+        tbb::parallel_for(range_t(0, blocks.size(), 1), body);
+    } else {
+        body(range_t(0, blocks.size(), 1));
+    }
+}
+
+// Appends to H the hull vertices from a (inclusive) to b (exclusive), where P holds
+// the n points strictly left of a->b, farPoint is the farthest of them, and
+// scratch has room for n points.
+void hull_of_edge(point_t* P, point_t* scratch, size_t n,
+                  const point_t& a, const point_t& b, const point_t& farPoint,
+                  std::vector<point_t>& H);
+
+class HullOfEdge {
+    point_t              *P, *scratch;
+    size_t                n;
+    point_t               a, b, farPoint;
+    std::vector<point_t> &H;
+public:
+    HullOfEdge(point_t* _P, point_t* _scratch, size_t _n, const point_t& _a, const point_t& _b,
+               const point_t& _farPoint, std::vector<point_t>& _H)
+        : P(_P), scratch(_scratch), n(_n), a(_a), b(_b), farPoint(_farPoint), H(_H) {}
+
+    void operator()() const {
+        hull_of_edge(P, scratch, n, a, b, farPoint, H);
+    }
+};
+
+void hull_of_edge(point_t* P, point_t* scratch, size_t n,
+                  const point_t& a, const point_t& b, const point_t& farPoint,
+                  std::vector<point_t>& H) {
+    if(n < 2) {
+        H.push_back(a);
+        H.insert(H.end(), P, P+n);
+        return;
+    }
+
+    const edge_t edges[2] = { edge_t(a, farPoint), edge_t(farPoint, b) };
+    std::vector<pack_block_t> blocks;
+    size_t  groupSize[2];
+    point_t groupFar[2];
+    pack_count(static_cast<const point_t*>(P), n, edges, 2, blocks, groupSize, groupFar);
+    pack_scatter(static_cast<const point_t*>(P), n, edges, 2, blocks, scratch);
+
+    if(util::verbose) {
+        std::stringstream ss;
+        ss << n << " nodes in bucket"<< ", "
+            << "dividing by: [ " << a << ", " << b << " ], "
+            << "farthest node: " << farPoint;
+        util::OUTPUT.push_back(ss.str());
+    }
+
+    // the packed groups become the inputs of the children, and P their scratch
+    HullOfEdge left(scratch, P, groupSize[0], a, farPoint, groupFar[0], H);
+    if(n > cfg::serialHullCutoff) {
+        std::vector<point_t> H2;
+        HullOfEdge right(scratch+groupSize[0], P+groupSize[0], groupSize[1], farPoint, b, groupFar[1], H2);
+        tbb::parallel_invoke(left, right);
+        H.insert(H.end(), H2.begin(), H2.end());
+    } else {
+        left();
+        hull_of_edge(scratch+groupSize[0], P+groupSize[0], groupSize[1], farPoint, b, groupFar[1], H);
+    }
+}
+
+// Extreme points in x and y, found in one pass. Ties in x keep the first point
+// as FindXExtremum does; ties in y take an end of the run of points sharing
+// the extreme y, which is always a vertex of the hull.
+class FindExtremes {
+    const pointVec_t    &points;
+public:
+    static const size_t  grainSize = cfg::findExtremumGrainSize;
+    point_t              minX, maxX, minY, maxY;
+
+    explicit FindExtremes(const pointVec_t& _points)
+        : points(_points), minX(_points[0]), maxX(_points[0]), minY(_points[0]), maxY(_points[0]) {}
+
+    FindExtremes(const FindExtremes& fe, tbb::split)
+        : points(fe.points), minX(fe.minX), maxX(fe.maxX), minY(fe.minY), maxY(fe.maxY) {}
+
+    void operator()(const range_t& range) {
+        point_t tmp[orientationBlock];
+        for(size_t i = range.begin(); i < range.end(); i += orientationBlock) {
+            const size_t m = std::min(orientationBlock, range.end()-i);
+            const point_t *p = load_points(points, i, m, tmp);
+            for(size_t k = 0; k < m; ++k) {
+                if(p[k].x < minX.x) minX = p[k];
+                if(p[k].x > maxX.x) maxX = p[k];
+                if(lowerY(p[k], minY)) minY = p[k];
+                if(lowerY(maxY, p[k])) maxY = p[k];
+            }
+        }
+    }
+
+    void join(const FindExtremes& rhs) {
+        if(rhs.minX.x < minX.x) minX = rhs.minX;
+        if(rhs.maxX.x > maxX.x) maxX = rhs.maxX;
+        if(lowerY(rhs.minY, minY)) minY = rhs.minY;
+        if(lowerY(maxY, rhs.maxY)) maxY = rhs.maxY;
+    }
+
+private:
+    static bool lowerY(const point_t& a, const point_t& b) {
+        return a.y < b.y || (a.y == b.y && a.x > b.x);
+    }
+};
+
+class HullOfEdges {
+    point_t              *P, *scratch;
+    const size_t         *groupStart;
+    const edge_t         *edges;
+    const point_t        *groupFar;
+    std::vector<point_t> *H;
+public:
+    HullOfEdges(point_t* _P, point_t* _scratch, const size_t* _groupStart, const edge_t* _edges,
+                const point_t* _groupFar, std::vector<point_t>* _H)
+        : P(_P), scratch(_scratch), groupStart(_groupStart), edges(_edges), groupFar(_groupFar), H(_H) {}
+
+    void operator()(const range_t& range) const {
+        for(size_t e = range.begin(); e != range.end(); ++e) {
+            const size_t start = groupStart[e];
+            hull_of_edge(P+start, scratch+start, groupStart[e+1]-start,
+                         edges[e].start, edges[e].end, groupFar[e], H[e]);
+        }
+    }
+};
+
+void quickhull_inplace(const pointVec_t &points, pointVec_t &hull) {
+    if (points.size() < 2) {
+#if USECONCVEC
+        appendVector(points, hull);
+#else // STD::VECTOR
+        hull.insert(hull.end(), points.begin(), points.end());
+#endif // USECONCVEC
+        return;
+    }
+
+    const size_t n = points.size();
+    FindExtremes extremes(points);
+    tbb::parallel_reduce(range_t(0, n, FindExtremes::grainSize), extremes);
+
+    // The extremes in y that lie strictly beyond the line through the extremes
+    // in x are hull vertices too. The first pack, the only one reading the
+    // input, drops every point inside the polygon they form.
+    point_t corners[maxPackEdges];
+    size_t  nCorners = 0;
+    corners[nCorners++] = extremes.maxX;
+    if(util::cross_product(extremes.maxX, extremes.minX, extremes.minY) > 0) {
+        corners[nCorners++] = extremes.minY;
+    }
+    corners[nCorners++] = extremes.minX;
+    if(util::cross_product(extremes.minX, extremes.maxX, extremes.maxY) > 0) {
+        corners[nCorners++] = extremes.maxY;
+    }
+    edge_t edges[maxPackEdges] = { edge_t(corners[0], corners[0]), edge_t(corners[0], corners[0]),
+                                   edge_t(corners[0], corners[0]), edge_t(corners[0], corners[0]) };
+    for(size_t e = 0; e < nCorners; ++e) {
+        edges[e] = edge_t(corners[e], corners[(e+1) % nCorners]);
+    }
+
+    std::vector<pack_block_t> blocks;
+    size_t  groupSize[maxPackEdges];
+    point_t groupFar[maxPackEdges];
+    pack_count(points, n, edges, nCorners, blocks, groupSize, groupFar);
+    size_t groupStart[maxPackEdges+1];
+    groupStart[0] = 0;
+    for(size_t e = 0; e < nCorners; ++e) {
+        groupStart[e+1] = groupStart[e] + groupSize[e];
+    }
+    const size_t total = groupStart[nCorners];
+    std::vector<point_t> buffer(total+1), scratch(total+1);
+    if(total) {
+        pack_scatter(points, n, edges, nCorners, blocks, &buffer[0]);
+    }
+
+    std::vector<point_t> H[maxPackEdges];
+    tbb::parallel_for(range_t(0, nCorners, 1),
+                      HullOfEdges(&buffer[0], &scratch[0], groupStart, edges, groupFar, H));
+
+    for(size_t e = 0; e < nCorners; ++e) {
+#if USECONCVEC
+        appendVector(&H[e][0], H[e].size(), hull);
+#else // STD::VECTOR
+        hull.insert(hull.end(), H[e].begin(), H[e].end());
+#endif // USECONCVEC
+    }
+}
+
 int main(int argc, char* argv[]) {
     util::ParseInputArgs(argc, argv);
 
@@ -594,7 +987,8 @@ int main(int argc, char* argv[]) {
         tm_start = util::gettime();
         quickhull(points, hull, false);
         tm_end = util::gettime();
-        std::cout << "Time on " << nthreads << " threads: " << util::time_diff(tm_start, tm_end) << "  Points in hull: " << hull.size() << "\n";
+        std::cout << "Time on " << nthreads << " threads: " << util::time_diff(tm_start, tm_end) << "  Points in hull: " << hull.size()
+                  << "  Points/sec: " << points.size()/util::time_diff(tm_start, tm_end) << "\n";
     }
 
 #if USECONCVEC 
@@ -617,9 +1011,34 @@ int main(int argc, char* argv[]) {
         tm_start = util::gettime();
         quickhull(points, hull, true);
         tm_end = util::gettime();
-        std::cout << "Time on " << nthreads << " threads: " << util::time_diff(tm_start, tm_end) << "  Points in hull: " << hull.size() << "\n";
+        std::cout << "Time on " << nthreads << " threads: " << util::time_diff(tm_start, tm_end) << "  Points in hull: " << hull.size()
+                  << "  Points/sec: " << points.size()/util::time_diff(tm_start, tm_end) << "\n";
     }    
 
+#if USECONCVEC 
+    std::cout << "Starting TBB in-place partitioning version of QUICK HULL algorithm" << std::endl;
+#else
+    std::cout << "Starting STL in-place partitioning version of QUICK HULL algorithm" << std::endl;
+#endif
+
+    for(nthreads=cfg::threads.first; nthreads<=cfg::threads.last; nthreads=cfg::threads.step(nthreads)) {
+        pointVec_t      points;
+        pointVec_t      hull;
+
+        tbb::task_scheduler_init init(nthreads);
+
+        tm_init = util::gettime();
+        initialize<FillRNDPointsVector_buf>(points);
+        tm_start = util::gettime();
+        std::cout << "Init time on " << nthreads << " threads: " << util::time_diff(tm_init, tm_start) << "  Points in input: " << points.size() << "\n";
+
+        tm_start = util::gettime();
+        quickhull_inplace(points, hull);
+        tm_end = util::gettime();
+        std::cout << "Time on " << nthreads << " threads: " << util::time_diff(tm_start, tm_end) << "  Points in hull: " << hull.size()
+                  << "  Points/sec: " << points.size()/util::time_diff(tm_start, tm_end) << "\n";
+    }
+
     return 0;
 }
 
@@ -41,9 +41,13 @@ struct RunOptions{
     NumberType grainSize;
     // number of time to repeat calculation
     NumberType repeatNumber;
+    //! Use the segmented 2*3*5*7 wheel sieve
+    bool wheelFlag;
+    //! Segment size of the wheel sieve in bytes
+    NumberType segmentSize;
 
-    RunOptions(utility::thread_number_range threads, NumberType grainSize, NumberType n, bool silentFlag, NumberType repeatNumber)
-        : threads(threads), grainSize(grainSize), n(n), silentFlag(silentFlag), repeatNumber(repeatNumber)
+    RunOptions(utility::thread_number_range threads, NumberType grainSize, NumberType n, bool silentFlag, NumberType repeatNumber, bool wheelFlag, NumberType segmentSize)
+        : threads(threads), grainSize(grainSize), n(n), silentFlag(silentFlag), repeatNumber(repeatNumber), wheelFlag(wheelFlag), segmentSize(segmentSize)
     {}
 };
 
@@ -68,6 +72,8 @@ static RunOptions ParseCommandLine( int argc, const char* argv[] ) {
     bool silent = false;
     NumberType number = 100000000;
     NumberType repeatNumber = 1;
+    bool wheel = false;
+    NumberType segmentSize = 32768;
 
     utility::parse_cli_arguments(argc,argv,
         utility::cli_argument_pack()
@@ -77,9 +83,11 @@ static RunOptions ParseCommandLine( int argc, const char* argv[] ) {
             .positional_arg(grainSize,"grain-size","must be a positive integer")
             .positional_arg(repeatNumber,"n-of-repeats","repeat the calculation this number of times, must be a positive integer")
             .arg(silent,"silent","no output except elapsed time")
+            .arg(wheel,"wheel","use the segmented, bit-packed 2*3*5*7 wheel sieve")
+            .arg(segmentSize,"segment-size","segment size of the wheel sieve in bytes, should fit into L1 data cache")
     );
 
-    RunOptions options(threads,grainSize, number, silent, repeatNumber);
+    RunOptions options(threads,grainSize, number, silent, repeatNumber, wheel, segmentSize);
     return options;
 }
 
@@ -93,7 +101,16 @@ int main( int argc, const char* argv[] ) {
             tbb::tick_count iterationBeginMark = tbb::tick_count::now();
             NumberType count = 0;
             NumberType n = options.n;
-            if( p==0 ) {
+            if( options.wheelFlag ) {
+                NumberType segmentSize = options.segmentSize;
+                #if __TBB_MIC_OFFLOAD
+                #pragma offload target(mic) in(n, p, segmentSize) out(count)
+                #endif // __TBB_MIC_OFFLOAD
+                if( p==0 )
+                    count = SerialWheelCountPrimes(n, segmentSize);
+                else
+                    count = ParallelWheelCountPrimes(n, p, segmentSize);
+            } else if( p==0 ) {
                 #if __TBB_MIC_OFFLOAD
                 #pragma offload target(mic) in(n) out(count)
                 #endif // __TBB_MIC_OFFLOAD
@@ -115,6 +132,8 @@ int main( int argc, const char* argv[] ) {
                     std::cout<<p<<"-way parallelism";
                 else
                     std::cout<<"serial code";
+                if( options.wheelFlag )
+                    std::cout<<", wheel sieve";
                 std::cout<<")\n" ;
             }
         }
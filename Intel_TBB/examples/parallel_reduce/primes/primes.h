@@ -37,6 +37,15 @@ NumberType SerialCountPrimes( NumberType n);
 /** This is the parallel version. */
 NumberType ParallelCountPrimes( NumberType n, int numberOfThreads= tbb::task_scheduler_init::automatic, NumberType grainSize = 1000);
 
+//! Count number of primes between 0 and n
+/** This is the serial version of the segmented 2*3*5*7 wheel sieve. */
+NumberType SerialWheelCountPrimes( NumberType n, NumberType segmentBytes = 32768 );
+
+//! Count number of primes between 0 and n
+/** This is the parallel version of the segmented 2*3*5*7 wheel sieve.
+    segmentBytes should fit into L1 data cache. */
+NumberType ParallelWheelCountPrimes( NumberType n, int numberOfThreads= tbb::task_scheduler_init::automatic, NumberType segmentBytes = 32768 );
+
 #if __TBB_MIC_OFFLOAD
 #pragma offload_attribute (pop)
 #endif // __TBB_MIC_OFFLOAD
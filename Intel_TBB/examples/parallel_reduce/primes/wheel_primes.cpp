@@ -0,0 +1,325 @@
+/*
+    Copyright 2005-2016 Intel Corporation.  All Rights Reserved.
+
+    This file is part of Threading Building Blocks. Threading Building Blocks is free software;
+    you can redistribute it and/or modify it under the terms of the GNU General Public License
+    version 2  as  published  by  the  Free Software Foundation.  Threading Building Blocks is
+    distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+    implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See  the GNU General Public License for more details.   You should have received a copy of
+    the  GNU General Public License along with Threading Building Blocks; if not, write to the
+    Free Software Foundation, Inc.,  51 Franklin St,  Fifth Floor,  Boston,  MA 02110-1301 USA
+
+    As a special exception,  you may use this file  as part of a free software library without
+    restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+    functions from this file, or you compile this file and link it with other files to produce
+    an executable,  this file does not by itself cause the resulting executable to be covered
+    by the GNU General Public License. This exception does not however invalidate any other
+    reasons why the executable file might be covered by the GNU General Public License.
+*/
+
+// Segmented sieve of Eratosthenes with a 2*3*5*7 wheel.
+// Only numbers coprime to 210 are stored, one bit each, so every "rotation"
+// of the wheel (210 consecutive numbers) takes 48 bits. The sieve is swept in
+// segments that fit into the L1 data cache, and surviving bits are counted
+// with popcount. Besides one segment per worker, memory is proportional to
+// the number of sieving primes, i.e. to sqrt(n).
+
+#include "primes.h"
+
+#if __TBB_MIC_OFFLOAD
+#pragma offload_attribute (target(mic))
+#endif // __TBB_MIC_OFFLOAD
+#include <cassert>
+#include <cstring>
+#include <math.h>
+#include <vector>
+#include "tbb/parallel_reduce.h"
+#include "tbb/blocked_range.h"
+#include "tbb/task_scheduler_init.h"
+
+namespace {
+
+typedef unsigned long long SieveWord;
+const int WordBits = 64;
+
+//! Numbers per rotation of the wheel.
+const NumberType WheelSize = 2*3*5*7;
+//! Numbers coprime to WheelSize within one rotation.
+const int WheelSpokes = 48;
+
+//! Number of segments handed to a worker at once.
+const NumberType SegmentsPerChunk = 8;
+
+inline int popcount( SieveWord w ) {
+#if __GNUC__
+    return __builtin_popcountll(w);
+#else
+    int count = 0;
+    for( ; w; w &= w-1 )
+        ++count;
+    return count;
+#endif
+}
+
+//! Lookup tables describing the wheel.
+/** Number x coprime to 210 lives at bit 48*(x/210)+index_of[x%210]. */
+class WheelTables {
+public:
+    //! Residues coprime to 210, in increasing order.
+    NumberType residue[WheelSpokes];
+    //! Spoke index of a residue, or -1 if residue is not coprime to 210.
+    int index_of[WheelSize];
+    //! Smallest spoke whose residue is >=r, or WheelSpokes if there is none.
+    int next_spoke[WheelSize];
+    //! Number of spokes whose residue is <=r.
+    int spokes_upto[WheelSize];
+    //! residue[a]*residue[b] == 210*product_rotation[a][b] + residue[product_spoke[a][b]]
+    NumberType product_rotation[WheelSpokes][WheelSpokes];
+    unsigned char product_spoke[WheelSpokes][WheelSpokes];
+
+    WheelTables() {
+        int n_spokes = 0;
+        for( NumberType r=0; r<WheelSize; ++r ) {
+            if( r%2 && r%3 && r%5 && r%7 ) {
+                index_of[r] = n_spokes;
+                residue[n_spokes++] = r;
+            } else {
+                index_of[r] = -1;
+            }
+            spokes_upto[r] = n_spokes;
+        }
+        assert( n_spokes==WheelSpokes );
+        for( int r=WheelSize-1, s=WheelSpokes; r>=0; --r ) {
+            if( index_of[r]>=0 )
+                s = index_of[r];
+            next_spoke[r] = s;
+        }
+        for( int a=0; a<WheelSpokes; ++a )
+            for( int b=0; b<WheelSpokes; ++b ) {
+                NumberType product = residue[a]*residue[b];
+                product_rotation[a][b] = product/WheelSize;
+                product_spoke[a][b] = (unsigned char)index_of[product%WheelSize];
+            }
+    }
+};
+
+const WheelTables Wheel;
+
+//! Prime used to strike out multiples, split as 210*rotation+residue[spoke].
+struct SievingPrime {
+    NumberType prime;
+    NumberType rotation;
+    int spoke;
+};
+
+//! Sieving primes in [11..sqrt(n)], found with a plain sieve over odd numbers.
+class SievingPrimes {
+public:
+    std::vector<SievingPrime> primes;
+    explicit SievingPrimes( NumberType n ) {
+        NumberType m = NumberType(sqrt(double(n)));
+        while( m*m>n ) --m;
+        while( (m+1)*(m+1)<=n ) ++m;
+        std::vector<bool> is_composite(m/2+1,false);
+        for( NumberType i=3; i<=m; i+=2 ) {
+            if( is_composite[i/2] )
+                continue;
+            for( NumberType j=i*i; j<=m; j+=2*i )
+                is_composite[j/2] = true;
+            if( i>7 ) {
+                SievingPrime p;
+                p.prime = i;
+                p.rotation = i/WheelSize;
+                p.spoke = Wheel.index_of[i%WheelSize];
+                primes.push_back(p);
+            }
+        }
+    }
+};
+
+//! Bit-packed sieve over a run of consecutive segments.
+class WheelSegments {
+    const SievingPrimes& my_primes;
+
+    //! Rotations per segment.
+    const NumberType my_rotations;
+
+    //! Number of valid bits in the whole sieve, i.e. of 210-coprime numbers in [0..n].
+    const NumberType my_total_bits;
+
+    //! Bit set <=> composite. Sized for one segment.
+    std::vector<SieveWord> my_bits;
+
+    //! Per sieving prime, the next multiplier is 210*my_multiplier_rotation[k]+residue[my_multiplier_spoke[k]].
+    std::vector<NumberType> my_multiplier_rotation;
+    std::vector<unsigned char> my_multiplier_spoke;
+
+    //! Point multipliers at the first multiple of each prime that is >=max(p*p,first_rotation*210).
+    void initialize( NumberType first_rotation ) {
+        NumberType low = first_rotation*WheelSize;
+        size_t n_primes = my_primes.primes.size();
+        my_multiplier_rotation.resize(n_primes);
+        my_multiplier_spoke.resize(n_primes);
+        for( size_t k=0; k<n_primes; ++k ) {
+            NumberType p = my_primes.primes[k].prime;
+            NumberType q = (low+p-1)/p;
+            if( q<p )
+                q = p;
+            NumberType t = q/WheelSize;
+            int w = Wheel.next_spoke[q%WheelSize];
+            if( w==WheelSpokes ) {
+                w = 0;
+                ++t;
+            }
+            my_multiplier_rotation[k] = t;
+            my_multiplier_spoke[k] = (unsigned char)w;
+        }
+    }
+
+    //! Set the bits of all multiples falling into rotations [first,last).
+    void strike( NumberType first, NumberType last ) {
+        SieveWord* bits = &my_bits[0];
+        size_t n_primes = my_primes.primes.size();
+        for( size_t k=0; k<n_primes; ++k ) {
+            const SievingPrime& sp = my_primes.primes[k];
+            const NumberType* rotation_of_product = Wheel.product_rotation[sp.spoke];
+            const unsigned char* spoke_of_product = Wheel.product_spoke[sp.spoke];
+            NumberType t = my_multiplier_rotation[k];
+            int w = my_multiplier_spoke[k];
+            // Multiple p*(210*t+residue[w]) lies in rotation p*t+rotation*residue[w]+rotation_of_product[w].
+            NumberType base = sp.prime*t;
+            for(;;) {
+                NumberType r = base + sp.rotation*Wheel.residue[w] + rotation_of_product[w];
+                if( r>=last )
+                    break;
+                assert( r>=first );
+                NumberType bit = (r-first)*WheelSpokes + spoke_of_product[w];
+                bits[bit/WordBits] |= SieveWord(1)<<(bit%WordBits);
+                if( ++w==WheelSpokes ) {
+                    w = 0;
+                    ++t;
+                    base += sp.prime;
+                }
+            }
+            my_multiplier_rotation[k] = t;
+            my_multiplier_spoke[k] = (unsigned char)w;
+        }
+    }
+
+    //! Number of clear bits among the first n_bits of the segment.
+    NumberType count_clear( NumberType n_bits ) const {
+        NumberType n_set = 0;
+        NumberType full_words = n_bits/WordBits;
+        for( NumberType i=0; i<full_words; ++i )
+            n_set += popcount(my_bits[i]);
+        if( NumberType tail = n_bits%WordBits )
+            n_set += popcount(my_bits[full_words] & ((SieveWord(1)<<tail)-1));
+        return n_bits-n_set;
+    }
+
+public:
+    WheelSegments( const SievingPrimes& primes, NumberType rotations, NumberType total_bits ) :
+        my_primes(primes),
+        my_rotations(rotations),
+        my_total_bits(total_bits),
+        my_bits((rotations*WheelSpokes+WordBits-1)/WordBits)
+    {}
+
+    NumberType rotations() const {return my_rotations;}
+
+    //! Count primes (other than 2, 3, 5, 7) in segments [first_segment,last_segment).
+    NumberType count_primes( NumberType first_segment, NumberType last_segment ) {
+        NumberType count = 0;
+        initialize( first_segment*my_rotations );
+        for( NumberType s=first_segment; s<last_segment; ++s ) {
+            NumberType first = s*my_rotations;
+            NumberType first_bit = first*WheelSpokes;
+            if( first_bit>=my_total_bits )
+                break;
+            memset( &my_bits[0], 0, my_bits.size()*sizeof(SieveWord) );
+            if( first==0 )
+                my_bits[0] |= 1;    // 1 is not a prime
+            strike( first, first+my_rotations );
+            NumberType n_bits = my_rotations*WheelSpokes;
+            if( first_bit+n_bits>my_total_bits )
+                n_bits = my_total_bits-first_bit;
+            count += count_clear( n_bits );
+        }
+        return count;
+    }
+};
+
+//! Body for parallel_reduce over segment indices.
+class WheelSieve {
+    const SievingPrimes& my_primes;
+    const NumberType my_rotations;
+    const NumberType my_total_bits;
+public:
+    NumberType count;
+
+    WheelSieve( const SievingPrimes& primes, NumberType rotations, NumberType total_bits ) :
+        my_primes(primes), my_rotations(rotations), my_total_bits(total_bits), count(0)
+    {}
+    WheelSieve( WheelSieve& other, tbb::split ) :
+        my_primes(other.my_primes), my_rotations(other.my_rotations), my_total_bits(other.my_total_bits), count(0)
+    {}
+    void operator()( const tbb::blocked_range<NumberType>& r ) {
+        // Segment storage is allocated per chunk so that each worker only touches its own cache.
+        WheelSegments segments( my_primes, my_rotations, my_total_bits );
+        count += segments.count_primes( r.begin(), r.end() );
+    }
+    void join( WheelSieve& other ) {
+        count += other.count;
+    }
+};
+
+NumberType small_prime_count( NumberType n ) {
+    return (n>=2) + (n>=3) + (n>=5) + (n>=7);
+}
+
+NumberType total_bits( NumberType n ) {
+    return n/WheelSize*WheelSpokes + Wheel.spokes_upto[n%WheelSize];
+}
+
+NumberType rotations_per_segment( NumberType segment_bytes ) {
+    NumberType rotations = segment_bytes*8/WheelSpokes;
+    return rotations ? rotations : 1;
+}
+
+NumberType segment_count( NumberType n, NumberType rotations ) {
+    return (n/WheelSize+1+rotations-1)/rotations;
+}
+
+} // namespace
+
+//! Count number of primes between 0 and n
+/** This is the serial version of the wheel sieve. */
+NumberType SerialWheelCountPrimes( NumberType n, NumberType segmentBytes ) {
+    NumberType count = small_prime_count(n);
+    if( n>=11 ) {
+        SievingPrimes primes(n);
+        NumberType rotations = rotations_per_segment(segmentBytes);
+        WheelSegments segments( primes, rotations, total_bits(n) );
+        count += segments.count_primes( 0, segment_count(n,rotations) );
+    }
+    return count;
+}
+
+//! Count number of primes between 0 and n
+/** This is the parallel version of the wheel sieve. */
+NumberType ParallelWheelCountPrimes( NumberType n, int number_of_threads, NumberType segmentBytes ) {
+    tbb::task_scheduler_init init(number_of_threads);
+
+    NumberType count = small_prime_count(n);
+    if( n>=11 ) {
+        SievingPrimes primes(n);
+        NumberType rotations = rotations_per_segment(segmentBytes);
+        WheelSieve s( primes, rotations, total_bits(n) );
+        // Each chunk pays for locating the first multiple of every sieving prime,
+        // so chunks span several segments to amortize that cost.
+        tbb::parallel_reduce( tbb::blocked_range<NumberType>( 0, segment_count(n,rotations), SegmentsPerChunk ), s );
+        count += s.count;
+    }
+    return count;
+}
@@ -30,8 +30,24 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cctype>
+#include <climits>
+#include <vector>
 #include "../../common/utility/utility.h"
 
+#if _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if __SSE4_1__
+#include <smmintrin.h>
+#endif
+
 extern void generate_if_needed(const char*);
 
 using namespace std;
@@ -183,9 +199,260 @@ void* MyOutputFilter::operator()( void* item ) {
     return NULL;
 }
 
+//! Read-only view of the whole input file
+/** Mapped into memory where possible, so the pipeline reads the characters in place. */
+class MappedFile {
+    const char* my_begin;
+    size_t my_size;
+#if _WIN32
+    std::vector<char> my_data;
+#endif
+public:
+    MappedFile( const char* name ) : my_begin(NULL), my_size(0) {
+#if _WIN32
+        std::ifstream in( name, std::ios::binary );
+        if( !in )
+            throw std::invalid_argument( (string("Invalid input file name: ")+name).c_str() );
+        my_data.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+        my_size = my_data.size();
+        if( my_size ) my_begin = &my_data[0];
+#else
+        int fd = open( name, O_RDONLY );
+        if( fd<0 )
+            throw std::invalid_argument( (string("Invalid input file name: ")+name).c_str() );
+        struct stat st;
+        if( fstat( fd, &st )==0 && st.st_size>0 ) {
+            void* p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( p==MAP_FAILED ) {
+                close( fd );
+                throw std::runtime_error( (string("Could not map input file: ")+name).c_str() );
+            }
+            madvise( p, st.st_size, MADV_SEQUENTIAL );
+            my_begin = static_cast<const char*>(p);
+            my_size = st.st_size;
+        }
+        close( fd );
+#endif
+    }
+    ~MappedFile() {
+#if !_WIN32
+        if( my_size ) munmap( const_cast<char*>(my_begin), my_size );
+#endif
+    }
+    const char* begin() const {return my_begin;}
+    const char* end() const {return my_begin+my_size;}
+    size_t size() const {return my_size;}
+};
+
+//! Item of the mapped pipeline: a view into the input and the buffer for its output
+struct MappedSlice {
+    const char* first;
+    const char* last;
+    TextSlice* out;
+};
+
+//! Input filter that cuts the mapped file into slices ending at number boundaries
+/** The slices refer to the mapped characters, nothing is copied.  The items come from
+    a ring of as many slices as there are tokens: the output filter is serial_in_order,
+    so by the time the pipeline lets item i+ntokens in, item i has left it and its
+    output buffer can be used again. */
+class MappedInputFilter: public tbb::filter {
+public:
+    MappedInputFilter( const MappedFile& file, size_t ntokens );
+    ~MappedInputFilter();
+private:
+    const char* next;
+    const char* end;
+    std::vector<MappedSlice> ring;
+    size_t ring_index;
+    /*override*/ void* operator()(void*);
+};
+
+MappedInputFilter::MappedInputFilter( const MappedFile& file, size_t ntokens ) :
+    filter(serial_in_order),
+    next(file.begin()),
+    end(file.end()),
+    ring(ntokens),
+    ring_index(0)
+{
+    for( size_t i=0; i<ring.size(); ++i )
+        ring[i].out = TextSlice::allocate( 2*MAX_CHAR_PER_INPUT_SLICE );
+}
+
+MappedInputFilter::~MappedInputFilter() {
+    for( size_t i=0; i<ring.size(); ++i )
+        ring[i].out->free();
+}
+
+void* MappedInputFilter::operator()(void*) {
+    if( next==end )
+        return NULL;
+    const char* p = next;
+    if( size_t(end-next)>MAX_CHAR_PER_INPUT_SLICE ) {
+        // Do not split a number: cut before the digits at the end of the slice,
+        // or after them if the whole slice is one number.
+        p = next+MAX_CHAR_PER_INPUT_SLICE;
+        while( p>next && isdigit(p[-1]) )
+            --p;
+        if( p==next ) {
+            p = next+MAX_CHAR_PER_INPUT_SLICE;
+            while( p<end && isdigit(*p) )
+                ++p;
+        }
+    } else {
+        p = end;
+    }
+    MappedSlice& s = ring[ring_index];
+    ring_index = (ring_index+1)%ring.size();
+    s.first = next;
+    s.last = p;
+    next = p;
+    return &s;
+}
+
+//! Parses the run of digits at p like strtol, saturating at LONG_MAX
+static inline const char* parse_digits( const char* p, const char* end, unsigned long& x ) {
+    x = 0;
+    for( ; p<end && isdigit(*p); ++p ) {
+        unsigned d = *p-'0';
+        x = x>(LONG_MAX-d)/10 ? LONG_MAX : x*10+d;
+    }
+    return p;
+}
+
+#if __SSE4_1__
+//! Parses a run of fewer than 16 digits from the 16 characters at p
+/** Returns NULL if all 16 characters are digits, then the caller parses the run by parse_digits. */
+static inline const char* parse_digits16( const char* p, unsigned long& x ) {
+    __m128i v = _mm_sub_epi8( _mm_loadu_si128( (const __m128i*)p ), _mm_set1_epi8('0') );
+    // Digits are the characters that are below 10 after the subtraction
+    unsigned digits = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( v, _mm_set1_epi8(9) ), v ) );
+    // Bit 16 of ~digits is always set, so n is at most 16
+    int n = __builtin_ctz( ~digits );
+    if( n==16 )
+        return NULL;
+    // Move the digits to the end of the register, shifting in zeros: the shuffle
+    // index i+n-16 is negative, and so selects zero, for the first 16-n bytes.
+    v = _mm_shuffle_epi8( v, _mm_add_epi8( _mm_setr_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15), _mm_set1_epi8(char(n-16)) ) );
+    // Combine digits into pairs, quads and two halves of eight digits
+    v = _mm_maddubs_epi16( v, _mm_setr_epi8(10,1,10,1,10,1,10,1,10,1,10,1,10,1,10,1) );
+    v = _mm_madd_epi16( v, _mm_setr_epi16(100,1,100,1,100,1,100,1) );
+    v = _mm_packus_epi32( v, v );
+    v = _mm_madd_epi16( v, _mm_setr_epi16(10000,1,10000,1,10000,1,10000,1) );
+    x = (unsigned long)(unsigned)_mm_cvtsi128_si32( v )*100000000UL + (unsigned)_mm_extract_epi32( v, 1 );
+    return p+n;
+}
+#endif
+
+static const char digit_pairs[] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+static const unsigned long long powers_of_10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+//! Writes y in decimal at q, two digits at a time from a table; returns the end of the digits
+static inline char* format_long( long y, char* q ) {
+    unsigned long u = y;
+    if( y<0 ) {
+        *q++ = '-';
+        u = 0-u;
+    }
+    int n = 1;
+    while( n<int(sizeof(powers_of_10)/sizeof(powers_of_10[0])) && u>=powers_of_10[n] )
+        ++n;
+    char* e = q+n;
+    char* w = e;
+    while( u>=100 ) {
+        unsigned r = unsigned(u%100);
+        u /= 100;
+        w -= 2;
+        memcpy( w, digit_pairs+2*r, 2 );
+    }
+    if( u>=10 ) {
+        w -= 2;
+        memcpy( w, digit_pairs+2*u, 2 );
+    } else {
+        *--w = char('0'+u);
+    }
+    return e;
+}
+
+//! Filter that squares the numbers of a mapped slice into its output buffer
+class MappedTransformFilter: public tbb::filter {
+public:
+    MappedTransformFilter();
+    /*override*/void* operator()( void* item );
+};
+
+MappedTransformFilter::MappedTransformFilter() :
+    tbb::filter(parallel)
+{}
+
+/*override*/void* MappedTransformFilter::operator()( void* item ) {
+    MappedSlice& s = *static_cast<MappedSlice*>(item);
+    const char* p = s.first;
+    const char* end = s.last;
+    // A slice can be longer than MAX_CHAR_PER_INPUT_SLICE only if it is one long number.
+    if( s.out->size()+s.out->avail() < 2*size_t(end-p) ) {
+        s.out->free();
+        s.out = TextSlice::allocate( 2*(end-p) );
+    }
+    char* q = s.out->begin();
+    for(;;) {
+        while( p<end && !isdigit(*p) )
+            *q++ = *p++;
+        if( p==end )
+            break;
+        unsigned long x;
+        const char* next = NULL;
+#if __SSE4_1__
+        // The 16 characters loaded must be inside the slice, or the load may cross the end of the mapping.
+        if( end-p>=16 )
+            next = parse_digits16( p, x );
+#endif
+        p = next ? next : parse_digits( p, end, x );
+        q = format_long( long(x*x), q );
+    }
+    s.out->set_end(q);
+    return &s;
+}
+
+//! Filter that writes the output buffer of each mapped slice to a file
+/** The buffer itself stays with the slice, to be used again by a later item. */
+class MappedOutputFilter: public tbb::filter {
+    FILE* my_output_file;
+public:
+    MappedOutputFilter( FILE* output_file );
+    /*override*/void* operator()( void* item );
+};
+
+MappedOutputFilter::MappedOutputFilter( FILE* output_file ) :
+    tbb::filter(serial_in_order),
+    my_output_file(output_file)
+{
+}
+
+void* MappedOutputFilter::operator()( void* item ) {
+    TextSlice& out = *static_cast<MappedSlice*>(item)->out;
+    size_t n = fwrite( out.begin(), 1, out.size(), my_output_file );
+    if( n!=out.size() ) {
+        fprintf(stderr,"Can't write into file '%s'\n", OutputFileName.c_str());
+        exit(1);
+    }
+    return NULL;
+}
+
 bool silent = false;
+bool mapped = false;
 
-int run_pipeline( int nthreads )
+//! Runs the pipeline of slices read into memory; returns the number of characters read
+size_t run_stream_pipeline( size_t ntokens, double& seconds )
 {
     FILE* input_file = fopen( InputFileName.c_str(), "r" );
     if( !input_file ) {
@@ -215,15 +482,54 @@ int run_pipeline( int nthreads )
 
     // Run the pipeline
     tbb::tick_count t0 = tbb::tick_count::now();
-    // Need more than one token in flight per thread to keep all threads 
-    // busy; 2-4 works
-    pipeline.run( nthreads*4 );
+    pipeline.run( ntokens );
     tbb::tick_count t1 = tbb::tick_count::now();
 
+    size_t input_size = ftell( input_file );
     fclose( output_file );
     fclose( input_file );
 
-    if ( !silent ) printf("time = %g\n", (t1-t0).seconds());
+    seconds = (t1-t0).seconds();
+    return input_size;
+}
+
+//! Runs the pipeline of views into the mapped input; returns the number of characters read
+size_t run_mapped_pipeline( size_t ntokens, double& seconds )
+{
+    MappedFile input( InputFileName.c_str() );
+    FILE* output_file = fopen( OutputFileName.c_str(), "w" );
+    if( !output_file ) {
+        throw std::invalid_argument( ("Invalid output file name: "+OutputFileName).c_str() );
+        return 0;
+    }
+
+    tbb::pipeline pipeline;
+    MappedInputFilter input_filter( input, ntokens );
+    pipeline.add_filter( input_filter );
+    MappedTransformFilter transform_filter;
+    pipeline.add_filter( transform_filter );
+    MappedOutputFilter output_filter( output_file );
+    pipeline.add_filter( output_filter );
+
+    tbb::tick_count t0 = tbb::tick_count::now();
+    pipeline.run( ntokens );
+    tbb::tick_count t1 = tbb::tick_count::now();
+
+    fclose( output_file );
+
+    seconds = (t1-t0).seconds();
+    return input.size();
+}
+
+int run_pipeline( int nthreads )
+{
+    // Need more than one token in flight per thread to keep all threads 
+    // busy; 2-4 works
+    const size_t ntokens = nthreads*4;
+    double seconds;
+    size_t input_size = mapped ? run_mapped_pipeline( ntokens, seconds ) : run_stream_pipeline( ntokens, seconds );
+
+    if ( !silent ) printf("time = %g, %g MB/sec\n", seconds, input_size/seconds/1e6);
 
     return 1;
 }
@@ -244,6 +550,7 @@ int main( int argc, char* argv[] ) {
             .positional_arg(OutputFileName,"output-file","output file name")
             .positional_arg(MAX_CHAR_PER_INPUT_SLICE, "max-slice-size","the maximum number of characters in one slice")
             .arg(silent,"silent","no output except elapsed time")
+            .arg(mapped,"mapped","read the input through a memory mapping and parse the numbers in place")
             );
         generate_if_needed( InputFileName.c_str() );
 
@@ -0,0 +1,85 @@
+/*
+    Copyright 2005-2016 Intel Corporation.  All Rights Reserved.
+
+    This file is part of Threading Building Blocks. Threading Building Blocks is free software;
+    you can redistribute it and/or modify it under the terms of the GNU General Public License
+    version 2  as  published  by  the  Free Software Foundation.  Threading Building Blocks is
+    distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+    implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+    See  the GNU General Public License for more details.   You should have received a copy of
+    the  GNU General Public License along with Threading Building Blocks; if not, write to the
+    Free Software Foundation, Inc.,  51 Franklin St,  Fifth Floor,  Boston,  MA 02110-1301 USA
+
+    As a special exception,  you may use this file  as part of a free software library without
+    restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+    functions from this file, or you compile this file and link it with other files to produce
+    an executable,  this file does not by itself cause the resulting executable to be covered
+    by the GNU General Public License. This exception does not however invalidate any other
+    reasons why the executable file might be covered by the GNU General Public License.
+*/
+
+#include "common.h"
+#include "tbb/task.h"
+
+static Value SerialSumCompactSubtree( const CompactTreeNode* tree, int root ) {
+    const CompactTreeNode& node = tree[root];
+    Value result = node.value;
+    if( node.left>=0 )
+        result += SerialSumCompactSubtree(tree, node.left);
+    if( node.right>=0 )
+        result += SerialSumCompactSubtree(tree, node.right);
+    return result;
+}
+
+Value SerialSumCompactTree( CompactTreeNode* tree ) {
+    return SerialSumCompactSubtree(tree, 0);
+}
+
+// Same scheme as OptimizedSumTask, with nodes addressed by index
+class OptimizedCompactSumTask: public tbb::task {
+    Value* const sum;
+    const CompactTreeNode* tree;
+    int root;
+    bool is_continuation;
+    Value x, y;
+public:
+    OptimizedCompactSumTask( const CompactTreeNode* tree_, int root_, Value* sum_ ) : sum(sum_), tree(tree_), root(root_), is_continuation(false) {
+    }
+    tbb::task* execute() {
+        tbb::task* next = NULL;
+        const CompactTreeNode& node = tree[root];
+        if( !is_continuation ) {
+            if( node.node_count<1000 ) {
+                *sum = SerialSumCompactSubtree(tree, root);
+            } else {
+                // Create tasks before spawning any of them.
+                tbb::task* a = NULL;
+                tbb::task* b = NULL;
+                if( node.left>=0 )
+                    a = new( allocate_child() ) OptimizedCompactSumTask(tree,node.left,&x);
+                if( node.right>=0 )
+                    b = new( allocate_child() ) OptimizedCompactSumTask(tree,node.right,&y);
+                recycle_as_continuation();
+                is_continuation = true;
+                set_ref_count( (a!=NULL)+(b!=NULL) );
+                if( a ) {
+                    if( b ) spawn(*b);
+                } else 
+                    a = b;
+                next = a;
+            }
+        } else {
+            *sum = node.value;
+            if( node.left>=0 ) *sum += x;
+            if( node.right>=0 ) *sum += y;
+        } 
+        return next;
+    }
+};
+
+Value OptimizedParallelSumCompactTree( CompactTreeNode* tree ) {
+    Value sum;
+    OptimizedCompactSumTask& a = *new(tbb::task::allocate_root()) OptimizedCompactSumTask(tree,0,&sum);
+    tbb::task::spawn_root_and_wait(a);
+    return sum;
+}
@@ -21,8 +21,11 @@
 #ifndef TREE_MAKER_H_
 #define TREE_MAKER_H_
 
+#include <vector>
 #include "tbb/tick_count.h"
 #include "tbb/task.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 
 static double Pi = 3.14159265358979;
 
@@ -66,6 +69,121 @@ class TreeMaker {
         }
     };
 
+    // Fills the subtree of number_of_nodes nodes rooted at my_root in depth-first order:
+    // the left subtree starts right after my_root and the right one after the left one,
+    // so every task writes its own contiguous slice of the pool.
+    class PoolSubTreeCreationTask: public tbb::task {
+        TreeNode* my_root;
+        bool is_continuation;
+        typedef TreeMaker<use_tbbmalloc> MyTreeMaker;
+
+    public:
+        PoolSubTreeCreationTask( TreeNode* root, long number_of_nodes ) : my_root(root), is_continuation(false) {
+            my_root->node_count = number_of_nodes;
+            my_root->value = Value(Pi*number_of_nodes);
+        }
+
+        tbb::task* execute() {
+            tbb::task* next = NULL;
+            if( !is_continuation ) {
+                long subtree_size = my_root->node_count - 1;
+                TreeNode* left = my_root + 1;
+                TreeNode* right = left + subtree_size/2;
+                if( subtree_size<1000 ) { /* grainsize */
+                    my_root->left  = MyTreeMaker::fill_in_one_thread(left, subtree_size/2);
+                    my_root->right = MyTreeMaker::fill_in_one_thread(right, subtree_size - subtree_size/2);
+                } else {
+                    my_root->left  = left;
+                    my_root->right = right;
+                    // Create tasks before spawning any of them.
+                    tbb::task* a = new( allocate_child() ) PoolSubTreeCreationTask(left,subtree_size/2);
+                    tbb::task* b = new( allocate_child() ) PoolSubTreeCreationTask(right,subtree_size - subtree_size/2);
+                    recycle_as_continuation();
+                    is_continuation = true;
+                    set_ref_count(2);
+                    spawn(*b);
+                    next = a;
+                }
+            } 
+            return next;
+        }
+    };
+
+    //! A subtree still to be laid out, and the pointer that must be set to its root
+    struct PendingSubTree {
+        long number_of_nodes;
+        TreeNode** link;
+    };
+
+    // Lays out the top height levels of a subtree in van Emde Boas order from next on:
+    // first the top half of those levels, then each subtree below it, all recursively.
+    // Subtrees hanging below the last level are appended to below.
+    static void layout_veb( long number_of_nodes, int height, TreeNode** link, TreeNode*& next, std::vector<PendingSubTree>& below ) {
+        if( number_of_nodes==0 ) {
+            *link = NULL;
+        } else if( height==1 ) {
+            TreeNode* n = next++;
+            n->node_count = number_of_nodes;
+            n->value = Value(Pi*number_of_nodes);
+            *link = n;
+            --number_of_nodes;
+            PendingSubTree l = { number_of_nodes/2, &n->left };
+            PendingSubTree r = { number_of_nodes - number_of_nodes/2, &n->right };
+            below.push_back(l);
+            below.push_back(r);
+        } else {
+            std::vector<PendingSubTree> middle;
+            layout_veb( number_of_nodes, height/2, link, next, middle );
+            for( size_t i=0; i<middle.size(); ++i )
+                layout_veb( middle[i].number_of_nodes, height - height/2, middle[i].link, next, below );
+        }
+    }
+
+    // Lays out whole subtrees below the top of a van Emde Boas tree, each in its own slice
+    class VebBottomBody {
+        const PendingSubTree* my_subtrees;
+        TreeNode* const* my_slices;
+        int my_height;
+    public:
+        VebBottomBody( const PendingSubTree* subtrees, TreeNode* const* slices, int height ) :
+            my_subtrees(subtrees), my_slices(slices), my_height(height) {}
+        void operator()( const tbb::blocked_range<size_t>& r ) const {
+            std::vector<PendingSubTree> below;
+            for( size_t i=r.begin(); i!=r.end(); ++i ) {
+                TreeNode* next = my_slices[i];
+                layout_veb( my_subtrees[i].number_of_nodes, my_height, my_subtrees[i].link, next, below );
+                for( size_t j=0; j<below.size(); ++j )
+                    *below[j].link = NULL;
+                below.clear();
+            }
+        }
+    };
+
+    // Translates a depth-first pool into indices
+    class CompactCopyBody {
+        const TreeNode* my_pool;
+        CompactTreeNode* my_tree;
+    public:
+        CompactCopyBody( const TreeNode* pool, CompactTreeNode* tree ) : my_pool(pool), my_tree(tree) {}
+        void operator()( const tbb::blocked_range<long>& r ) const {
+            for( long i=r.begin(); i!=r.end(); ++i ) {
+                const TreeNode& n = my_pool[i];
+                my_tree[i].left  = n.left  ? int(n.left - my_pool)  : -1;
+                my_tree[i].right = n.right ? int(n.right - my_pool) : -1;
+                my_tree[i].node_count = int(n.node_count);
+                my_tree[i].value = n.value;
+            }
+        }
+    };
+
+    static int tree_height( long number_of_nodes ) {
+        int height = 0;
+        // the right subtree is never smaller than the left one
+        for( ; number_of_nodes>0; number_of_nodes -= 1 + (number_of_nodes-1)/2 )
+            ++height;
+        return height;
+    }
+
 public:
     static TreeNode* allocate_node() {
         return use_tbbmalloc? tbb::scalable_allocator<TreeNode>().allocate(1) : new TreeNode;
@@ -92,6 +210,77 @@ public:
         return root_node;
     }
 
+    static TreeNode* allocate_pool( long number_of_nodes ) {
+        return use_tbbmalloc? tbb::scalable_allocator<TreeNode>().allocate(number_of_nodes) : new TreeNode[number_of_nodes];
+    }
+
+    static TreeNode* fill_in_one_thread( TreeNode* n, long number_of_nodes ) {
+        if( number_of_nodes==0 ) {
+            return NULL;
+        } else {
+            n->node_count = number_of_nodes;
+            n->value = Value(Pi*number_of_nodes);
+            --number_of_nodes;
+            n->left  = fill_in_one_thread( n + 1, number_of_nodes/2 );
+            n->right = fill_in_one_thread( n + 1 + number_of_nodes/2, number_of_nodes - number_of_nodes/2 );
+            return n;
+        }
+    }
+
+    //! Same tree, with all nodes in one pool in depth-first order
+    static TreeNode* create_dfs_pool( long number_of_nodes ) {
+        TreeNode* root = allocate_pool( number_of_nodes );
+        PoolSubTreeCreationTask& a = *new(tbb::task::allocate_root()) PoolSubTreeCreationTask(root, number_of_nodes);
+        tbb::task::spawn_root_and_wait(a);
+        return root;
+    }
+
+    //! Same tree, with all nodes in one pool in van Emde Boas order
+    /** The top half of the levels is laid out serially; the subtrees below it fill
+        their own slices of the pool in parallel. */
+    static TreeNode* create_veb_pool( long number_of_nodes ) {
+        TreeNode* pool = allocate_pool( number_of_nodes );
+        TreeNode* root;
+        TreeNode* next = pool;
+        int height = tree_height( number_of_nodes );
+        std::vector<PendingSubTree> below;
+        layout_veb( number_of_nodes, height - height/2, &root, next, below );
+        std::vector<TreeNode*> slices( below.size() );
+        for( size_t i=0; i<below.size(); ++i ) {
+            slices[i] = next;
+            next += below[i].number_of_nodes;
+        }
+        if( !below.empty() )
+            tbb::parallel_for( tbb::blocked_range<size_t>(0, below.size()), VebBottomBody(&below[0], &slices[0], height/2) );
+        return root;
+    }
+
+    //! Index-based copy of a tree made by create_dfs_pool
+    static CompactTreeNode* create_compact( TreeNode* dfs_root, long number_of_nodes ) {
+        CompactTreeNode* tree = use_tbbmalloc? tbb::scalable_allocator<CompactTreeNode>().allocate(number_of_nodes) : new CompactTreeNode[number_of_nodes];
+        tbb::parallel_for( tbb::blocked_range<long>(0, number_of_nodes, 10000), CompactCopyBody(dfs_root, tree) );
+        return tree;
+    }
+
+    static void create_layouts_and_time( long number_of_nodes, TreeNode*& dfs_root, TreeNode*& veb_root, CompactTreeNode*& compact, bool silent=false ) {
+        tbb::tick_count t0, t1;
+
+        t0 = tbb::tick_count::now();
+        dfs_root = create_dfs_pool( number_of_nodes );
+        t1 = tbb::tick_count::now();
+        if ( !silent ) printf ("%24s: time = %.1f msec\n", "dfs pool created", (t1-t0).seconds()*1000);
+
+        t0 = tbb::tick_count::now();
+        veb_root = create_veb_pool( number_of_nodes );
+        t1 = tbb::tick_count::now();
+        if ( !silent ) printf ("%24s: time = %.1f msec\n", "veb pool created", (t1-t0).seconds()*1000);
+
+        t0 = tbb::tick_count::now();
+        compact = create_compact( dfs_root, number_of_nodes );
+        t1 = tbb::tick_count::now();
+        if ( !silent ) printf ("%24s: time = %.1f msec\n", "compact copy created", (t1-t0).seconds()*1000);
+    }
+
     static TreeNode* create_and_time( long number_of_nodes, bool silent=false ) {
         tbb::tick_count t0, t1;
         TreeNode* root = allocate_node();
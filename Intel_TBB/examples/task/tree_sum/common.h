@@ -31,6 +31,21 @@ struct TreeNode {
     Value value;
 };
 
+//! Node of a tree stored in one array in depth-first order, linked by indices.
+/** Half the size of a TreeNode on 64-bit platforms. */
+struct CompactTreeNode {
+    //! Index of left subtree, or -1
+    int left;
+    //! Index of right subtree, or -1
+    int right;
+    //! Number of nodes in this subtree, including this node.
+    int node_count;
+    //! Value associated with the node.
+    Value value;
+};
+
 Value SerialSumTree( TreeNode* root );
 Value SimpleParallelSumTree( TreeNode* root );
 Value OptimizedParallelSumTree( TreeNode* root );
+Value SerialSumCompactTree( CompactTreeNode* tree );
+Value OptimizedParallelSumCompactTree( CompactTreeNode* tree );
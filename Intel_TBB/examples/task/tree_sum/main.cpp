@@ -43,13 +43,53 @@
 
 using namespace std;
 
-void Run( const char* which, Value(*SumTree)(TreeNode*), TreeNode* root, bool silent) {
+template<typename Node>
+void Run( const char* which, Value(*SumTree)(Node*), Node* root, bool silent) {
     tbb::tick_count t0;
     if ( !silent ) t0 = tbb::tick_count::now();
     Value result = SumTree(root);
     if ( !silent ) printf ("%24s: time = %.1f msec, sum=%g\n", which, (tbb::tick_count::now()-t0).seconds()*1000, result);
 }
 
+//! The same tree in each of the memory layouts being compared
+struct TreeLayouts {
+    //! Nodes allocated one by one
+    TreeNode* root;
+    //! Nodes in one pool, depth-first order
+    TreeNode* dfs_root;
+    //! Nodes in one pool, van Emde Boas order
+    TreeNode* veb_root;
+    //! Depth-first order, linked by indices
+    CompactTreeNode* compact;
+};
+
+template<bool use_tbbmalloc>
+void CreateTrees( long number_of_nodes, TreeLayouts& trees, bool silent ) {
+    trees.root = TreeMaker<use_tbbmalloc>::create_and_time( number_of_nodes, silent );
+    TreeMaker<use_tbbmalloc>::create_layouts_and_time( number_of_nodes, trees.dfs_root, trees.veb_root, trees.compact, silent );
+}
+
+//! Runs the serial or the parallel versions on every layout
+void RunLayouts( const TreeLayouts& trees, bool serial, bool silent ) {
+    const char* names[] = { "individual nodes", "dfs pool", "veb pool" };
+    TreeNode* roots[] = { trees.root, trees.dfs_root, trees.veb_root };
+    for( int i = 0; i < 3; ++i ) {
+        if ( !silent ) printf("layout = %s\n", names[i] );
+        if ( serial ) {
+            Run ( "SerialSumTree", SerialSumTree, roots[i], silent );
+        } else {
+            Run ( "SimpleParallelSumTree", SimpleParallelSumTree, roots[i], silent );
+            Run ( "OptimizedParallelSumTree", OptimizedParallelSumTree, roots[i], silent );
+        }
+    }
+    if ( !silent ) printf("layout = compact index\n" );
+    if ( serial ) {
+        Run ( "SerialSumTree", SerialSumCompactTree, trees.compact, silent );
+    } else {
+        Run ( "OptimizedParallelSumTree", OptimizedParallelSumCompactTree, trees.compact, silent );
+    }
+}
+
 int main( int argc, const char *argv[] ) {
     try{
         tbb::tick_count mainStartTime = tbb::tick_count::now();
@@ -70,34 +110,35 @@ int main( int argc, const char *argv[] ) {
             .arg(use_stdmalloc,"stdmalloc","use standard allocator")
         );
 
-        TreeNode* root;
+        TreeLayouts trees;
         { // In this scope, TBB will use default number of threads for tree creation
             tbb::task_scheduler_init init;
 
             if( use_stdmalloc ) {
                 if ( !silent ) printf("Tree creation using standard operator new\n");
-                root = TreeMaker<stdmalloc>::create_and_time( number_of_nodes, silent );
+                CreateTrees<stdmalloc>( number_of_nodes, trees, silent );
             } else {
                 if ( !silent ) printf("Tree creation using TBB scalable allocator\n");
-                root = TreeMaker<tbbmalloc>::create_and_time( number_of_nodes, silent );
+                CreateTrees<tbbmalloc>( number_of_nodes, trees, silent );
             }
         }
 
         // Warm up caches
-        SerialSumTree(root);
+        SerialSumTree(trees.root);
+        SerialSumTree(trees.dfs_root);
+        SerialSumTree(trees.veb_root);
+        SerialSumCompactTree(trees.compact);
         if ( !silent ) printf("Calculations:\n");
         if ( threads.first ) {
             for(int p = threads.first;  p <= threads.last; p = threads.step(p) ) {
                 if ( !silent ) printf("threads = %d\n", p );
                 tbb::task_scheduler_init init( p );
-                Run ( "SimpleParallelSumTree", SimpleParallelSumTree, root, silent );
-                Run ( "OptimizedParallelSumTree", OptimizedParallelSumTree, root, silent );
+                RunLayouts( trees, false, silent );
             }
-        } else { // Number of threads wasn't set explicitly. Run serial and two parallel versions
-            Run ( "SerialSumTree", SerialSumTree, root, silent );
+        } else { // Number of threads wasn't set explicitly. Run serial and two parallel versions on each layout
+            RunLayouts( trees, true, silent );
             tbb::task_scheduler_init init;
-            Run ( "SimpleParallelSumTree", SimpleParallelSumTree, root, silent );
-            Run ( "OptimizedParallelSumTree", OptimizedParallelSumTree, root, silent );
+            RunLayouts( trees, false, silent );
         }
         utility::report_elapsed_time((tbb::tick_count::now() - mainStartTime).seconds());
         return 0;
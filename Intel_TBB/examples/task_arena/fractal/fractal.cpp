@@ -29,14 +29,101 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <vector>
+#include <algorithm>
 
 // Included for __TBB_CPP11_LAMBDAS_PRESENT definition
 #include "tbb/tbb_config.h"
 
+#if __AVX512F__ || __AVX2__
+#include <immintrin.h>
+#endif
+
 video *v;
 extern bool silent;
 extern bool schedule_auto;
+extern bool schedule_by_cost;
+extern bool scalar_kernel;
 extern int grain_size;
+extern int tile_size;
+
+// Thin wrappers over the vector instructions, so that the kernel below is
+// written once for 8 lanes of AVX-512 and for 4 lanes of AVX2.
+#if __AVX512F__
+static const int simd_width = 8;
+typedef __m512d vec_t;
+typedef __mmask8 mask_t;
+static inline vec_t vset( double a ) { return _mm512_set1_pd( a ); }
+static inline vec_t vload( const double *p ) { return _mm512_loadu_pd( p ); }
+static inline void vstore( double *p, vec_t a ) { _mm512_storeu_pd( p, a ); }
+static inline vec_t vadd( vec_t a, vec_t b ) { return _mm512_add_pd( a, b ); }
+static inline vec_t vsub( vec_t a, vec_t b ) { return _mm512_sub_pd( a, b ); }
+static inline vec_t vmul( vec_t a, vec_t b ) { return _mm512_mul_pd( a, b ); }
+static inline vec_t vmax( vec_t a, vec_t b ) { return _mm512_max_pd( a, b ); }
+static inline vec_t vsqrt( vec_t a ) { return _mm512_sqrt_pd( a ); }
+static inline vec_t vround( vec_t a ) { return _mm512_roundscale_pd( a, _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC ); }
+//! a*2^n for integral n
+static inline vec_t vscale2( vec_t a, vec_t n ) { return _mm512_scalef_pd( a, n ); }
+static inline mask_t mask_all() { return 0xff; }
+static inline mask_t vle( vec_t a, vec_t b ) { return _mm512_cmp_pd_mask( a, b, _CMP_LE_OQ ); }
+static inline mask_t mand( mask_t a, mask_t b ) { return a & b; }
+static inline bool many( mask_t m ) { return m != 0; }
+//! b in the lanes set in m, a in the others
+static inline vec_t vblend( vec_t a, vec_t b, mask_t m ) { return _mm512_mask_blend_pd( m, a, b ); }
+//! acc+b in the lanes set in m, acc in the others
+static inline vec_t vmask_add( vec_t acc, vec_t b, mask_t m ) { return _mm512_mask_add_pd( acc, m, acc, b ); }
+#define FRACTAL_SIMD 1
+#elif __AVX2__
+static const int simd_width = 4;
+typedef __m256d vec_t;
+typedef __m256d mask_t;
+static inline vec_t vset( double a ) { return _mm256_set1_pd( a ); }
+static inline vec_t vload( const double *p ) { return _mm256_loadu_pd( p ); }
+static inline void vstore( double *p, vec_t a ) { _mm256_storeu_pd( p, a ); }
+static inline vec_t vadd( vec_t a, vec_t b ) { return _mm256_add_pd( a, b ); }
+static inline vec_t vsub( vec_t a, vec_t b ) { return _mm256_sub_pd( a, b ); }
+static inline vec_t vmul( vec_t a, vec_t b ) { return _mm256_mul_pd( a, b ); }
+static inline vec_t vmax( vec_t a, vec_t b ) { return _mm256_max_pd( a, b ); }
+static inline vec_t vsqrt( vec_t a ) { return _mm256_sqrt_pd( a ); }
+static inline vec_t vround( vec_t a ) { return _mm256_round_pd( a, _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC ); }
+//! a*2^n for integral n, by adding n to the exponent field
+static inline vec_t vscale2( vec_t a, vec_t n ) {
+    __m256i e = _mm256_slli_epi64( _mm256_cvtepi32_epi64( _mm256_cvtpd_epi32( n ) ), 52 );
+    return _mm256_castsi256_pd( _mm256_add_epi64( _mm256_castpd_si256( a ), e ) );
+}
+static inline mask_t mask_all() { return _mm256_castsi256_pd( _mm256_set1_epi64x( -1 ) ); }
+static inline mask_t vle( vec_t a, vec_t b ) { return _mm256_cmp_pd( a, b, _CMP_LE_OQ ); }
+static inline mask_t mand( mask_t a, mask_t b ) { return _mm256_and_pd( a, b ); }
+static inline bool many( mask_t m ) { return _mm256_movemask_pd( m ) != 0; }
+//! b in the lanes set in m, a in the others
+static inline vec_t vblend( vec_t a, vec_t b, mask_t m ) { return _mm256_blendv_pd( a, b, m ); }
+//! acc+b in the lanes set in m, acc in the others
+static inline vec_t vmask_add( vec_t acc, vec_t b, mask_t m ) { return _mm256_add_pd( acc, _mm256_and_pd( b, m ) ); }
+#define FRACTAL_SIMD 1
+#else
+static const int simd_width = 1;
+#define FRACTAL_SIMD 0
+#endif
+
+#if FRACTAL_SIMD
+//! exp(a) for a <= 0 as 2^n*exp(r), |r| <= ln(2)/2, with exp(r) summed up to r^11
+static inline vec_t vexp( vec_t a ) {
+    static const double coef[12] = {
+        1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040,
+        1.0/40320, 1.0/362880, 1.0/3628800, 1.0/39916800
+    };
+    // exp(-700) is already far below anything that can change a color
+    a = vmax( a, vset( -700.0 ) );
+    const vec_t n = vround( vmul( a, vset( 1.4426950408889634 ) ) );
+    // ln(2) split in two parts so that n*ln2_hi is exact
+    vec_t r = vsub( a, vmul( n, vset( 6.93145751953125e-1 ) ) );
+    r = vsub( r, vmul( n, vset( 1.42860682030941723212e-6 ) ) );
+    vec_t p = vset( coef[11] );
+    for ( int k=10; k>=0; --k )
+        p = vadd( vmul( p, r ), vset( coef[k] ) );
+    return vscale2( p, n );
+}
+#endif
 
 color_t fractal::calc_one_pixel( int x0, int y0 ) const {
     unsigned int iter;
@@ -60,6 +147,52 @@ color_t fractal::calc_one_pixel( int x0, int y0 ) const {
         iter++;
     }
 
+    return pixel_color( iter, mu );
+}
+
+void fractal::calc_pixels( int x0, int y0, color_t *colors ) const {
+#if FRACTAL_SIMD
+    // The same iteration as in calc_one_pixel, one pixel per lane.  The loop
+    // runs while any lane is still inside the radius; the lanes that escaped
+    // keep their x, y and stop adding to mu and iter.
+    double buf[simd_width];
+    for ( int k=0; k<simd_width; ++k )
+        buf[k] = ((double)(x0+k) - (double) size_x / 2.0) / magn + cx;
+    const vec_t fx0 = vload( buf );
+    const vec_t fy0 = vset( ((double)y0 - (double) size_y / 2.0) / magn + cy );
+
+    const vec_t zero = vset( 0.0 ), one = vset( 1.0 ), two = vset( 2.0 ), four = vset( 4.0 );
+    vec_t x = zero, y = zero, mu = zero, iter = zero;
+    mask_t active = mask_all();
+
+    for ( unsigned int i=0; i<max_iterations; ++i ) {
+        const vec_t xx = vmul( x, x ), yy = vmul( y, y );
+        active = mand( active, vle( vadd( xx, yy ), four ) );
+        if ( !many( active ) ) break;
+        const vec_t xtemp = vadd( vsub( xx, yy ), fx0 );
+        y = vblend( y, vadd( vmul( vmul( two, x ), y ), fy0 ), active );
+        x = vblend( x, xtemp, active );
+        mu = vmask_add( mu, vexp( vsub( zero, vsqrt( vadd( vmul( x, x ), vmul( y, y ) ) ) ) ), active );
+        iter = vmask_add( iter, one, active );
+    }
+
+    double mus[simd_width];
+    vstore( mus, mu );
+    vstore( buf, iter );
+    // Clean upper halves of the registers, or the SSE code of exp() called by
+    // calc_one_pixel runs many times slower; not every compiler does it here.
+    _mm256_zeroupper();
+    for ( int k=0; k<simd_width; ++k )
+        colors[k] = pixel_color( (unsigned int)buf[k], mus[k] );
+#else
+    for ( int k=0; k<simd_width; ++k )
+        colors[k] = calc_one_pixel( x0+k, y0 );
+#endif
+}
+
+color_t fractal::pixel_color( unsigned int iter, double mu ) const {
+    color_t color;
+
     if (iter == max_iterations) {
         // point corresponds to the mandelbrot set
         color = v->get_color(255, 255, 255);
@@ -115,14 +248,48 @@ void fractal::draw_border( bool is_active ) {
 void fractal::render_rect( int x0, int y0, int x1, int y1 ) const {
     // render the specified rectangle area
     drawing_area area(off_x+x0, off_y+y0, x1-x0, y1-y0, dm);
+    color_t colors[simd_width];
     for ( int y=y0; y<y1; ++y ) {
         area.set_pos( 0, y-y0 );
-        for ( int x=x0; x<x1; ++x ) {
+        int x=x0;
+        if ( !scalar_kernel ) {
+            for ( ; x+simd_width<=x1; x+=simd_width ) {
+                calc_pixels( x, y, colors );
+                for ( int k=0; k<simd_width; ++k )
+                    area.put_pixel( colors[k] );
+            }
+        }
+        for ( ; x<x1; ++x ) {
             area.put_pixel( calc_one_pixel( x, y ) );
         }
     }
 }
 
+unsigned int fractal::estimate_cost( int x0, int y0, int x1, int y1 ) const {
+    // Escape times of a 3x3 grid of samples, each capped at preview_iterations
+    // so that the preview stays a small fraction of the rendering itself.
+    const unsigned int preview_iterations = max_iterations < 1024 ? max_iterations : 1024;
+    unsigned int cost = 0;
+    for ( int j=0; j<3; ++j ) {
+        double fy0 = (double)(y0 + (2*j+1)*(y1-y0)/6) - (double) size_y / 2.0;
+        fy0 = fy0 / magn + cy;
+        for ( int i=0; i<3; ++i ) {
+            double fx0 = (double)(x0 + (2*i+1)*(x1-x0)/6) - (double) size_x / 2.0;
+            fx0 = fx0 / magn + cx;
+            double x = 0, y = 0, xtemp;
+            unsigned int iter = 0;
+            while (((x*x + y*y) <= 4) && (iter < preview_iterations)) {
+                xtemp = x*x - y*y + fx0;
+                y = 2*x*y + fy0;
+                x = xtemp;
+                iter++;
+            }
+            cost += iter;
+        }
+    }
+    return cost;
+}
+
 class fractal_body {
     fractal &f;
 public:
@@ -135,7 +302,87 @@ public:
     }
 };
 
+//! Rectangular piece of the fractal area rendered as a whole by render_by_cost
+struct tile {
+    int x0, y0, x1, y1;
+    unsigned int cost;
+};
+
+//! Orders tiles from the most expensive to the cheapest
+struct tile_more_expensive {
+    bool operator()( const tile &a, const tile &b ) const { return a.cost > b.cost; }
+};
+
+class tile_cost_body {
+    const fractal &f;
+    tile *tiles;
+public:
+    void operator()( const tbb::blocked_range<int> &r ) const {
+        for ( int i=r.begin(); i!=r.end(); ++i ) {
+            tile &t = tiles[i];
+            t.cost = f.estimate_cost( t.x0, t.y0, t.x1, t.y1 );
+        }
+    }
+
+    tile_cost_body( const fractal &_f, tile *_tiles ) : f(_f), tiles(_tiles) {
+    }
+};
+
+class tile_render_body {
+    const fractal &f;
+    const tile *tiles;
+    tbb::atomic<int> &next;
+public:
+    void operator()( const tbb::blocked_range<int> &r ) const {
+        for ( int i=r.begin(); i!=r.end(); ++i ) {
+            // Every iteration takes the next tile in cost order rather than tile i,
+            // so the tiles start in that order however the range was split.
+            const tile &t = tiles[next++];
+            if ( v->next_frame() )
+                f.render_rect( t.x0, t.y0, t.x1, t.y1 );
+        }
+    }
+
+    tile_render_body( const fractal &_f, const tile *_tiles, tbb::atomic<int> &_next )
+        : f(_f), tiles(_tiles), next(_next) {
+    }
+};
+
+void fractal::render_by_cost( tbb::task_group_context &context ) {
+    // The tiles are rendered the most expensive first, as estimated by a coarse
+    // preview.  The long tiles then start while there is still plenty of cheap
+    // work left to fill the other threads, and the frame does not end with a
+    // single thread finishing a tile full of points of the set.  Threads that
+    // leave the arena early go to the other fractal sooner, which keeps the
+    // two arenas of fractal_group busy until both are done.
+    fractal f = *this;
+
+    std::vector<tile> tiles;
+    for ( int y=0; y<size_y; y+=tile_size ) {
+        for ( int x=0; x<size_x; x+=tile_size ) {
+            tile t = { x, y, std::min( x+tile_size, size_x ), std::min( y+tile_size, size_y ), 0 };
+            tiles.push_back( t );
+        }
+    }
+    const int n = (int)tiles.size();
+    if ( !n ) return;
+
+    tbb::parallel_for( tbb::blocked_range<int>(0, n), tile_cost_body(f, &tiles[0]),
+            tbb::auto_partitioner(), context );
+    std::sort( tiles.begin(), tiles.end(), tile_more_expensive() );
+
+    tbb::atomic<int> next;
+    next = 0;
+    tbb::parallel_for( tbb::blocked_range<int>(0, n, 1), tile_render_body(f, &tiles[0], next),
+            tbb::simple_partitioner(), context );
+}
+
 void fractal::render( tbb::task_group_context &context ) {
+    if ( schedule_by_cost ) {
+        render_by_cost( context );
+        return;
+    }
+
     // Make copy of fractal object and render fractal with parallel_for with
     // the provided context and partitioner chosen by schedule_auto.
     // Updates to fractal are not reflected in the render.
@@ -195,6 +442,38 @@ void fractal_group::set_num_frames_at_least( int n ) {
     if ( num_frames[1]<n ) num_frames[1] = n;
 }
 
+void fractal_group::benchmark() {
+    tbb::task_scheduler_init init( num_threads );
+    tbb::task_group_context ctx;
+
+    // Zoom into the seahorse valley, which keeps a mix of cheap and expensive
+    // points at every depth; each level is 2^4 times deeper than the previous one.
+    const float bench_cx = -0.743643887f, bench_cy = 0.131825904f;
+    const bool saved_scalar = scalar_kernel, saved_by_cost = schedule_by_cost;
+    const double mpixels = (double)f0.size_x*f0.size_y/1e6;
+
+    printf("Fractal %dx%d, %u iterations at most, %d threads, %d-wide vector kernel\n",
+            f0.size_x, f0.size_y, f0.max_iterations, num_threads, simd_width);
+    for ( int level=0; level<=16; level+=4 ) {
+        double rate[3];
+        for ( int mode=0; mode<3; ++mode ) {
+            scalar_kernel = mode==0;
+            schedule_by_cost = mode==2;
+            f0.cx = bench_cx; f0.cy = bench_cy; f0.magn = 200.0f*(float)(1<<level);
+            ctx.reset();
+            tbb::tick_count t0 = tbb::tick_count::now();
+            f0.render( ctx );
+            tbb::tick_count t1 = tbb::tick_count::now();
+            rate[mode] = mpixels/(t1-t0).seconds();
+        }
+        printf("  zoom 2^%-2d: scalar %8.3f, vector %8.3f, vector by cost %8.3f Mpixels/sec\n",
+                level, rate[0], rate[1], rate[2]);
+    }
+
+    scalar_kernel = saved_scalar;
+    schedule_by_cost = saved_by_cost;
+}
+
 #if !__TBB_CPP11_LAMBDAS_PRESENT
 class task_group_body {
     fractal_group &fg;
@@ -45,12 +45,18 @@ class fractal {
 
     //! One pixel calculation routine
     color_t calc_one_pixel( int x, int y ) const;
+    //! Calculates a row of simd_width pixels starting at (x,y) with the vector kernel
+    void calc_pixels( int x, int y, color_t *colors ) const;
+    //! Maps the escape time and the smoothing sum to the pixel color
+    color_t pixel_color( unsigned int iter, double mu ) const;
     //! Clears the fractal area
     void clear();
     //! Draws the border around the fractal area
     void draw_border( bool is_active );
     //! Renders the fractal
     void render( tbb::task_group_context &context );
+    //! Renders the fractal tile by tile, the most expensive tiles first
+    void render_by_cost( tbb::task_group_context &context );
     //! Check if the point is inside the fractal area
     bool check_point( int x, int y ) const;
 
@@ -66,6 +72,8 @@ public:
     void run( tbb::task_group_context &context );
     //! Renders the fractal rectangular area
     void render_rect( int x0, int y0, int x1, int y1 ) const;
+    //! Coarse estimate of the cost of the rectangular area from a few samples
+    unsigned int estimate_cost( int x0, int y0, int x1, int y1 ) const;
 
     void move_up()   { cy += step; }
     void move_down() { cy -= step; }
@@ -123,6 +131,8 @@ public:
     void set_num_frames_at_least( int n );
     //! Switches the priorities of two fractals
     void switch_priorities( int new_active=-1 );
+    //! Measures the rendering speed at several zoom levels
+    void benchmark();
     //! Get active fractal
     fractal& get_active_fractal() { return  active ? f1 : f0; }
 
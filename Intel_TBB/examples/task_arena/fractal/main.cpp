@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <vector>
 
 #include "fractal.h"
 #include "fractal_video.h"
@@ -34,7 +35,10 @@
 bool silent = false;
 bool single = false;
 bool schedule_auto = false;
+bool schedule_by_cost = false;
+bool scalar_kernel = false;
 int grain_size = 8;
+int tile_size = 32;
 
 int main(int argc, char *argv[])
 {
@@ -47,6 +51,7 @@ int main(int argc, char *argv[])
         utility::thread_number_range threads( tbb::task_scheduler_init::default_num_threads );
         int num_frames = -1;
         int max_iterations = 1000000;
+        bool benchmark = false;
 
         // command line parsing
         utility::parse_cli_arguments(argc,argv,
@@ -57,14 +62,33 @@ int main(int argc, char *argv[])
             .positional_arg(max_iterations,"max-of-iterations","maximum number of the fractal iterations")
             .positional_arg(grain_size,"grain-size","the grain size value")
             .arg(schedule_auto, "use-auto-partitioner", "use tbb::auto_partitioner")
+            .arg(schedule_by_cost, "schedule-by-cost", "render tiles in the order of their estimated cost")
+            .arg(tile_size, "tile-size", "the tile size for schedule-by-cost")
+            .arg(scalar_kernel, "scalar", "calculate one pixel at a time instead of a vector of pixels")
+            .arg(benchmark, "benchmark", "report Mpixels/sec at several zoom levels, without a window")
             .arg(silent, "silent", "no output except elapsed time")
             .arg(single, "single", "process only one fractal")
         );
 
+        if ( tile_size < 1 ) tile_size = 1;
+
         fractal_video video;
 
+        if ( benchmark ) {
+            // render into our own memory; the console video only provides the colors
+            g_sizex = 1024; g_sizey = 512;
+            video.init_console();
+            std::vector<unsigned int> pixels( g_sizex*g_sizey );
+            drawing_memory dm = video.get_drawing_memory();
+            dm.set_address( reinterpret_cast<char*>( &pixels[0] ) );
+            dm.sizex = g_sizex; dm.sizey = g_sizey;
+            for(int p = threads.first;  p <= threads.last; p = threads.step(p) ) {
+                fractal_group fg( dm, p, max_iterations );
+                fg.benchmark();
+            }
+        }
         // video layer init
-        if ( video.init_window(1024, 512) ) {
+        else if ( video.init_window(1024, 512) ) {
             video.calc_fps = false;
             video.threaded = threads.first > 0;
             // initialize fractal group
@@ -26,12 +26,16 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "tbb/atomic.h"
 #include "tbb/tick_count.h"
 #include "tbb/task_scheduler_init.h"
 #include "tbb/task_group.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 
 #pragma warning(disable: 4996)
 
@@ -56,10 +60,24 @@ unsigned short init_values[BOARD_SIZE] = {1,0,0,9,0,0,0,8,0,0,8,0,2,0,0,0,0,0,0,
 task_group *g;
 double solve_time;
 
-typedef struct {
-    unsigned short solved_element;
-    unsigned potential_set;
-} board_element;
+// Candidates are 9-bit masks: bit d-1 stands for digit d
+const unsigned short ALL_DIGITS = (1<<BOARD_DIM)-1;
+const unsigned N_UNITS = 3*BOARD_DIM;
+
+// Branches of the search tree above this depth are spawned as tasks;
+// deeper subtrees are searched serially by the task that reached them.
+unsigned spawn_depth = 6;
+
+// A board is small enough to be copied into every search task.
+// Digits placed so far are kept per row, column and box, so the candidates
+// of a cell are found with three ORs instead of a scan of its peers.
+struct board {
+    unsigned char value[BOARD_SIZE];        // 0 if not yet fixed
+    unsigned short row_used[BOARD_DIM];
+    unsigned short col_used[BOARD_DIM];
+    unsigned short box_used[BOARD_DIM];
+    unsigned unsolved;
+};
 
 void read_board(const char *filename) {
     FILE *fp;
@@ -80,193 +98,289 @@ void read_board(const char *filename) {
     fclose(fp);
 }
 
-void print_board(board_element *b) {
-    for (unsigned row=0; row<BOARD_DIM; ++row) {
-        for (unsigned col=0; col<BOARD_DIM; ++col) {
-            printf(" %d", b[row*BOARD_DIM+col].solved_element);
-            if (col==2 || col==5) printf(" |");
-        }
-        printf("\n");
-        if (row==2 || row==5) printf(" ---------------------\n");
-    }
-}
+// Cells of every row, column and box
+unsigned char unit_cells[N_UNITS][BOARD_DIM];
 
-void print_potential_board(board_element *b) {
-    for (unsigned row=0; row<BOARD_DIM; ++row) {
-        for (unsigned col=0; col<BOARD_DIM; ++col) {
-            if (b[row*BOARD_DIM+col].solved_element) 
-                printf("  %4d ", b[row*BOARD_DIM+col].solved_element);
-            else
-                printf(" [%4d]", b[row*BOARD_DIM+col].potential_set);
-            if (col==2 || col==5) printf(" |");
+void init_units() {
+    for (unsigned i=0; i<BOARD_DIM; ++i) {
+        for (unsigned j=0; j<BOARD_DIM; ++j) {
+            unit_cells[i][j] = i*BOARD_DIM + j;
+            unit_cells[BOARD_DIM+i][j] = j*BOARD_DIM + i;
+            unit_cells[2*BOARD_DIM+i][j] = (i/3*3 + j/3)*BOARD_DIM + i%3*3 + j%3;
         }
-        printf("\n");
-        if (row==2 || row==5)
-            printf(" ------------------------------------------------------------------\n");
     }
 }
 
-void init_board(board_element *b) {
-    for (unsigned i=0; i<BOARD_SIZE; ++i)
-        b[i].solved_element = b[i].potential_set = 0;
+inline unsigned box_of(unsigned cell) {
+    return cell/(3*BOARD_DIM)*3 + cell%BOARD_DIM/3;
 }
 
-void init_board(board_element *b, unsigned short arr[81]) {
-    for (unsigned i=0; i<BOARD_SIZE; ++i) {
-        b[i].solved_element = arr[i]; 
-        b[i].potential_set = 0;
-    }
+inline unsigned short candidates(const board &b, unsigned cell) {
+    return ALL_DIGITS & ~(b.row_used[cell/BOARD_DIM] | b.col_used[cell%BOARD_DIM] | b.box_used[box_of(cell)]);
 }
 
-void init_potentials(board_element *b) {
-    for (unsigned i=0; i<BOARD_SIZE; ++i)
-        b[i].potential_set = 0;
+inline unsigned short unit_used(const board &b, unsigned unit) {
+    if (unit < BOARD_DIM) return b.row_used[unit];
+    if (unit < 2*BOARD_DIM) return b.col_used[unit-BOARD_DIM];
+    return b.box_used[unit-2*BOARD_DIM];
 }
 
-void copy_board(board_element *src, board_element *dst) {
-    for (unsigned i=0; i<BOARD_SIZE; ++i)
-        dst[i].solved_element = src[i].solved_element;
+inline unsigned count_bits(unsigned short mask) {
+    unsigned n = 0;
+    for (; mask; mask &= mask-1) ++n;
+    return n;
 }
 
-bool fixed_board(board_element *b) {
-    for (int i=BOARD_SIZE-1; i>=0; --i)
-        if (b[i].solved_element==0) return false;
-    return true;
+inline unsigned short lowest_digit(unsigned short mask) {
+    unsigned short d = 1;
+    for (; !(mask & 1); mask >>= 1) ++d;
+    return d;
 }
 
-bool in_row(board_element *b, unsigned row, unsigned col, unsigned short p) {
-    for (unsigned c=0; c<BOARD_DIM; ++c)
-        if (c!=col && b[row*BOARD_DIM+c].solved_element==p)  return true;
-    return false;
+inline void place(board &b, unsigned cell, unsigned short digit) {
+    const unsigned short bit = 1<<(digit-1);
+    b.value[cell] = (unsigned char)digit;
+    b.row_used[cell/BOARD_DIM] |= bit;
+    b.col_used[cell%BOARD_DIM] |= bit;
+    b.box_used[box_of(cell)] |= bit;
+    --b.unsolved;
 }
 
-bool in_col(board_element *b, unsigned row, unsigned col, unsigned short p) {
-    for (unsigned r=0; r<BOARD_DIM; ++r)
-        if (r!=row && b[r*BOARD_DIM+col].solved_element==p)  return true;
-    return false;
+// Returns false if the given digits already conflict
+bool init_board(board &b, const unsigned short arr[BOARD_SIZE]) {
+    memset(&b, 0, sizeof(b));
+    b.unsolved = BOARD_SIZE;
+    for (unsigned i=0; i<BOARD_SIZE; ++i) {
+        if (arr[i]) {
+            if (arr[i] > BOARD_DIM || !(candidates(b, i) & 1<<(arr[i]-1)))
+                return false;
+            place(b, i, arr[i]);
+        }
+    }
+    return true;
 }
 
-bool in_block(board_element *b, unsigned row, unsigned col, unsigned short p) {
-    unsigned b_row = row/3 * 3, b_col = col/3 * 3;
-    for (unsigned i=b_row; i<b_row+3; ++i)
-        for (unsigned j=b_col; j<b_col+3; ++j)
-            if (!(i==row && j==col) && b[i*BOARD_DIM+j].solved_element==p) return true;
-    return false;
+// Places naked singles (cells with one candidate) and hidden singles (digits
+// with one possible cell in a unit) until neither is left.
+// Returns false if the board turns out to have no solution.
+bool propagate(board &b) {
+    bool progress = true;
+    while (progress && b.unsolved) {
+        progress = false;
+        for (unsigned i=0; i<BOARD_SIZE; ++i) {
+            if (!b.value[i]) {
+                unsigned short c = candidates(b, i);
+                if (!c) return false;
+                if (!(c & (c-1))) {
+                    place(b, i, lowest_digit(c));
+                    progress = true;
+                }
+            }
+        }
+        for (unsigned u=0; u<N_UNITS; ++u) {
+            // digits possible in at least one / at least two empty cells of the unit
+            unsigned short once = 0, twice = 0;
+            for (unsigned j=0; j<BOARD_DIM; ++j) {
+                unsigned cell = unit_cells[u][j];
+                if (!b.value[cell]) {
+                    unsigned short c = candidates(b, cell);
+                    twice |= once & c;
+                    once |= c;
+                }
+            }
+            if ((once | unit_used(b, u)) != ALL_DIGITS) return false;
+            for (unsigned short singles = once & ~twice; singles; singles &= singles-1) {
+                unsigned short digit = lowest_digit(singles);
+                unsigned j = 0;
+                while (j<BOARD_DIM && (b.value[unit_cells[u][j]] || !(candidates(b, unit_cells[u][j]) & 1<<(digit-1)))) ++j;
+                if (j==BOARD_DIM) return false;
+                place(b, unit_cells[u][j], digit);
+                progress = true;
+            }
+        }
+    }
+    return true;
 }
 
-void calculate_potentials(board_element *b) {
-    for (unsigned i=0; i<BOARD_SIZE; ++i) {
-        b[i].potential_set = 0;
-        if (!b[i].solved_element) { // element is not yet fixed
-            unsigned row = i/BOARD_DIM, col = i%BOARD_DIM;
-            for (unsigned potential=1; potential<=BOARD_DIM; ++potential) {
-                if (!in_row(b, row, col, potential) && !in_col(b, row, col, potential)
-                    && !in_block(b, row, col, potential))
-                    b[i].potential_set |= 1<<(potential-1);
+// The empty cell with the fewest candidates, or BOARD_SIZE if there is none
+unsigned choose_cell(const board &b) {
+    unsigned best = BOARD_SIZE, best_count = BOARD_DIM+1;
+    for (unsigned i=0; i<BOARD_SIZE && best_count>2; ++i) {
+        if (!b.value[i]) {
+            unsigned n = count_bits(candidates(b, i));
+            if (n < best_count) {
+                best = i;
+                best_count = n;
             }
         }
     }
+    return best;
 }
 
-bool valid_board(board_element *b) {
-    bool success=true;
-    for (unsigned i=0; i<BOARD_SIZE; ++i) {
-        if (success && b[i].solved_element) { // element is fixed
-            unsigned row = i/BOARD_DIM, col = i%BOARD_DIM;
-            if (in_row(b, row, col, b[i].solved_element) || in_col(b, row, col, b[i].solved_element) || in_block(b, row, col, b[i].solved_element))
-                success = false;
+void print_board(const board &b) {
+    for (unsigned row=0; row<BOARD_DIM; ++row) {
+        for (unsigned col=0; col<BOARD_DIM; ++col) {
+            printf(" %d", b.value[row*BOARD_DIM+col]);
+            if (col==2 || col==5) printf(" |");
         }
+        printf("\n");
+        if (row==2 || row==5) printf(" ---------------------\n");
     }
-    return success;
 }
 
-bool examine_potentials(board_element *b, bool *progress) {
-    bool singletons = false;
-    for (unsigned i=0; i<BOARD_SIZE; ++i) {
-        if (b[i].solved_element==0 && b[i].potential_set==0) // empty set
-            return false;
-        switch (b[i].potential_set) {
-        case 1:   { b[i].solved_element = 1; singletons=true; break; }
-        case 2:   { b[i].solved_element = 2; singletons=true; break; }
-        case 4:   { b[i].solved_element = 3; singletons=true; break; }
-        case 8:   { b[i].solved_element = 4; singletons=true; break; }
-        case 16:  { b[i].solved_element = 5; singletons=true; break; }
-        case 32:  { b[i].solved_element = 6; singletons=true; break; }
-        case 64:  { b[i].solved_element = 7; singletons=true; break; }
-        case 128: { b[i].solved_element = 8; singletons=true; break; }
-        case 256: { b[i].solved_element = 9; singletons=true; break; }
+void print_potential_board(const board &b) {
+    for (unsigned row=0; row<BOARD_DIM; ++row) {
+        for (unsigned col=0; col<BOARD_DIM; ++col) {
+            if (b.value[row*BOARD_DIM+col]) 
+                printf("  %4d ", b.value[row*BOARD_DIM+col]);
+            else
+                printf(" [%4d]", candidates(b, row*BOARD_DIM+col));
+            if (col==2 || col==5) printf(" |");
         }
+        printf("\n");
+        if (row==2 || row==5)
+            printf(" ------------------------------------------------------------------\n");
+    }
+}
+
+void found_solution(const board &b) {
+    if ( find_one )
+        g->cancel();
+    if (++nSols==1 && verbose) {
+        print_board(b);
     }
-    *progress = singletons;
-    return valid_board(b);
 }
 
 #if !__TBB_LAMBDAS_PRESENT
-void partial_solve(board_element *b, unsigned first_potential_set);
+void partial_solve(const board &b, unsigned depth);
 
 class PartialSolveBoard {
-    board_element *b;
-    unsigned first_potential_set;
+    board b;
+    unsigned depth;
 public:
-    PartialSolveBoard(board_element *_b, unsigned fps) :
-        b(_b), first_potential_set(fps) {}
+    PartialSolveBoard(const board &_b, unsigned d) :
+        b(_b), depth(d) {}
     void operator() () const {
-        partial_solve(b, first_potential_set);
+        partial_solve(b, depth);
     }
 };
 #endif
 
-void partial_solve(board_element *b, unsigned first_potential_set) {
-    if (fixed_board(b)) {
-        if ( find_one )
-            g->cancel();
-        if (++nSols==1 && verbose) {
-            print_board(b);
-        }
-        free(b);
+// b has been propagated and is consistent
+void partial_solve(const board &b, unsigned depth) {
+    if (find_one && nSols)
+        return;
+    unsigned cell = choose_cell(b);
+    if (cell==BOARD_SIZE) {
+        found_solution(b);
         return;
     }
-    calculate_potentials(b);
-    bool progress=true;
-    bool success = examine_potentials(b, &progress);
-    if (success && progress) {
-        partial_solve(b, first_potential_set);
-    } else if (success && !progress) {
-        board_element *new_board;
-        while (b[first_potential_set].solved_element!=0) ++first_potential_set;
-        for (unsigned short potential=1; potential<=BOARD_DIM; ++potential) {
-            if (1<<(potential-1) & b[first_potential_set].potential_set) {
-                new_board = (board_element *)malloc(BOARD_SIZE*sizeof(board_element));
-                copy_board(b, new_board);
-                new_board[first_potential_set].solved_element = potential;
+    for (unsigned short c = candidates(b, cell); c; c &= c-1) {
+        board new_board = b;
+        place(new_board, cell, lowest_digit(c));
+        if (!propagate(new_board))
+            continue;
+        if (depth < spawn_depth) {
 #if __TBB_LAMBDAS_PRESENT
-                g->run( [=]{ partial_solve(new_board, first_potential_set); } );
+            g->run( [=]{ partial_solve(new_board, depth+1); } );
 #else
-                g->run(PartialSolveBoard(new_board, first_potential_set));
+            g->run(PartialSolveBoard(new_board, depth+1));
 #endif
-            }
+        } else {
+            partial_solve(new_board, depth+1);
         }
-        free(b);
-    }
-    else {
-        free(b);
     }
 }
 
 unsigned solve(int p) {
     task_scheduler_init init(p);
     nSols = 0;
-    board_element *start_board = (board_element *)malloc(BOARD_SIZE*sizeof(board_element));
-    init_board(start_board, init_values);
+    init_units();
+    board start_board;
     g = new task_group;
     tick_count t0 = tick_count::now();
-    partial_solve(start_board, 0);
+    if (init_board(start_board, init_values) && propagate(start_board))
+        partial_solve(start_board, 0);
     g->wait();
     solve_time = (tick_count::now() - t0).seconds();
     delete g;
     return nSols;
 }
 
+// Batch mode: the puzzles of a file are spread over the threads, and each
+// one is searched serially until its first solution is found.
+std::vector<unsigned short> batch_values;   // BOARD_SIZE values per puzzle
+
+void read_batch(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) { 
+        fprintf(stderr, "sudoku: Could not open input file '%s'.\n", filename);
+        exit(1);
+    }
+    // one puzzle per line: 81 characters, '1'-'9' for givens, '0' or '.' for empty cells;
+    // lines that are not puzzles are skipped
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned n = 0;
+        unsigned short values[BOARD_SIZE];
+        for (const char *c = line; *c && n<BOARD_SIZE; ++c) {
+            if (*c>='1' && *c<='9') values[n++] = *c-'0';
+            else if (*c=='0' || *c=='.') values[n++] = 0;
+            else break;
+        }
+        if (n==BOARD_SIZE)
+            batch_values.insert(batch_values.end(), values, values+BOARD_SIZE);
+    }
+    fclose(fp);
+}
+
+bool solve_first(board &b) {
+    unsigned cell = choose_cell(b);
+    if (cell==BOARD_SIZE)
+        return true;
+    for (unsigned short c = candidates(b, cell); c; c &= c-1) {
+        board new_board = b;
+        place(new_board, cell, lowest_digit(c));
+        if (propagate(new_board) && solve_first(new_board)) {
+            b = new_board;
+            return true;
+        }
+    }
+    return false;
+}
+
+class SolveBatch {
+    board *solutions;
+public:
+    SolveBatch(board *_solutions) : solutions(_solutions) {}
+    void operator() (const tbb::blocked_range<size_t> &r) const {
+        unsigned solved = 0;
+        for (size_t i=r.begin(); i!=r.end(); ++i) {
+            board &b = solutions[i];
+            if (init_board(b, &batch_values[i*BOARD_SIZE]) && propagate(b) && solve_first(b))
+                ++solved;
+            else
+                b.unsolved = BOARD_SIZE;
+        }
+        nSols += solved;
+    }
+};
+
+unsigned solve_batch(int p) {
+    task_scheduler_init init(p);
+    nSols = 0;
+    init_units();
+    size_t n = batch_values.size()/BOARD_SIZE;
+    std::vector<board> solutions(n);
+    tick_count t0 = tick_count::now();
+    if (n)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 16), SolveBatch(&solutions[0]));
+    solve_time = (tick_count::now() - t0).seconds();
+    if (verbose && n && !solutions[0].unsolved)
+        print_board(solutions[0]);
+    return nSols;
+}
+
 #if __TBB_MIC_OFFLOAD
 #pragma offload_attribute (pop)
 #endif // __TBB_MIC_OFFLOAD
@@ -292,6 +406,7 @@ int main(int argc, char *argv[]) {
         utility::thread_number_range threads(get_default_num_threads);
         string filename = "";
         bool silent = false;
+        bool batch = false;
 
         utility::parse_cli_arguments(argc,argv,
             utility::cli_argument_pack()
@@ -301,18 +416,38 @@ int main(int argc, char *argv[]) {
 
             .arg(verbose,"verbose","prints the first solution")
             .arg(silent,"silent","no output except elapsed time")
-            .arg(find_one,"find-one","stops after finding first solution\n")
+            .arg(find_one,"find-one","stops after finding first solution")
+            .arg(spawn_depth,"spawn-depth","search tree depth down to which branches are spawned as tasks")
+            .arg(batch,"batch","solves every puzzle of the input file, one 81-character puzzle per line\n")
         );
 
         if ( silent ) verbose = false;
 
+        if ( batch ) {
+            if ( filename.empty() ) {
+                fprintf(stderr, "sudoku: batch mode needs an input file.\n");
+                return 1;
+            }
+            read_batch( filename.c_str() );
+            unsigned n_puzzles = unsigned(batch_values.size()/BOARD_SIZE);
+            for(int p = threads.first; p <= threads.last; p = threads.step(p) ) {
+                unsigned number = solve_batch(p);
+                if ( !silent ) {
+                    printf("Sudoku: Time to solve %u of %u puzzles on %d threads: %6.6f seconds, %.0f puzzles/sec.\n",
+                           number, n_puzzles, p, solve_time, n_puzzles/solve_time);
+                }
+            }
+            utility::report_elapsed_time((tbb::tick_count::now() - mainStartTime).seconds());
+            return 0;
+        }
+
         if ( !filename.empty() )
             read_board( filename.c_str() );
         // otherwise (if file name not specified), the default statically initialized board will be used.
         for(int p = threads.first; p <= threads.last; p = threads.step(p) ) {
             unsigned number;
             #if __TBB_MIC_OFFLOAD
-            #pragma offload target(mic) in(init_values, p, verbose, find_one) out(number, solve_time)
+            #pragma offload target(mic) in(init_values, p, verbose, find_one, spawn_depth) out(number, solve_time)
             {
             #endif // __TBB_MIC_OFFLOAD
             number = solve(p);
@@ -66,3 +66,185 @@ Readline(int fd, void *ptr, size_t maxlen)
         err_sys("readline error");
     return(n);
 }
+
+/* include readbuf */
+//!! 上面的 readline() 用静态缓冲区，不可重入，多个描述符也不能混用，且每字节一次 my_read()。
+//!! Readbuf 把缓冲状态放进每个描述符各自的对象里：
+//!!   - 找换行用 memchr()（glibc 里是 SSE2/AVX2 实现），已扫过的部分不重扫
+//!!   - 缓冲区为空或需要补充时，先把残行移到开头，再一次 read() 尽量填满整个缓冲区
+//!!   - readbuf_line() 不复制，直接返回缓冲区里的一行；行比缓冲区长时缓冲区加倍
+//!!   - readbuf_linemax() 同上但限定行长，超长报 EMSGSIZE，对端不发换行也不会把缓冲区撑爆
+//!!   - readbuf_readline() 与 readline() 语义相同（复制、存换行、null 结尾）
+//!! 一个 Readbuf 只能由一个线程使用；不同线程各用各的，互不相干。
+Readbuf *
+readbuf_open(int fd, size_t size)
+{
+    Readbuf *rb;
+
+    if (size == 0)
+        size = READBUF_SIZE;
+    if ( (rb = malloc(sizeof(Readbuf))) == NULL)
+        return(NULL);
+    if ( (rb->rb_buf = malloc(size)) == NULL) {
+        free(rb);
+        return(NULL);
+    }
+    rb->rb_fd = fd;
+    rb->rb_size = size;
+    rb->rb_ptr = rb->rb_buf;
+    rb->rb_cnt = 0;
+    rb->rb_scan = 0;
+    return(rb);
+}
+
+void
+readbuf_close(Readbuf *rb)  /* frees the buffer; the descriptor is left open */
+{
+    free(rb->rb_buf);
+    free(rb);
+}
+
+/*
+ * Length of the next line in the buffer, reading more as needed: up to and
+ * including the newline, or limit bytes if no newline comes first, or
+ * whatever is left at EOF (0 if nothing).  -1 on error, errno set.
+ */
+static ssize_t
+readbuf_find(Readbuf *rb, size_t limit)
+{
+    char    *eol, *newbuf;
+    size_t  nscan;
+    ssize_t n;
+
+    for ( ; ; ) {
+        nscan = min(rb->rb_cnt, limit);
+        if (rb->rb_scan < nscan &&
+            (eol = memchr(rb->rb_ptr + rb->rb_scan, '\n', nscan - rb->rb_scan)) != NULL)
+            return(eol + 1 - rb->rb_ptr);
+        rb->rb_scan = nscan;    // 这些字节里没有换行，下次从这里接着找
+        if (nscan == limit)
+            return(limit);      /* line longer than caller's buffer */
+
+            /* 4no complete line: partial one to the front, then refill */
+        if (rb->rb_ptr != rb->rb_buf) {
+            memmove(rb->rb_buf, rb->rb_ptr, rb->rb_cnt);
+            rb->rb_ptr = rb->rb_buf;
+        } else if (rb->rb_cnt == rb->rb_size - 1) {
+            if ( (newbuf = realloc(rb->rb_buf, rb->rb_size * 2)) == NULL)
+                return(-1);     /* errno is ENOMEM */
+            rb->rb_buf = rb->rb_ptr = newbuf;
+            rb->rb_size *= 2;
+        }
+again:
+            /* 4one byte always kept free, for the null at EOF */
+        n = read(rb->rb_fd, rb->rb_ptr + rb->rb_cnt, rb->rb_size - 1 - rb->rb_cnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                goto again;
+            return(-1);
+        } else if (n == 0) {
+            rb->rb_ptr[rb->rb_cnt] = 0;
+            return(rb->rb_cnt); /* EOF, rb_cnt bytes left */
+        }
+        rb->rb_cnt += n;
+    }
+}
+
+/*
+ * Zero copy: *lineptr points at the next line inside the buffer, valid
+ * until the next call.  The line includes its newline and is not null
+ * terminated, except a final line without newline at EOF.
+ * Returns its length, 0 on EOF, -1 on error.
+ */
+ssize_t
+readbuf_line(Readbuf *rb, char **lineptr)
+{
+    return(readbuf_linemax(rb, lineptr, (size_t) -1));
+}
+
+/*
+ * readbuf_line() for lines of at most maxlen bytes, newline included:
+ * if no newline comes within maxlen bytes, -1 with errno EMSGSIZE, and the
+ * buffer is not grown past what maxlen needs.  The bytes stay buffered.
+ */
+ssize_t
+readbuf_linemax(Readbuf *rb, char **lineptr, size_t maxlen)
+{
+    ssize_t n;
+
+    if ( (n = readbuf_find(rb, maxlen)) <= 0)
+        return(n);
+    if ((size_t) n == maxlen && rb->rb_ptr[n - 1] != '\n') {
+        errno = EMSGSIZE;
+        return(-1);
+    }
+    *lineptr = rb->rb_ptr;
+    rb->rb_ptr += n;
+    rb->rb_cnt -= n;
+    rb->rb_scan = 0;
+    return(n);
+}
+
+ssize_t
+readbuf_readline(Readbuf *rb, void *vptr, size_t maxlen)
+{
+    ssize_t n;
+
+    if (maxlen == 0)
+        return(0);
+    if ( (n = readbuf_find(rb, maxlen - 1)) < 0)
+        return(-1);
+    memcpy(vptr, rb->rb_ptr, n);
+    ((char *) vptr)[n] = 0;  /* null terminate like fgets() */
+    rb->rb_ptr += n;
+    rb->rb_cnt -= n;
+    rb->rb_scan = 0;
+    return(n);
+}
+
+size_t
+readbuf_buffered(const Readbuf *rb)     /* like readlinebuf(): #bytes read but not returned */
+{
+    return(rb->rb_cnt);
+}
+/* end readbuf */
+
+Readbuf *
+Readbuf_open(int fd, size_t size)
+{
+    Readbuf *rb;
+
+    if ( (rb = readbuf_open(fd, size)) == NULL)
+        err_sys("readbuf_open error");
+    return(rb);
+}
+
+ssize_t
+Readbuf_line(Readbuf *rb, char **lineptr)
+{
+    ssize_t     n;
+
+    if ( (n = readbuf_line(rb, lineptr)) < 0)
+        err_sys("readbuf_line error");
+    return(n);
+}
+
+ssize_t
+Readbuf_linemax(Readbuf *rb, char **lineptr, size_t maxlen)
+{
+    ssize_t     n;
+
+    if ( (n = readbuf_linemax(rb, lineptr, maxlen)) < 0)
+        err_sys("readbuf_linemax error");
+    return(n);
+}
+
+ssize_t
+Readbuf_readline(Readbuf *rb, void *ptr, size_t maxlen)
+{
+    ssize_t     n;
+
+    if ( (n = readbuf_readline(rb, ptr, maxlen)) < 0)
+        err_sys("readbuf_readline error");
+    return(n);
+}
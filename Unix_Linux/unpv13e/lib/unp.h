@@ -243,6 +243,17 @@ struct sockaddr_storage {
 
 typedef	void	Sigfunc(int);	/* for signal handlers */
 
+#define	READBUF_SIZE	65536	/* default Readbuf size; grows for longer lines */
+
+typedef struct {				/* per-descriptor readline() state */
+  int		rb_fd;
+  char		*rb_buf;		/* malloc'ed, rb_size bytes */
+  size_t	rb_size;
+  char		*rb_ptr;		/* first byte not yet returned */
+  size_t	rb_cnt;			/* #bytes at rb_ptr not yet returned */
+  size_t	rb_scan;		/* #bytes at rb_ptr known to hold no newline */
+} Readbuf;
+
 #define	min(a,b)	((a) < (b) ? (a) : (b))
 #define	max(a,b)	((a) > (b) ? (a) : (b))
 
@@ -290,6 +301,12 @@ void	 inet6_srcrt_print(void *);
 char   **my_addrs(int *);
 int		 readable_timeo(int, int);
 ssize_t	 readline(int, void *, size_t);
+Readbuf *readbuf_open(int, size_t);
+void	 readbuf_close(Readbuf *);
+ssize_t	 readbuf_line(Readbuf *, char **);
+ssize_t	 readbuf_linemax(Readbuf *, char **, size_t);
+ssize_t	 readbuf_readline(Readbuf *, void *, size_t);
+size_t	 readbuf_buffered(const Readbuf *);
 ssize_t	 readn(int, void *, size_t);
 ssize_t	 read_fd(int, void *, size_t, int *);
 ssize_t	 recvfrom_flags(int, void *, size_t, int *, SA *, socklen_t *,
@@ -494,6 +511,10 @@ void	 Listen(int, int);
 int		 Poll(struct pollfd *, unsigned long, int);
 #endif
 ssize_t	 Readline(int, void *, size_t);
+Readbuf *Readbuf_open(int, size_t);
+ssize_t	 Readbuf_line(Readbuf *, char **);
+ssize_t	 Readbuf_linemax(Readbuf *, char **, size_t);
+ssize_t	 Readbuf_readline(Readbuf *, void *, size_t);
 ssize_t	 Readn(int, void *, size_t);
 ssize_t	 Recv(int, void *, size_t, int);
 ssize_t	 Recvfrom(int, void *, size_t, int, SA *, socklen_t *);
@@ -0,0 +1,418 @@
+/* include loadgen */
+#define	_GNU_SOURCE
+#include	"unpthread.h"
+#include	<sys/epoll.h>
+#include	<netinet/tcp.h>
+#include	<stdint.h>
+#include	<time.h>
+
+//!! client.c 的替代：几个线程各自一个 epoll，驱动成千上万个连接，连接可以复用，
+//!! 每个请求的延迟记进 HDR 式的对数-线性直方图，最后打印 p50/p99/p99.9。
+//!! 协议仍是 web_child 的 "N\n" -> N 字节，所有 serv* 都能用同一个负载比较。
+//!!   闭环（默认）：每个连接收完回复立即发下一个请求
+//!!   开环（-r）：按固定速率到达，延迟从请求"应当发出"的时刻算起，
+//!!              服务器跟不上时排队时间也算进去（不会 coordinated omission）
+//!! 预派生/每连接一线程的服务器同时只能服务有限个连接，对它们用 -k 1
+//!! （每个请求一个新连接，与 client.c 相同）或把 -c 设得不超过其线程/进程数。
+
+#define	MAXN		16384		/* max # bytes to request from server */
+#define	MAXEVENTS	256
+#define	RETRY_NS	10000000	/* wait 10ms before reconnecting after an error */
+
+	/* 4histogram: 2^SUB_BITS linear buckets per power of two, <1% error */
+#define	SUB_BITS	7
+#define	SUB_COUNT	(1 << SUB_BITS)
+#define	NBUCKETS	((64 - SUB_BITS + 1) * SUB_COUNT)
+
+#define	C_IDLE			0
+#define	C_CONNECTING	1
+#define	C_BUSY			2
+
+typedef struct conn {
+  int			fd;
+  int			state;			/* C_xxx */
+  int			nreq;			/* # requests done on this connection */
+  int			nwritten;		/* request bytes sent */
+  int			nread;			/* reply bytes received */
+  uint64_t		t0;				/* when the request was due, ns */
+  uint64_t		tretry;			/* C_IDLE after an error: not before this */
+  struct conn	*next;			/* on idle or retry list */
+} Conn;
+
+typedef struct {
+  pthread_t		tid;
+  int			epfd;
+  int			nconns;
+  Conn			*conns;
+  Conn			*idle;			/* ready for a request */
+  Conn			*retry, **retrytail;	/* FIFO, so sorted by tretry */
+  double		interval;		/* open loop: ns between arrivals, 0 = closed */
+  long			nissued;		/* open loop: arrivals handed to a connection */
+  long			nreq, nerr;
+  uint64_t		lmin, lmax;
+  uint64_t		hist[NBUCKETS];
+} Worker;
+
+static struct addrinfo	*srvaddr;
+static char				request[MAXLINE];
+static int				reqlen, nbytes, reqperconn;
+static uint64_t			tstart, tend;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int
+hist_index(uint64_t v)
+{
+	int		shift;
+
+	if (v < SUB_COUNT)
+		return(v);
+	shift = 63 - __builtin_clzll(v) - SUB_BITS;
+	return(((shift + 1) << SUB_BITS) + (int) ((v >> shift) - SUB_COUNT));
+}
+
+	/* 4largest value that lands in bucket i */
+static uint64_t
+hist_value(int i)
+{
+	int		shift;
+
+	if (i < SUB_COUNT)
+		return(i);
+	shift = (i >> SUB_BITS) - 1;
+	return((((uint64_t) (i & (SUB_COUNT - 1)) + SUB_COUNT + 1) << shift) - 1);
+}
+/* end loadgen */
+
+static void
+conn_close(Worker *w, Conn *c)
+{
+	if (c->fd >= 0) {
+		close(c->fd);		/* also removes it from epfd */
+		c->fd = -1;
+	}
+	c->nreq = 0;
+	c->state = C_IDLE;
+}
+
+static void
+conn_fail(Worker *w, Conn *c)
+{
+	w->nerr++;
+	conn_close(w, c);
+	c->tretry = now_ns() + RETRY_NS;
+	c->next = NULL;
+	*w->retrytail = c;
+	w->retrytail = &c->next;
+}
+
+static void
+conn_done(Worker *w, Conn *c)
+{
+	uint64_t	lat;
+
+	lat = now_ns() - c->t0;
+	w->hist[hist_index(lat)]++;
+	if (lat < w->lmin)
+		w->lmin = lat;
+	if (lat > w->lmax)
+		w->lmax = lat;
+	w->nreq++;
+
+	if (++c->nreq == reqperconn)
+		conn_close(w, c);	/* -k: fresh connection for the next one */
+	c->state = C_IDLE;
+	c->next = w->idle;
+	w->idle = c;
+}
+
+static void
+conn_send(Worker *w, Conn *c)
+{
+	ssize_t		n;
+
+	while (c->nwritten < reqlen) {
+		if ( (n = write(c->fd, request + c->nwritten, reqlen - c->nwritten)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				conn_fail(w, c);
+			return;			/* EPOLLOUT will bring us back */
+		}
+		c->nwritten += n;
+	}
+}
+
+static void
+conn_recv(Worker *w, Conn *c)
+{
+	ssize_t		n;
+	char		buf[MAXN];
+
+	for ( ; ; ) {
+		if ( (n = read(c->fd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				conn_fail(w, c);
+			return;
+		} else if (n == 0) {
+			conn_fail(w, c);	/* server closed before the whole reply */
+			return;
+		}
+		if ( (c->nread += n) > nbytes) {
+			err_msg("server returned %d bytes", c->nread);
+			conn_fail(w, c);
+			return;
+		}
+		if (c->nread == nbytes) {
+			conn_done(w, c);
+			return;
+		}
+	}
+}
+
+	/* 4start a request on c, connecting first if needed */
+static void
+conn_issue(Worker *w, Conn *c, uint64_t t0)
+{
+	const int			on = 1;
+	struct epoll_event	ev;
+
+	c->t0 = t0;
+	c->nwritten = 0;
+	c->nread = 0;
+	c->state = C_BUSY;
+	if (c->fd >= 0) {
+		conn_send(w, c);
+		return;
+	}
+
+	if ( (c->fd = socket(srvaddr->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0)
+		err_sys("socket error");
+	Setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	ev.data.ptr = c;
+	if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0)
+		err_sys("epoll_ctl error");
+
+	if (connect(c->fd, srvaddr->ai_addr, srvaddr->ai_addrlen) == 0)
+		conn_send(w, c);
+	else if (errno == EINPROGRESS)
+		c->state = C_CONNECTING;	/* EPOLLOUT when done */
+	else
+		conn_fail(w, c);
+}
+
+static void
+conn_event(Worker *w, Conn *c)
+{
+	int			error;
+	socklen_t	len;
+
+	if (c->state == C_CONNECTING) {
+		len = sizeof(error);
+		if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error) {
+			conn_fail(w, c);
+			return;
+		}
+		c->state = C_BUSY;
+	}
+	if (c->state != C_BUSY)
+		return;
+	if (c->nwritten < reqlen) {
+		conn_send(w, c);
+		if (c->state != C_BUSY || c->nwritten < reqlen)
+			return;
+	}
+	conn_recv(w, c);
+}
+
+/*
+ * Hand requests to idle connections.  Returns the epoll_wait() timeout
+ * in ms: until the next arrival (open loop), retry, or the end of the run.
+ */
+static int
+dispatch(Worker *w, uint64_t now)
+{
+	Conn		*c;
+	uint64_t	next;
+	long		ndue;
+
+	while ( (c = w->retry) != NULL && c->tretry <= now) {
+		if ( (w->retry = c->next) == NULL)
+			w->retrytail = &w->retry;
+		c->next = w->idle;
+		w->idle = c;
+	}
+
+	next = w->retry ? w->retry->tretry : tend;
+	if (w->interval == 0) {
+		while ( (c = w->idle) != NULL) {
+			w->idle = c->next;
+			conn_issue(w, c, now);
+		}
+	} else {
+			/* 4arrival k is due at tstart + k * interval */
+		ndue = (now - tstart) / w->interval + 1;
+		while (w->nissued < ndue && (c = w->idle) != NULL) {
+			w->idle = c->next;
+			conn_issue(w, c, tstart + w->nissued * w->interval);
+			w->nissued++;
+		}
+		if (w->nissued == ndue)
+			next = min(next, tstart + ndue * w->interval);
+	}
+	next = min(next, tend);
+	return(next > now ? (next - now + 999999) / 1000000 : 0);
+}
+
+void *
+worker_main(void *arg)
+{
+	int					i, n, timeout;
+	uint64_t			now;
+	Worker				*w;
+	struct epoll_event	events[MAXEVENTS];
+
+	w = arg;
+	for ( ; ; ) {
+		if ( (now = now_ns()) >= tend)
+			break;
+		timeout = dispatch(w, now);
+		if ( (n = epoll_wait(w->epfd, events, MAXEVENTS, timeout)) < 0) {
+			if (errno == EINTR)
+				continue;
+			err_sys("epoll_wait error");
+		}
+		for (i = 0; i < n; i++)
+			conn_event(w, events[i].data.ptr);
+	}
+	return(NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+	int			c, i, j, nthreads, nconns;
+	long		nreq, nerr, nlate;
+	double		seconds, rate, secs;
+	uint64_t	lmin, lmax, count, hist[NBUCKETS];
+	Worker		*wptr, *w;
+	void		pr_cpu_time(void);
+	static const double	pct[] = { 50, 90, 99, 99.9, 99.99 };
+
+	nthreads = 1;
+	nconns = 64;
+	seconds = 10;
+	rate = 0;
+	reqperconn = 0;
+	opterr = 0;		/* don't want getopt() writing to stderr */
+	while ( (c = getopt(argc, argv, "t:c:d:r:k:")) != -1) {
+		switch (c) {
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+
+		case 'c':
+			nconns = atoi(optarg);
+			break;
+
+		case 'd':
+			seconds = atof(optarg);
+			break;
+
+		case 'r':
+			rate = atof(optarg);
+			break;
+
+		case 'k':
+			reqperconn = atoi(optarg);
+			break;
+
+		case '?':
+			err_quit("unrecognized option: %c", optopt);
+		}
+	}
+	if (optind != argc - 3)
+		err_quit("usage: loadgen [ -t #threads ] [ -c #conns ] [ -d #seconds ] "
+				 "[ -r #requests/sec ] [ -k #requests/conn ] "
+				 "<hostname or IPaddr> <port> <#bytes/request>");
+	if (nthreads <= 0 || nconns < nthreads)
+		err_quit("need at least one connection per thread");
+
+	srvaddr = Host_serv(argv[optind], argv[optind+1], AF_UNSPEC, SOCK_STREAM);
+	nbytes = atoi(argv[optind+2]);
+	if (nbytes <= 0 || nbytes > MAXN)
+		err_quit("#bytes/request must be 1..%d", MAXN);
+	reqlen = snprintf(request, sizeof(request), "%d\n", nbytes); /* newline at end */
+
+	Signal(SIGPIPE, SIG_IGN);
+	wptr = Calloc(nthreads, sizeof(Worker));
+	tstart = now_ns();
+	tend = tstart + (uint64_t) (seconds * 1e9);
+	for (i = 0; i < nthreads; i++) {
+		w = &wptr[i];
+		if ( (w->epfd = epoll_create1(0)) < 0)
+			err_sys("epoll_create1 error");
+		w->nconns = nconns / nthreads + (i < nconns % nthreads);
+		w->conns = Calloc(w->nconns, sizeof(Conn));
+		for (j = 0; j < w->nconns; j++) {
+			w->conns[j].fd = -1;
+			w->conns[j].next = w->idle;
+			w->idle = &w->conns[j];
+		}
+		w->retrytail = &w->retry;
+		w->interval = rate > 0 ? 1e9 * nthreads / rate : 0;
+		w->lmin = UINT64_MAX;
+		Pthread_create(&w->tid, NULL, &worker_main, w);
+	}
+
+	nreq = nerr = nlate = 0;
+	lmin = UINT64_MAX;
+	lmax = 0;
+	bzero(hist, sizeof(hist));
+	for (i = 0; i < nthreads; i++) {
+		w = &wptr[i];
+		Pthread_join(w->tid, NULL);
+		nreq += w->nreq;
+		nerr += w->nerr;
+		if (w->interval > 0)
+			nlate += (long) ((tend - tstart) / w->interval) + 1 - w->nissued;
+		lmin = min(lmin, w->lmin);
+		lmax = max(lmax, w->lmax);
+		for (j = 0; j < NBUCKETS; j++)
+			hist[j] += w->hist[j];
+	}
+	secs = (now_ns() - tstart) / 1e9;
+
+	printf("%ld requests in %.2f s, %.0f requests/sec, %d connections, "
+		   "%d threads, %ld errors\n",
+		   nreq, secs, nreq / secs, nconns, nthreads, nerr);
+	if (rate > 0)
+		printf("open loop at %.0f requests/sec, %ld arrivals never sent\n",
+			   rate, nlate);
+	if (nreq > 0) {
+		printf("latency (usec): min %.1f", lmin / 1e3);
+		count = 0;
+		for (i = 0, j = 0; i < NBUCKETS && j < (int) (sizeof(pct) / sizeof(pct[0])); i++) {
+			count += hist[i];
+			while (j < (int) (sizeof(pct) / sizeof(pct[0])) && count > 0 &&
+				   count >= pct[j] / 100 * nreq) {
+				printf("  p%g %.1f", pct[j], min(hist_value(i), lmax) / 1e3);
+				j++;
+			}
+		}
+		printf("  max %.1f\n", lmax / 1e3);
+	}
+	pr_cpu_time();
+
+	exit(0);
+}
@@ -0,0 +1,314 @@
+/* include serv10 */
+#define	_GNU_SOURCE		/* accept4(), CPU_SET() */
+#include	"unpthread.h"
+#include	<sys/epoll.h>
+#include	<sched.h>
+
+//!! 每个核一个线程，各自一个 epoll 事件循环（边沿触发），连接全部非阻塞，
+//!! 协议与 web_child 相同：客户发一行 "N\n"，服务器回 N 个字节，直到客户关闭。
+//!! 默认每个循环有自己的 SO_REUSEPORT 监听套接字，由内核分配新连接；
+//!! -x 则所有循环共用一个监听套接字，用 EPOLLEXCLUSIVE 避免惊群。
+//!! 没有 serv08 那样的 clifd[] 转交，突发连接只会在内核的 listen 队列里排队。
+
+#define	MAXN		16384		/* max # bytes client can request */
+#define	MAXEVENTS	256
+
+#ifndef	SO_REUSEPORT
+#define	SO_REUSEPORT	15
+#endif
+#ifndef	EPOLLEXCLUSIVE
+#define	EPOLLEXCLUSIVE	(1U << 28)
+#endif
+
+typedef struct {
+  pthread_t		loop_tid;		/* thread ID */
+  int			loop_listenfd;	/* own socket, or the shared one with -x */
+  long			loop_count;		/* # connections handled */
+  long			loop_nreq;		/* # requests served */
+} Loop;
+Loop	*lptr;			/* array of Loop structures; calloc'ed */
+
+typedef struct {
+  int			fd;
+  int			eof;			/* client has closed its end */
+  int			nline;			/* #bytes in line[] */
+  long			ntowrite;		/* #bytes still owed to client */
+  char			line[MAXLINE];
+} Conn;
+
+static int		nloops, exclusive;
+static char		result[MAXN];	/* what we send; contents don't matter */
+
+int		listen_nonb(const char *, const char *, int);
+void	*loop_main(void *);
+
+int
+main(int argc, char **argv)
+{
+	int			c, i, listenfd;
+	const char	*host, *port;
+	void		sig_int(int);
+
+	exclusive = 0;
+	opterr = 0;		/* don't want getopt() writing to stderr */
+	while ( (c = getopt(argc, argv, "x")) != -1) {
+		switch (c) {
+		case 'x':
+			exclusive = 1;
+			break;
+
+		case '?':
+			err_quit("unrecognized option: %c", optopt);
+		}
+	}
+
+	if (optind == argc - 2) {
+		host = NULL;
+		port = argv[optind];
+	} else if (optind == argc - 3) {
+		host = argv[optind];
+		port = argv[optind + 1];
+	} else
+		err_quit("usage: serv10 [ -x ] [ <host> ] <port#> <#loops, 0 = one per CPU>");
+
+	if ( (nloops = atoi(argv[argc-1])) <= 0)
+		nloops = sysconf(_SC_NPROCESSORS_ONLN);
+	lptr = Calloc(nloops, sizeof(Loop));
+
+	Signal(SIGPIPE, SIG_IGN);	/* client may close before its reply is sent */
+
+	listenfd = exclusive ? listen_nonb(host, port, 0) : -1;
+	for (i = 0; i < nloops; i++) {
+		lptr[i].loop_listenfd = exclusive ? listenfd : listen_nonb(host, port, 1);
+		Pthread_create(&lptr[i].loop_tid, NULL, &loop_main, (void *) (long) i);
+	}
+
+	Signal(SIGINT, sig_int);
+
+	for ( ; ; )
+		pause();	/* everything done by the loops */
+}
+/* end serv10 */
+
+/* include listen_nonb */
+/*
+ * tcp_listen() with a nonblocking socket, and SO_REUSEPORT set before
+ * bind() so that every loop can bind the same port.
+ */
+int
+listen_nonb(const char *host, const char *serv, int reuseport)
+{
+	int				listenfd, n;
+	const int		on = 1;
+	struct addrinfo	hints, *res, *ressave;
+
+	bzero(&hints, sizeof(struct addrinfo));
+	hints.ai_flags = AI_PASSIVE;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ( (n = getaddrinfo(host, serv, &hints, &res)) != 0)
+		err_quit("listen_nonb error for %s, %s: %s",
+				 host, serv, gai_strerror(n));
+	ressave = res;
+
+	do {
+		listenfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+		if (listenfd < 0)
+			continue;		/* error, try next one */
+
+		Setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (reuseport)
+			Setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+		if (bind(listenfd, res->ai_addr, res->ai_addrlen) == 0)
+			break;			/* success */
+
+		Close(listenfd);	/* bind error, close and try next one */
+	} while ( (res = res->ai_next) != NULL);
+
+	if (res == NULL)	/* errno from final socket() or bind() */
+		err_sys("listen_nonb error for %s, %s", host, serv);
+
+	Fcntl(listenfd, F_SETFL, Fcntl(listenfd, F_GETFL, 0) | O_NONBLOCK);
+	Listen(listenfd, LISTENQ);
+
+	freeaddrinfo(ressave);
+
+	return(listenfd);
+}
+/* end listen_nonb */
+
+/* include loop_main */
+/*
+ * Edge triggered: every handler must run until EAGAIN, or it will not
+ * hear about that descriptor again.
+ */
+static void
+do_accept(int epfd, Loop *lp)
+{
+	int					connfd;
+	Conn				*c;
+	struct epoll_event	ev;
+
+	for ( ; ; ) {
+		if ( (connfd = accept4(lp->loop_listenfd, NULL, NULL, SOCK_NONBLOCK)) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;			/* backlog drained */
+			if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+				continue;
+			if (errno == EMFILE || errno == ENFILE) {
+				err_ret("accept4 error");	/* retried on the next connection */
+				return;
+			}
+			err_sys("accept4 error");
+		}
+
+		c = Malloc(sizeof(Conn));
+		c->fd = connfd;
+		c->eof = 0;
+		c->nline = 0;
+		c->ntowrite = 0;
+
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.ptr = c;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &ev) < 0)
+			err_sys("epoll_ctl error");
+		lp->loop_count++;
+	}
+}
+
+/*
+ * Read until EAGAIN; each complete line adds its #bytes to what we owe.
+ * Returns -1 if the connection should be closed.
+ */
+static int
+conn_read(Conn *c, Loop *lp)
+{
+	ssize_t		n;
+	long		ntowrite;
+	char		*eol, *ptr;
+
+	while (!c->eof) {
+		if ( (n = read(c->fd, c->line + c->nline, MAXLINE - 1 - c->nline)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return(-1);
+		} else if (n == 0) {
+			c->eof = 1;		/* connection closed by other end */
+			break;
+		}
+		c->nline += n;
+
+		ptr = c->line;
+		while ( (eol = memchr(ptr, '\n', c->line + c->nline - ptr)) != NULL) {
+			*eol = 0;
+				/* 4line from client specifies #bytes to write back */
+			ntowrite = atol(ptr);
+			if ((ntowrite <= 0) || (ntowrite > MAXN)) {
+				err_msg("client request for %ld bytes", ntowrite);
+				return(-1);
+			}
+			c->ntowrite += ntowrite;
+			lp->loop_nreq++;
+			ptr = eol + 1;
+		}
+		c->nline -= ptr - c->line;
+		memmove(c->line, ptr, c->nline);
+		if (c->nline == MAXLINE - 1) {
+			err_msg("client request line too long");
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+/* Write what we owe until done or EAGAIN; -1 on error. */
+static int
+conn_write(Conn *c)
+{
+	ssize_t		n;
+
+	while (c->ntowrite > 0) {
+		n = write(c->fd, result, min(c->ntowrite, MAXN));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return(0);	/* EPOLLOUT will bring us back */
+			return(-1);
+		}
+		c->ntowrite -= n;
+	}
+	return(0);
+}
+
+void *
+loop_main(void *arg)
+{
+	int					i, n, epfd, ncpu;
+	long				idx;
+	Loop				*lp;
+	Conn				*c;
+	cpu_set_t			cpus;
+	struct epoll_event	ev, events[MAXEVENTS];
+
+	idx = (long) arg;
+	lp = &lptr[idx];
+
+		/* 4one loop per core: pin loop i to CPU i */
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	CPU_ZERO(&cpus);
+	CPU_SET(idx % ncpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+	if ( (epfd = epoll_create1(0)) < 0)
+		err_sys("epoll_create1 error");
+
+		/* 4data.ptr == NULL is the listening socket */
+	ev.events = EPOLLIN | EPOLLET;
+	if (exclusive)
+		ev.events |= EPOLLEXCLUSIVE;	/* shared socket: wake one loop only */
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, lp->loop_listenfd, &ev) < 0)
+		err_sys("epoll_ctl error");
+
+	printf("loop %ld starting\n", idx);
+	for ( ; ; ) {
+		if ( (n = epoll_wait(epfd, events, MAXEVENTS, -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			err_sys("epoll_wait error");
+		}
+
+		for (i = 0; i < n; i++) {
+			if ( (c = events[i].data.ptr) == NULL) {
+				do_accept(epfd, lp);
+				continue;
+			}
+
+			if (conn_read(c, lp) < 0 || conn_write(c) < 0 ||
+				(c->eof && c->ntowrite == 0)) {
+				Close(c->fd);		/* also removes it from epfd */
+				free(c);
+			}
+		}
+	}
+}
+/* end loop_main */
+
+void
+sig_int(int signo)
+{
+	int		i;
+	void	pr_cpu_time(void);
+
+	pr_cpu_time();
+
+	for (i = 0; i < nloops; i++)
+		printf("loop %d, %ld connections, %ld requests\n",
+			   i, lptr[i].loop_count, lptr[i].loop_nreq);
+
+	exit(0);
+}
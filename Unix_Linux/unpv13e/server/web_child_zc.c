@@ -0,0 +1,226 @@
+/* include web_child_zc */
+#define	_GNU_SOURCE		/* memfd_create() */
+#include	"unp.h"
+#include	<sys/mman.h>
+#include	<sys/sendfile.h>
+
+//!! web_child 的替代实现，可直接代替 web_child.o/web_child_r.o（及 readline.o）链接进任何 serv*：
+//!!   - 回复内容来自一块共享的、按页对齐的只读 mmap（memfd），不再每次调用在栈上放 16KB 的 result[]
+//!!   - 请求行用每个连接一个的 Readbuf（lib/readline.c）读取，不复制，不再每字节一次 read()/my_read()
+//!!   - 发送方式由环境变量 WEB_CHILD 选择：
+//!!       write     Writen() 共享缓冲（默认）
+//!!       writev    已经在缓冲里的多个请求（流水线）用一次 writev() 回复，iovec 都指向同一块 payload
+//!!       sendfile  从 memfd sendfile()，数据不经过用户态
+//!!       zerocopy  >= ZC_MIN 字节时 send(MSG_ZEROCOPY)，内核直接引用 payload 的页
+//!! payload 永远不变，所以 MSG_ZEROCOPY 的完成通知只需从错误队列取走，不用等它再复用缓冲。
+//!! payload 在程序启动时建好，fork 出的子进程直接继承同一块映射；本身可重入，线程版服务器也能用。
+
+#define	MAXN	16384		/* max #bytes that a client can request */
+#define	MAXIOV	64			/* max #responses gathered into one writev() */
+#define	ZC_MIN	(10*1024)	/* MSG_ZEROCOPY costs page pinning; only for large sends */
+
+#ifndef	SO_ZEROCOPY
+#define	SO_ZEROCOPY		60
+#endif
+#ifndef	MSG_ZEROCOPY
+#define	MSG_ZEROCOPY	0x4000000
+#endif
+
+#define	WC_WRITE		0
+#define	WC_WRITEV		1
+#define	WC_SENDFILE		2
+#define	WC_ZEROCOPY		3
+
+static int				payload_fd;	/* memfd holding the payload, for sendfile() */
+static char				*payload;	/* MAXN bytes, read-only, shared by everyone */
+static int				wc_mode;
+
+	/* 4before main(), so fork()ed children share the same pages */
+static void __attribute__((constructor))
+payload_init(void)
+{
+	const char	*mode;
+
+	if ( (payload_fd = memfd_create("web_child", 0)) < 0)
+		err_sys("memfd_create error");
+	if (ftruncate(payload_fd, MAXN) < 0)
+		err_sys("ftruncate error");
+	payload = Mmap(NULL, MAXN, PROT_READ, MAP_SHARED, payload_fd, 0);
+
+	if ( (mode = getenv("WEB_CHILD")) == NULL || strcmp(mode, "write") == 0)
+		wc_mode = WC_WRITE;
+	else if (strcmp(mode, "writev") == 0)
+		wc_mode = WC_WRITEV;
+	else if (strcmp(mode, "sendfile") == 0)
+		wc_mode = WC_SENDFILE;
+	else if (strcmp(mode, "zerocopy") == 0)
+		wc_mode = WC_ZEROCOPY;
+	else
+		err_quit("WEB_CHILD must be write, writev, sendfile or zerocopy");
+}
+/* end web_child_zc */
+
+/* include request_line */
+/*
+ * Next request line from the client, as a view into its Readbuf;
+ * NULL on EOF.  atol() stops at the newline, so no copy is needed.
+ */
+static char *
+request_line(Readbuf *rb)
+{
+	char	*line;
+	ssize_t	n;
+
+	if ( (n = readbuf_linemax(rb, &line, MAXLINE)) < 0) {
+		if (errno == ECONNRESET)
+			return(NULL);	/* client went away mid-reply */
+		if (errno == EMSGSIZE)
+			err_quit("client request line too long");
+		err_sys("readbuf_linemax error");
+	} else if (n == 0)
+		return(NULL);		/* connection closed by other end */
+	return(line);
+}
+
+	/* 4is another complete request already buffered? */
+static int
+request_ready(const Readbuf *rb)
+{
+	return(memchr(rb->rb_ptr, '\n', rb->rb_cnt) != NULL);
+}
+/* end request_line */
+
+static int
+request_size(const char *line)
+{
+	int		ntowrite;
+
+		/* 4line from client specifies #bytes to write back */
+	ntowrite = atol(line);
+	if ((ntowrite <= 0) || (ntowrite > MAXN))
+		err_quit("client request for %d bytes", ntowrite);
+	return(ntowrite);
+}
+
+static void
+writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t		n;
+
+	while (iovcnt > 0) {
+		if ( (n = writev(fd, iov, iovcnt)) < 0) {
+			if (errno == EINTR)
+				continue;
+			err_sys("writev error");
+		}
+		for ( ; iovcnt > 0 && n >= (ssize_t) iov->iov_len; iov++, iovcnt--)
+			n -= iov->iov_len;
+		if (iovcnt > 0) {		/* partial write, in the middle of *iov */
+			iov->iov_base = (char *) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+}
+
+static void
+sendfile_all(int fd, size_t nbytes)
+{
+	off_t		off;
+	ssize_t		n;
+
+	for (off = 0; off < (off_t) nbytes; ) {
+		if ( (n = sendfile(fd, payload_fd, &off, nbytes - off)) < 0) {
+			if (errno == EINTR)
+				continue;
+			err_sys("sendfile error");
+		}
+	}
+}
+
+	/* 4discard completion notifications; the payload never changes */
+static void
+zerocopy_reap(int fd)
+{
+	char			control[128];
+	struct msghdr	msg;
+
+	for ( ; ; ) {
+		bzero(&msg, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			return;
+	}
+}
+
+static void
+zerocopy_all(int fd, size_t nbytes)
+{
+	size_t		nleft;
+	ssize_t		n;
+
+	for (nleft = nbytes; nleft > 0; nleft -= n) {
+		if ( (n = send(fd, payload + nbytes - nleft, nleft, MSG_ZEROCOPY)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			if (errno == ENOBUFS) {		/* too many pinned pages: reap, then copy */
+				zerocopy_reap(fd);
+				Writen(fd, payload + nbytes - nleft, nleft);
+				return;
+			}
+			err_sys("send error");
+		}
+	}
+	zerocopy_reap(fd);
+}
+
+void
+web_child(int sockfd)
+{
+	int				ntowrite, niov, zerocopy;
+	const int		on = 1;
+	char			*line;
+	struct iovec	iov[MAXIOV];
+	Readbuf			*rb;
+
+	rb = Readbuf_open(sockfd, MAXLINE);
+	zerocopy = wc_mode == WC_ZEROCOPY &&
+			   setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+
+	for ( ; ; ) {
+		if ( (line = request_line(rb)) == NULL)
+			break;		/* connection closed by other end */
+		ntowrite = request_size(line);
+
+		switch (wc_mode) {
+		case WC_WRITEV:
+				/* 4answer every request already buffered with one writev() */
+			iov[0].iov_base = payload;
+			iov[0].iov_len = ntowrite;
+			for (niov = 1; niov < MAXIOV && request_ready(rb); niov++) {
+				iov[niov].iov_base = payload;
+				iov[niov].iov_len = request_size(request_line(rb));
+			}
+			writev_all(sockfd, iov, niov);
+			break;
+
+		case WC_SENDFILE:
+			sendfile_all(sockfd, ntowrite);
+			break;
+
+		case WC_ZEROCOPY:
+			if (zerocopy && ntowrite >= ZC_MIN) {
+				zerocopy_all(sockfd, ntowrite);
+				break;
+			}
+			/* FALLTHROUGH */
+
+		default:
+			Writen(sockfd, payload, ntowrite);
+			break;
+		}
+	}
+	readbuf_close(rb);
+}
@@ -6,10 +6,12 @@ str_echo(int sockfd)
 	long		arg1, arg2;
 	ssize_t		n;
 	char		line[MAXLINE];
+	Readbuf		*rb;
 
+	rb = Readbuf_open(sockfd, MAXLINE);	/* per connection: reentrant */
 	for ( ; ; ) {
-		if ( (n = Readline(sockfd, line, MAXLINE)) == 0)
-			return;		/* connection closed by other end */
+		if ( (n = Readbuf_readline(rb, line, MAXLINE)) == 0)
+			break;		/* connection closed by other end */
 
 		if (sscanf(line, "%ld%ld", &arg1, &arg2) == 2)
 			snprintf(line, sizeof(line), "%ld\n", arg1 + arg2);
@@ -19,4 +21,5 @@ str_echo(int sockfd)
 		n = strlen(line);
 		Writen(sockfd, line, n);
 	}
+	readbuf_close(rb);
 }
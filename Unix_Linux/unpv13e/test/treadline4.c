@@ -0,0 +1,132 @@
+#include	"unp.h"
+#include	<time.h>
+
+/*
+ * Lines/sec of the line readers in lib/readline.c, on a temporary file
+ * of short lines and on files of long ones:
+ *   readline()           static buffer, one my_read() per byte
+ *   readbuf_readline()   per-fd Readbuf, memchr(), copies the line
+ *   readbuf_line()       per-fd Readbuf, memchr(), no copy
+ *   getline()            stdio, for reference
+ * usage: treadline4 [ <#MB per file> ]
+ */
+
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+	/* 4temporary file of nbytes in lines of linelen bytes, newline included */
+static int
+make_file(size_t nbytes, int linelen)
+{
+	int		fd;
+	size_t	i, n, bufsize;
+	char	tmpl[] = "/tmp/treadline4.XXXXXX", *buf;
+
+	if ( (fd = mkstemp(tmpl)) < 0)
+		err_sys("mkstemp error");
+	Unlink(tmpl);
+	bufsize = max(BUFFSIZE / linelen, 1) * linelen;	/* whole lines only */
+	buf = Malloc(bufsize);
+	for (i = 0; i < bufsize; i++)
+		buf[i] = (i % linelen == linelen - 1) ? '\n' : 'a' + i % 26;
+	for (n = 0; n < nbytes; n += bufsize)
+		Writen(fd, buf, bufsize);
+	free(buf);
+	return(fd);
+}
+
+static void
+report(const char *name, long nlines, size_t nbytes, double secs)
+{
+	printf("  %-20s %9.2f Mlines/s %8.1f MB/s  (%ld lines)\n",
+		   name, nlines / secs / 1e6, nbytes / secs / 1e6, nlines);
+}
+
+static void
+bench(int fd, int linelen)
+{
+	long	nlines;
+	size_t	nbytes, len;
+	ssize_t	n;
+	double	t0;
+	char	line[MAXLINE], *ptr;
+	Readbuf	*rb;
+	FILE	*fp;
+
+	printf("%d-byte lines\n", linelen);
+
+	if (linelen < MAXLINE) {	/* readline() would split longer lines */
+		lseek(fd, 0, SEEK_SET);
+		nlines = nbytes = 0;
+		t0 = now();
+		while ( (n = Readline(fd, line, MAXLINE)) > 0) {
+			nlines++;
+			nbytes += n;
+		}
+		report("readline", nlines, nbytes, now() - t0);
+	}
+
+	if (linelen < MAXLINE) {
+		lseek(fd, 0, SEEK_SET);
+		nlines = nbytes = 0;
+		t0 = now();
+		rb = Readbuf_open(fd, 0);
+		while ( (n = Readbuf_readline(rb, line, MAXLINE)) > 0) {
+			nlines++;
+			nbytes += n;
+		}
+		readbuf_close(rb);
+		report("readbuf_readline", nlines, nbytes, now() - t0);
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	nlines = nbytes = 0;
+	t0 = now();
+	rb = Readbuf_open(fd, 0);
+	while ( (n = Readbuf_line(rb, &ptr)) > 0) {
+		nlines++;
+		nbytes += n;
+	}
+	readbuf_close(rb);
+	report("readbuf_line", nlines, nbytes, now() - t0);
+
+	lseek(fd, 0, SEEK_SET);
+	nlines = nbytes = 0;
+	t0 = now();
+	if ( (fp = fdopen(dup(fd), "r")) == NULL)
+		err_sys("fdopen error");
+	ptr = NULL;
+	len = 0;
+	while ( (n = getline(&ptr, &len, fp)) > 0) {
+		nlines++;
+		nbytes += n;
+	}
+	free(ptr);
+	Fclose(fp);
+	report("getline (stdio)", nlines, nbytes, now() - t0);
+}
+
+int
+main(int argc, char **argv)
+{
+	int		i, fd;
+	size_t	nbytes;
+	static int	linelen[] = { 8, 80, 1000, 4000, 100000 };
+
+	if (argc > 2)
+		err_quit("usage: treadline4 [ <#MB per file> ]");
+	nbytes = (argc == 2 ? atol(argv[1]) : 64) * 1024 * 1024;
+
+	for (i = 0; i < sizeof(linelen) / sizeof(linelen[0]); i++) {
+		fd = make_file(nbytes, linelen[i]);
+		bench(fd, linelen[i]);
+		Close(fd);
+	}
+	exit(0);
+}
@@ -9,7 +9,11 @@
 #define BOOST_ASIO_BASIC_DIR_MONITOR_HPP 
 
 #include <boost/asio.hpp> 
+#include <boost/date_time/posix_time/posix_time_types.hpp> 
+#include <boost/unordered_map.hpp> 
 #include <string> 
+#include <deque> 
+#include <utility> 
 
 namespace boost { 
 namespace asio { 
@@ -23,7 +27,10 @@ struct dir_monitor_event
         removed = 2, 
         modified = 3, 
         renamed_old_name = 4, 
-        renamed_new_name = 5 
+        renamed_new_name = 5, 
+        // Events were lost (the kernel queue overflowed); filename is empty and 
+        // dirname, as passed to add_directory(), has to be rescanned. 
+        overflow = 6 
     }; 
 
     dir_monitor_event() 
@@ -37,6 +44,71 @@ struct dir_monitor_event
     event_type type; 
 }; 
 
+// Drops an event whose type equals that of the last event reported for the 
+// same directory and file, if that one is less than window ago: a burst of 
+// modifications collapses into one, but added, removed, added is reported in 
+// full. A zero window (the default) lets every event through. An overflow is 
+// never dropped and forgets all history, as events in between were lost. 
+// Not synchronized, the owning implementation calls it under its event queue 
+// lock. 
+class dir_monitor_event_coalescer 
+{ 
+public: 
+    dir_monitor_event_coalescer() 
+        : window_(boost::posix_time::time_duration(0, 0, 0)) 
+    { 
+    } 
+
+    void set_window(const boost::posix_time::time_duration &window) 
+    { 
+        window_ = window; 
+        if (window_ <= boost::posix_time::time_duration(0, 0, 0)) 
+        { 
+            last_.clear(); 
+            recent_.clear(); 
+        } 
+    } 
+
+    bool duplicate(const dir_monitor_event &ev) 
+    { 
+        if (window_ <= boost::posix_time::time_duration(0, 0, 0)) 
+            return false; 
+        if (ev.type == dir_monitor_event::overflow) 
+        { 
+            last_.clear(); 
+            recent_.clear(); 
+            return false; 
+        } 
+
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time(); 
+        while (!recent_.empty() && recent_.front().first + window_ <= now) 
+        { 
+            // Only if no later event of that file has replaced the entry. 
+            last_t::iterator it = last_.find(recent_.front().second); 
+            if (it != last_.end() && it->second.second == recent_.front().first) 
+                last_.erase(it); 
+            recent_.pop_front(); 
+        } 
+
+        std::string key; 
+        key.reserve(ev.dirname.size() + ev.filename.size() + 1); 
+        key.append(ev.dirname).append(1, '\0').append(ev.filename); 
+        last_t::iterator it = last_.find(key); 
+        if (it != last_.end() && it->second.first == ev.type) 
+            return true; 
+        last_[key] = std::make_pair(ev.type, now); 
+        recent_.push_back(std::make_pair(now, key)); 
+        return false; 
+    } 
+
+private: 
+    typedef boost::unordered_map<std::string, std::pair<dir_monitor_event::event_type, boost::posix_time::ptime> > last_t; 
+
+    boost::posix_time::time_duration window_; 
+    last_t last_; 
+    std::deque<std::pair<boost::posix_time::ptime, std::string> > recent_; 
+}; 
+
 template <typename Service> 
 class basic_dir_monitor 
     : public boost::asio::basic_io_object<Service> 
@@ -47,9 +119,9 @@ public:
     { 
     } 
 
-    void add_directory(const std::string &dirname) 
+    void add_directory(const std::string &dirname, bool recursive = false) 
     { 
-        this->service.add_directory(this->implementation, dirname); 
+        this->service.add_directory(this->implementation, dirname, recursive); 
     } 
 
     void remove_directory(const std::string &dirname) 
@@ -57,6 +129,13 @@ public:
         this->service.remove_directory(this->implementation, dirname); 
     } 
 
+    // An event of the same type as the last one reported for that directory and 
+    // file less than window ago is dropped. A zero window turns coalescing off. 
+    void set_coalesce_window(const boost::posix_time::time_duration &window) 
+    { 
+        this->service.set_coalesce_window(this->implementation, window); 
+    } 
+
     dir_monitor_event monitor() 
     { 
         boost::system::error_code ec; 
@@ -32,9 +32,12 @@ public:
 
     explicit basic_dir_monitor_service(boost::asio::io_service &io_service) 
         : boost::asio::io_service::service(io_service), 
+        reactor_(new inotify_reactor()), 
         async_monitor_work_(new boost::asio::io_service::work(async_monitor_io_service_)), 
         async_monitor_thread_(boost::bind(&boost::asio::io_service::run, &async_monitor_io_service_)) 
     { 
+        // All directory monitors of this service share one inotify file descriptor. 
+        reactor_->start(); 
     } 
 
     ~basic_dir_monitor_service() 
@@ -50,17 +53,15 @@ public:
         // destroyed _after_ the thread is finished (not that the thread tries to access 
         // instance properties which don't exist anymore). 
         async_monitor_thread_.join(); 
+
+        reactor_->stop(); 
     } 
 
     typedef boost::shared_ptr<DirMonitorImplementation> implementation_type; 
 
     void construct(implementation_type &impl) 
     { 
-        impl.reset(new DirMonitorImplementation()); 
-
-        // begin_read() can't be called within the constructor but must be called 
-        // explicitly as it calls shared_from_this(). 
-        impl->begin_read(); 
+        impl.reset(new DirMonitorImplementation(reactor_)); 
     } 
 
     void destroy(implementation_type &impl) 
@@ -72,12 +73,12 @@ public:
         impl.reset(); 
     } 
 
-    void add_directory(implementation_type &impl, const std::string &dirname) 
+    void add_directory(implementation_type &impl, const std::string &dirname, bool recursive) 
     { 
         if (!boost::filesystem::is_directory(dirname)) 
             throw std::invalid_argument("boost::asio::basic_dir_monitor_service::add_directory: " + dirname + " is not a valid directory entry"); 
 
-        impl->add_directory(dirname); 
+        impl->add_directory(dirname, recursive); 
     } 
 
     void remove_directory(implementation_type &impl, const std::string &dirname) 
@@ -85,9 +86,17 @@ public:
         impl->remove_directory(dirname); 
     } 
 
+    void set_coalesce_window(implementation_type &impl, const boost::posix_time::time_duration &window) 
+    { 
+        impl->set_coalesce_window(window); 
+    } 
+
     dir_monitor_event monitor(implementation_type &impl, boost::system::error_code &ec) 
     { 
-        return impl->popfront_event(ec); 
+        // Keeps the implementation alive when the directory monitor is destroyed 
+        // while this call blocks; destroy() makes it return operation_aborted. 
+        implementation_type keep(impl); 
+        return keep->popfront_event(ec); 
     } 
 
     template <typename Handler> 
@@ -135,6 +144,7 @@ private:
     { 
     } 
 
+    boost::shared_ptr<inotify_reactor> reactor_; 
     boost::asio::io_service async_monitor_io_service_; 
     boost::scoped_ptr<boost::asio::io_service::work> async_monitor_work_; 
     boost::thread async_monitor_thread_; 
@@ -13,60 +13,344 @@
 #include <boost/thread.hpp> 
 #include <boost/bind.hpp> 
 #include <boost/scoped_ptr.hpp> 
+#include <boost/shared_ptr.hpp> 
 #include <boost/array.hpp> 
-#include <boost/bimap.hpp> 
+#include <boost/unordered_map.hpp> 
 #include <boost/system/error_code.hpp> 
 #include <boost/system/system_error.hpp> 
 #include <string> 
+#include <vector> 
 #include <deque> 
+#include <map> 
+#include <cstring> 
 #include <sys/inotify.h> 
+#include <sys/stat.h> 
+#include <dirent.h> 
 #include <errno.h> 
 
 namespace boost { 
 namespace asio { 
 
-class dir_monitor_impl : 
-    public boost::enable_shared_from_this<dir_monitor_impl> 
+class dir_monitor_impl; 
+
+// One inotify file descriptor and one reader thread shared by all directory 
+// monitors of a service. Watch descriptors are reference counted: several 
+// monitors (or the same monitor under different names) watching the same 
+// directory share the kernel watch, and every subscriber gets the event with 
+// the directory name it registered. Directories added with add_directory() are 
+// kept apart from those only watched because an ancestor was added recursively, 
+// so removing one never takes away a watch the user asked for. 
+class inotify_reactor : 
+    public boost::enable_shared_from_this<inotify_reactor> 
 { 
 public: 
-    dir_monitor_impl() 
+    inotify_reactor() 
         : fd_(init_fd()), 
         stream_descriptor_(inotify_io_service_, fd_), 
         inotify_work_(new boost::asio::io_service::work(inotify_io_service_)), 
         inotify_work_thread_(boost::bind(&boost::asio::io_service::run, &inotify_io_service_)), 
-        run_(true) 
+        begin_(0), 
+        end_(0) 
+    { 
+    } 
+
+    // begin_read() can't be called within the constructor as it calls shared_from_this(). 
+    void start() 
     { 
+        begin_read(); 
     } 
 
-    void add_directory(const std::string &dirname) 
+    // The pending read holds a shared_ptr to the reactor: closing the descriptor 
+    // aborts it, and running the aborted handler releases that reference. 
+    void stop() 
     { 
-        int wd = inotify_add_watch(fd_, dirname.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO); 
+        inotify_work_.reset(); 
+        inotify_io_service_.stop(); 
+        inotify_work_thread_.join(); 
+
+        boost::system::error_code ec; 
+        stream_descriptor_.close(ec); 
+        inotify_io_service_.restart(); 
+        inotify_io_service_.poll(ec); 
+    } 
+
+    void add_watch(dir_monitor_impl *impl, const std::string &dirname, bool recursive) 
+    { 
+        boost::unique_lock<boost::mutex> lock(watches_mutex_); 
+        int wd = watch(impl, dirname, recursive, true); 
         if (wd == -1) 
         { 
-            boost::system::system_error e(boost::system::error_code(errno, boost::system::get_system_category()), "boost::asio::dir_monitor_impl::add_directory: inotify_add_watch failed"); 
+            boost::system::system_error e(boost::system::error_code(errno, boost::system::get_system_category()), "boost::asio::inotify_reactor::add_watch: inotify_add_watch failed"); 
             boost::throw_exception(e); 
         } 
+        if (recursive) 
+            watch_subdirectories(impl, dirname); 
+    } 
 
-        boost::unique_lock<boost::mutex> lock(watch_descriptors_mutex_); 
-        watch_descriptors_.insert(watch_descriptors_t::value_type(wd, dirname)); 
+    void remove_watch(dir_monitor_impl *impl, const std::string &dirname) 
+    { 
+        boost::unique_lock<boost::mutex> lock(watches_mutex_); 
+        paths_t::iterator it = paths_.find(path_key(impl, dirname)); 
+        if (it == paths_.end() || !it->second.added) 
+            return; 
+        it->second.added = it->second.added_recursive = false; 
+        if (covered(impl, dirname)) 
+            set_recursive(it, true);    // still watched for a recursive ancestor 
+        else 
+            unwatch_tree(impl, dirname); 
     } 
 
-    void remove_directory(const std::string &dirname) 
+    void remove_all(dir_monitor_impl *impl) 
+    { 
+        boost::unique_lock<boost::mutex> lock(watches_mutex_); 
+        paths_t::iterator it = paths_.lower_bound(path_key(impl, std::string())); 
+        while (it != paths_.end() && it->first.first == impl) 
+            unwatch(it++); 
+    } 
+
+private: 
+    static const uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO; 
+
+    typedef std::pair<dir_monitor_impl*, std::string> path_key; 
+
+    struct path_entry 
+    { 
+        path_entry(int w, bool r, bool a) : wd(w), recursive(r), added(a), added_recursive(a && r) { } 
+        int wd; 
+        bool recursive;         // new subdirectories are watched too 
+        bool added;             // by add_directory(), not only by recursion 
+        bool added_recursive;   // by add_directory(dirname, true) 
+    }; 
+    typedef std::map<path_key, path_entry> paths_t; 
+
+    struct subscription 
+    { 
+        subscription(dir_monitor_impl *i, const std::string &p, bool r) : impl(i), dirname(p), recursive(r) { } 
+        dir_monitor_impl *impl; 
+        std::string dirname; 
+        bool recursive; 
+    }; 
+    typedef boost::unordered_map<int, std::vector<subscription> > subscriptions_t; 
+
+    int init_fd() 
+    { 
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); 
+        if (fd == -1) 
+        { 
+            boost::system::system_error e(boost::system::error_code(errno, boost::system::get_system_category()), "boost::asio::inotify_reactor::init_fd: init_inotify failed"); 
+            boost::throw_exception(e); 
+        } 
+        return fd; 
+    } 
+
+    // All of the following are called with watches_mutex_ held. 
+
+    int watch(dir_monitor_impl *impl, const std::string &dirname, bool recursive, bool added) 
+    { 
+        int wd = inotify_add_watch(fd_, dirname.c_str(), watch_mask | IN_ONLYDIR); 
+        if (wd == -1) 
+            return -1; 
+        std::pair<paths_t::iterator, bool> res = paths_.insert(paths_t::value_type(path_key(impl, dirname), path_entry(wd, recursive, added))); 
+        if (res.second) 
+            subscriptions_[wd].push_back(subscription(impl, dirname, recursive)); 
+        else 
+        { 
+            path_entry &entry = res.first->second; 
+            if (added) 
+            { 
+                entry.added = true; 
+                entry.added_recursive = entry.added_recursive || recursive; 
+            } 
+            if (recursive) 
+                set_recursive(res.first, true); 
+        } 
+        return wd; 
+    } 
+
+    void set_recursive(paths_t::iterator it, bool recursive) 
+    { 
+        if (it->second.recursive == recursive) 
+            return; 
+        it->second.recursive = recursive; 
+        subscriptions_t::iterator sit = subscriptions_.find(it->second.wd); 
+        if (sit == subscriptions_.end()) 
+            return; 
+        std::vector<subscription> &subs = sit->second; 
+        for (std::size_t i = 0; i < subs.size(); ++i) 
+        { 
+            if (subs[i].impl == it->first.first && subs[i].dirname == it->first.second) 
+                subs[i].recursive = recursive; 
+        } 
+    } 
+
+    // Does an ancestor of dirname, added with add_directory(dirname, true), cover it? 
+    bool covered(dir_monitor_impl *impl, const std::string &dirname) 
+    { 
+        for (std::string::size_type pos = dirname.rfind('/'); pos != std::string::npos && pos > 0; pos = dirname.rfind('/', pos - 1)) 
+        { 
+            paths_t::iterator it = paths_.find(path_key(impl, dirname.substr(0, pos))); 
+            if (it != paths_.end() && it->second.added_recursive) 
+                return true; 
+        } 
+        return false; 
+    } 
+
+    void unwatch(paths_t::iterator it) 
+    { 
+        int wd = it->second.wd; 
+        subscriptions_t::iterator sit = subscriptions_.find(wd); 
+        if (sit != subscriptions_.end()) 
+        { 
+            std::vector<subscription> &subs = sit->second; 
+            for (std::size_t i = 0; i < subs.size(); ++i) 
+            { 
+                if (subs[i].impl == it->first.first && subs[i].dirname == it->first.second) 
+                { 
+                    subs[i] = subs.back(); 
+                    subs.pop_back(); 
+                    break; 
+                } 
+            } 
+            if (subs.empty()) 
+            { 
+                inotify_rm_watch(fd_, wd); 
+                subscriptions_.erase(sit); 
+            } 
+        } 
+        paths_.erase(it); 
+    } 
+
+    // Unwatches dirname and the directories below it that were only watched by 
+    // recursion. Those added with add_directory() stay, and so does what their 
+    // own recursion watches. Paths below dirname sort right after dirname + '/', 
+    // each after its parent. 
+    void unwatch_tree(dir_monitor_impl *impl, const std::string &dirname) 
     { 
-        boost::unique_lock<boost::mutex> lock(watch_descriptors_mutex_); 
-        watch_descriptors_t::right_map::iterator it = watch_descriptors_.right.find(dirname); 
-        if (it != watch_descriptors_.right.end()) 
+        paths_t::iterator it = paths_.find(path_key(impl, dirname)); 
+        if (it != paths_.end()) 
         { 
-            inotify_rm_watch(fd_, it->second); 
-            watch_descriptors_.right.erase(it); 
+            if (it->second.added) 
+                set_recursive(it, it->second.added_recursive); 
+            else 
+                unwatch(it); 
+        } 
+
+        std::string prefix = dirname + '/'; 
+        std::vector<std::string> kept;  // prefixes of kept recursive directories 
+        it = paths_.lower_bound(path_key(impl, prefix)); 
+        while (it != paths_.end() && it->first.first == impl && it->first.second.compare(0, prefix.size(), prefix) == 0) 
+        { 
+            const std::string &path = it->first.second; 
+            bool inherited = false; 
+            for (std::size_t i = 0; i < kept.size() && !inherited; ++i) 
+                inherited = path.compare(0, kept[i].size(), kept[i]) == 0; 
+            if (!it->second.added && !inherited) 
+            { 
+                unwatch(it++); 
+                continue; 
+            } 
+            set_recursive(it, it->second.added_recursive || inherited); 
+            if (it->second.added_recursive) 
+                kept.push_back(path + '/'); 
+            ++it; 
         } 
     } 
 
+    // The parent is watched before its entries are listed, so a subdirectory created 
+    // meanwhile is either found here or reported by an IN_CREATE that watches it. 
+    // Directories which vanish before they can be watched are skipped. 
+    void watch_subdirectories(dir_monitor_impl *impl, const std::string &dirname) 
+    { 
+        std::vector<std::string> pending(1, dirname); 
+        while (!pending.empty()) 
+        { 
+            std::string dir = pending.back(); 
+            pending.pop_back(); 
+            DIR *d = opendir(dir.c_str()); 
+            if (!d) 
+                continue; 
+            while (struct dirent *de = readdir(d)) 
+            { 
+                if (!std::strcmp(de->d_name, ".") || !std::strcmp(de->d_name, "..")) 
+                    continue; 
+                std::string sub = dir + '/' + de->d_name; 
+                bool is_dir = de->d_type == DT_DIR; 
+                if (de->d_type == DT_UNKNOWN) 
+                { 
+                    struct stat st; 
+                    is_dir = lstat(sub.c_str(), &st) == 0 && S_ISDIR(st.st_mode); 
+                } 
+                if (is_dir && watch(impl, sub, true, false) != -1) 
+                    pending.push_back(sub); 
+            } 
+            closedir(d); 
+        } 
+    } 
+
+    void forget(int wd) 
+    { 
+        subscriptions_t::iterator sit = subscriptions_.find(wd); 
+        if (sit == subscriptions_.end()) 
+            return; 
+        for (std::size_t i = 0; i < sit->second.size(); ++i) 
+            paths_.erase(path_key(sit->second[i].impl, sit->second[i].dirname)); 
+        subscriptions_.erase(sit); 
+    } 
+
+    void begin_read() 
+    { 
+        stream_descriptor_.async_read_some(boost::asio::buffer(read_buffer_.data() + end_, read_buffer_.size() - end_), 
+            boost::bind(&inotify_reactor::end_read, shared_from_this(), 
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)); 
+    } 
+
+    void end_read(const boost::system::error_code &ec, std::size_t bytes_transferred); 
+
+    void dispatch(const inotify_event &iev, const char *name); 
+
+    int fd_; 
+    boost::asio::io_service inotify_io_service_; 
+    boost::asio::posix::stream_descriptor stream_descriptor_; 
+    boost::scoped_ptr<boost::asio::io_service::work> inotify_work_; 
+    boost::thread inotify_work_thread_; 
+    // Events are parsed in place; the kernel only returns whole events, but a 
+    // partial tail would be moved to the front and completed by the next read. 
+    boost::array<char, 64 * 1024> read_buffer_; 
+    std::size_t begin_, end_; 
+    boost::mutex watches_mutex_; 
+    paths_t paths_; 
+    subscriptions_t subscriptions_; 
+}; 
+
+class dir_monitor_impl 
+{ 
+public: 
+    explicit dir_monitor_impl(const boost::shared_ptr<inotify_reactor> &reactor) 
+        : reactor_(reactor), 
+        run_(true) 
+    { 
+    } 
+
+    void add_directory(const std::string &dirname, bool recursive) 
+    { 
+        reactor_->add_watch(this, dirname, recursive); 
+    } 
+
+    void remove_directory(const std::string &dirname) 
+    { 
+        reactor_->remove_watch(this, dirname); 
+    } 
+
+    void set_coalesce_window(const boost::posix_time::time_duration &window) 
+    { 
+        boost::unique_lock<boost::mutex> lock(events_mutex_); 
+        coalescer_.set_window(window); 
+    } 
+
     void destroy() 
     { 
-        inotify_work_.reset(); 
-        inotify_io_service_.stop(); 
-        inotify_work_thread_.join(); 
+        // Once remove_all() returns the reactor won't deliver to this object anymore. 
+        reactor_->remove_all(this); 
 
         boost::unique_lock<boost::mutex> lock(events_mutex_); 
         run_ = false; 
@@ -90,88 +374,121 @@ public:
         return ev; 
     } 
 
-    void pushback_event(dir_monitor_event ev) 
+    void pushback_event(const dir_monitor_event &ev) 
     { 
         boost::unique_lock<boost::mutex> lock(events_mutex_); 
-        if (run_) 
+        if (run_ && !coalescer_.duplicate(ev)) 
         { 
+            // Waiters only sleep on an empty queue. 
+            if (events_.empty()) 
+                events_cond_.notify_all(); 
             events_.push_back(ev); 
-            events_cond_.notify_all(); 
         } 
     } 
 
 private: 
-    int init_fd() 
+    boost::shared_ptr<inotify_reactor> reactor_; 
+    boost::mutex events_mutex_; 
+    boost::condition_variable events_cond_; 
+    bool run_; 
+    std::deque<dir_monitor_event> events_; 
+    dir_monitor_event_coalescer coalescer_; 
+}; 
+
+inline void inotify_reactor::end_read(const boost::system::error_code &ec, std::size_t bytes_transferred) 
+{ 
+    if (!ec) 
     { 
-        int fd = inotify_init(); 
-        if (fd == -1) 
+        end_ += bytes_transferred; 
         { 
-            boost::system::system_error e(boost::system::error_code(errno, boost::system::get_system_category()), "boost::asio::dir_monitor_impl::init_fd: init_inotify failed"); 
-            boost::throw_exception(e); 
+            boost::unique_lock<boost::mutex> lock(watches_mutex_); 
+            while (end_ - begin_ >= sizeof(inotify_event)) 
+            { 
+                inotify_event iev; 
+                std::memcpy(&iev, read_buffer_.data() + begin_, sizeof(iev)); 
+                std::size_t size = sizeof(inotify_event) + iev.len; 
+                if (end_ - begin_ < size) 
+                    break; 
+                dispatch(iev, iev.len ? read_buffer_.data() + begin_ + sizeof(inotify_event) : ""); 
+                begin_ += size; 
+            } 
         } 
-        return fd; 
-    } 
+        if (begin_ < end_) 
+            std::memmove(read_buffer_.data(), read_buffer_.data() + begin_, end_ - begin_); 
+        end_ -= begin_; 
+        begin_ = 0; 
 
-public: 
-    void begin_read() 
+        begin_read(); 
+    } 
+    else if (ec != boost::asio::error::operation_aborted) 
     { 
-        stream_descriptor_.async_read_some(boost::asio::buffer(read_buffer_), 
-            boost::bind(&dir_monitor_impl::end_read, shared_from_this(), 
-            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)); 
+        boost::system::system_error e(ec); 
+        boost::throw_exception(e); 
     } 
+} 
 
-private: 
-    void end_read(const boost::system::error_code &ec, std::size_t bytes_transferred) 
+inline void inotify_reactor::dispatch(const inotify_event &iev, const char *name) 
+{ 
+    if (iev.wd == -1) 
     { 
-        if (!ec) 
+        // The kernel queue overflowed and events were lost. Every directory added 
+        // with add_directory() is reported, so its owner knows to rescan it. 
+        if (iev.mask & IN_Q_OVERFLOW) 
         { 
-            pending_read_buffer_ += std::string(read_buffer_.data(), bytes_transferred); 
-            while (pending_read_buffer_.size() > sizeof(inotify_event)) 
+            for (paths_t::iterator it = paths_.begin(); it != paths_.end(); ++it) 
             { 
-                const inotify_event *iev = reinterpret_cast<const inotify_event*>(pending_read_buffer_.data()); 
-                dir_monitor_event::event_type type = dir_monitor_event::null; 
-                switch (iev->mask) 
-                { 
-                case IN_CREATE: type = dir_monitor_event::added; break; 
-                case IN_DELETE: type = dir_monitor_event::removed; break; 
-                case IN_MOVED_FROM: type = dir_monitor_event::renamed_old_name; break; 
-                case IN_MOVED_TO: type = dir_monitor_event::renamed_new_name; break; 
-                } 
-                pushback_event(dir_monitor_event(get_dirname(iev->wd), iev->name, type)); 
-                pending_read_buffer_.erase(0, sizeof(inotify_event) + iev->len); 
+                if (it->second.added) 
+                    it->first.first->pushback_event(dir_monitor_event(it->first.second, std::string(), dir_monitor_event::overflow)); 
             } 
-
-            begin_read(); 
-        } 
-        else if (ec != boost::asio::error::operation_aborted) 
-        { 
-            boost::system::system_error e(ec); 
-            boost::throw_exception(e); 
         } 
+        return; 
     } 
 
-    std::string get_dirname(int wd) 
+    if (iev.mask & IN_IGNORED) 
     { 
-        boost::unique_lock<boost::mutex> lock(watch_descriptors_mutex_); 
-        watch_descriptors_t::left_map::iterator it = watch_descriptors_.left.find(wd); 
-        return it != watch_descriptors_.left.end() ? it->second : ""; 
+        // The directory is gone or was unmounted. 
+        forget(iev.wd); 
+        return; 
     } 
 
-    int fd_; 
-    boost::asio::io_service inotify_io_service_; 
-    boost::asio::posix::stream_descriptor stream_descriptor_; 
-    boost::scoped_ptr<boost::asio::io_service::work> inotify_work_; 
-    boost::thread inotify_work_thread_; 
-    boost::array<char, 4096> read_buffer_; 
-    std::string pending_read_buffer_; 
-    boost::mutex watch_descriptors_mutex_; 
-    typedef boost::bimap<int, std::string> watch_descriptors_t; 
-    watch_descriptors_t watch_descriptors_; 
-    boost::mutex events_mutex_; 
-    boost::condition_variable events_cond_; 
-    bool run_; 
-    std::deque<dir_monitor_event> events_; 
-}; 
+    subscriptions_t::iterator sit = subscriptions_.find(iev.wd); 
+    if (sit == subscriptions_.end()) 
+        return; 
+
+    dir_monitor_event::event_type type = dir_monitor_event::null; 
+    switch (iev.mask & (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO)) 
+    { 
+    case IN_CREATE: type = dir_monitor_event::added; break; 
+    case IN_DELETE: type = dir_monitor_event::removed; break; 
+    case IN_MODIFY: type = dir_monitor_event::modified; break; 
+    case IN_MOVED_FROM: type = dir_monitor_event::renamed_old_name; break; 
+    case IN_MOVED_TO: type = dir_monitor_event::renamed_new_name; break; 
+    } 
+    const bool is_dir = (iev.mask & IN_ISDIR) != 0; 
+
+    // Copied as watching or unwatching subdirectories may change the vector. 
+    std::vector<subscription> subs(sit->second); 
+    for (std::size_t i = 0; i < subs.size(); ++i) 
+    { 
+        const subscription &sub = subs[i]; 
+
+        // A new subdirectory is watched before its event is queued, so whoever 
+        // sees the event can rely on changes inside it being reported. 
+        if (sub.recursive && is_dir) 
+        { 
+            std::string subdir = sub.dirname + '/' + name; 
+            if (type == dir_monitor_event::added || type == dir_monitor_event::renamed_new_name) 
+            { 
+                if (watch(sub.impl, subdir, true, false) != -1) 
+                    watch_subdirectories(sub.impl, subdir); 
+            } 
+            else if (type == dir_monitor_event::renamed_old_name) 
+                unwatch_tree(sub.impl, subdir); 
+        } 
+
+        sub.impl->pushback_event(dir_monitor_event(sub.dirname, name, type)); 
+    } 
+} 
 
 } 
 } 
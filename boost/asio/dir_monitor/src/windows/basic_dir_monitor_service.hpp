@@ -33,9 +33,10 @@ class basic_dir_monitor_service
 public: 
     struct completion_key 
     { 
-        completion_key(HANDLE h, const std::string &d, boost::shared_ptr<DirMonitorImplementation> &i) 
+        completion_key(HANDLE h, const std::string &d, bool r, boost::shared_ptr<DirMonitorImplementation> &i) 
             : handle(h), 
             dirname(d), 
+            recursive(r), 
             impl(i) 
         { 
             ZeroMemory(&overlapped, sizeof(overlapped)); 
@@ -43,6 +44,7 @@ public:
 
         HANDLE handle; 
         std::string dirname; 
+        bool recursive; 
         boost::weak_ptr<DirMonitorImplementation> impl; 
         char buffer[1024]; 
         OVERLAPPED overlapped; 
@@ -97,7 +99,7 @@ public:
         impl.reset(); 
     } 
 
-    void add_directory(implementation_type &impl, const std::string &dirname) 
+    void add_directory(implementation_type &impl, const std::string &dirname, bool recursive) 
     { 
         if (!boost::filesystem::is_directory(dirname)) 
             throw std::invalid_argument("boost::asio::basic_dir_monitor_service::add_directory: " + dirname + " is not a valid directory entry"); 
@@ -112,7 +114,7 @@ public:
 
         // No smart pointer can be used as the pointer must travel as a completion key 
         // through the I/O completion port module. 
-        completion_key *ck = new completion_key(handle, dirname, impl); 
+        completion_key *ck = new completion_key(handle, dirname, recursive, impl); 
         iocp_ = CreateIoCompletionPort(ck->handle, iocp_, reinterpret_cast<unsigned long>(ck), 0); 
         if (iocp_ == NULL) 
         { 
@@ -123,7 +125,7 @@ public:
         } 
 
         DWORD bytes_transferred; // ignored 
-        BOOL res = ReadDirectoryChangesW(ck->handle, ck->buffer, sizeof(ck->buffer), FALSE, 0x1FF, &bytes_transferred, &ck->overlapped, NULL); 
+        BOOL res = ReadDirectoryChangesW(ck->handle, ck->buffer, sizeof(ck->buffer), ck->recursive ? TRUE : FALSE, 0x1FF, &bytes_transferred, &ck->overlapped, NULL); 
         if (!res) 
         { 
             delete ck; 
@@ -135,6 +137,11 @@ public:
         impl->add_directory(dirname, ck->handle); 
     } 
 
+    void set_coalesce_window(implementation_type &impl, const boost::posix_time::time_duration &window) 
+    { 
+        impl->set_coalesce_window(window); 
+    } 
+
     void remove_directory(implementation_type &impl, const std::string &dirname) 
     { 
         // Removing the directory from the implementation will automatically close the associated file handle. 
@@ -258,7 +265,7 @@ private:
                         while (fni->NextEntryOffset); 
 
                         ZeroMemory(&ck->overlapped, sizeof(ck->overlapped)); 
-                        BOOL res = ReadDirectoryChangesW(ck->handle, ck->buffer, sizeof(ck->buffer), FALSE, 0x1FF, &bytes_transferred, &ck->overlapped, NULL); 
+                        BOOL res = ReadDirectoryChangesW(ck->handle, ck->buffer, sizeof(ck->buffer), ck->recursive ? TRUE : FALSE, 0x1FF, &bytes_transferred, &ck->overlapped, NULL); 
                         if (!res) 
                         { 
                             delete ck; 
@@ -54,6 +54,12 @@ public:
         dirs_.erase(dirname); 
     } 
 
+    void set_coalesce_window(const boost::posix_time::time_duration &window) 
+    { 
+        boost::unique_lock<boost::mutex> lock(events_mutex_); 
+        coalescer_.set_window(window); 
+    } 
+
     void destroy() 
     { 
         boost::unique_lock<boost::mutex> lock(events_mutex_); 
@@ -81,7 +87,7 @@ public:
     void pushback_event(dir_monitor_event ev) 
     { 
         boost::unique_lock<boost::mutex> lock(events_mutex_); 
-        if (run_) 
+        if (run_ && !coalescer_.duplicate(ev)) 
         { 
             events_.push_back(ev); 
             events_cond_.notify_all(); 
@@ -94,6 +100,7 @@ private:
     boost::condition_variable events_cond_; 
     bool run_; 
     std::deque<dir_monitor_event> events_; 
+    dir_monitor_event_coalescer coalescer_; 
 }; 
 
 } 
@@ -0,0 +1,159 @@
+// 
+// Copyright (c) 2008, 2009 Boris Schaeling <boris@highscore.de> 
+// 
+// Distributed under the Boost Software License, Version 1.0. (See accompanying 
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt) 
+// 
+
+// Event throughput of a recursive dir_monitor under a rand_dtree-style load: 
+// a random tree of directories is watched, then directories are randomly 
+// created, removed and renamed while files in them are created and rewritten. 
+// 
+// usage: bench [root [dirs [ops [coalesce_ms]]]] 
+
+#include "dir_monitor.hpp" 
+#include <boost/filesystem.hpp> 
+#include <boost/thread.hpp> 
+#include <boost/date_time/posix_time/posix_time.hpp> 
+#include <boost/lexical_cast.hpp> 
+#include <iostream> 
+#include <fstream> 
+#include <vector> 
+#include <string> 
+#include <cstdlib> 
+#include <cstdio> 
+
+namespace { 
+
+boost::mutex count_mutex; 
+unsigned long event_count = 0; 
+boost::posix_time::ptime last_event; 
+
+void consume(boost::asio::dir_monitor *dm) 
+{ 
+    for (;;) 
+    { 
+        boost::system::error_code ec; 
+        dm->monitor(ec); 
+        if (ec) 
+            break; 
+        boost::unique_lock<boost::mutex> lock(count_mutex); 
+        ++event_count; 
+        last_event = boost::posix_time::microsec_clock::universal_time(); 
+    } 
+} 
+
+unsigned long events() 
+{ 
+    boost::unique_lock<boost::mutex> lock(count_mutex); 
+    return event_count; 
+} 
+
+double seconds(const boost::posix_time::ptime &from, const boost::posix_time::ptime &to) 
+{ 
+    return (to - from).total_microseconds() / 1e6; 
+} 
+
+} 
+
+int main(int argc, char *argv[]) 
+{ 
+    std::string root = argc > 1 ? argv[1] : "dir_monitor_bench"; 
+    int dirs = argc > 2 ? std::atoi(argv[2]) : 10000; 
+    int ops = argc > 3 ? std::atoi(argv[3]) : 100000; 
+    int coalesce_ms = argc > 4 ? std::atoi(argv[4]) : 0; 
+
+    boost::filesystem::remove_all(root); 
+    boost::filesystem::create_directory(root); 
+    std::srand(1); 
+
+    // Random tree: every new directory goes below a random existing one. 
+    std::vector<std::string> dir_list(1, root); 
+    int serial = 0; 
+    for (int i = 0; i < dirs; ++i) 
+    { 
+        std::string d = dir_list[std::rand() % dir_list.size()] + "/d" + boost::lexical_cast<std::string>(serial++); 
+        boost::filesystem::create_directory(d); 
+        dir_list.push_back(d); 
+    } 
+
+    boost::asio::io_service io_service; 
+    boost::asio::dir_monitor *dm = new boost::asio::dir_monitor(io_service); 
+    if (coalesce_ms > 0) 
+        dm->set_coalesce_window(boost::posix_time::milliseconds(coalesce_ms)); 
+
+    boost::posix_time::ptime t0 = boost::posix_time::microsec_clock::universal_time(); 
+    dm->add_directory(root, true); 
+    boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time(); 
+    std::printf("watched %d directories in %.3f s (%.0f dirs/sec)\n", dirs + 1, seconds(t0, t1), (dirs + 1) / seconds(t0, t1)); 
+
+    boost::thread consumer(boost::bind(&consume, dm)); 
+
+    // Like rand_dtree's c/d/m modes, mixed with file writes that produce 
+    // repeated modified events on the same names. 
+    t0 = boost::posix_time::microsec_clock::universal_time(); 
+    for (int i = 0; i < ops; ++i) 
+    { 
+        std::size_t k = std::rand() % dir_list.size(); 
+        switch (std::rand() % 8) 
+        { 
+        case 0: 
+        { 
+            std::string d = dir_list[k] + "/d" + boost::lexical_cast<std::string>(serial++); 
+            boost::filesystem::create_directory(d); 
+            dir_list.push_back(d); 
+            break; 
+        } 
+        case 1: 
+        { 
+            boost::system::error_code ec; 
+            if (k && boost::filesystem::is_empty(dir_list[k], ec) && !ec && boost::filesystem::remove(dir_list[k], ec)) 
+            { 
+                dir_list[k] = dir_list.back(); 
+                dir_list.pop_back(); 
+            } 
+            break; 
+        } 
+        case 2: 
+        { 
+            // Renaming a directory moves its whole subtree, so only leaves are renamed 
+            // to keep dir_list valid. 
+            boost::system::error_code ec; 
+            if (!k || !boost::filesystem::is_empty(dir_list[k], ec) || ec) 
+                break; 
+            std::size_t to = std::rand() % dir_list.size(); 
+            std::string d = dir_list[to] + "/d" + boost::lexical_cast<std::string>(serial++); 
+            boost::filesystem::rename(dir_list[k], d, ec); 
+            if (!ec) 
+                dir_list[k] = d; 
+            break; 
+        } 
+        default: 
+        { 
+            std::ofstream ofs((dir_list[k] + "/f" + boost::lexical_cast<std::string>(std::rand() % 4)).c_str(), std::ios::app); 
+            ofs << i << '\n'; 
+            break; 
+        } 
+        } 
+    } 
+    t1 = boost::posix_time::microsec_clock::universal_time(); 
+
+    // Wait until the monitor has been quiet for half a second. 
+    unsigned long seen = events(); 
+    for (;;) 
+    { 
+        boost::this_thread::sleep(boost::posix_time::milliseconds(500)); 
+        unsigned long now = events(); 
+        if (now == seen) 
+            break; 
+        seen = now; 
+    } 
+    delete dm; 
+    consumer.join(); 
+
+    std::printf("%d operations in %.3f s, %lu events in %.3f s: %.0f events/sec (coalesce window %d ms)\n", 
+        ops, seconds(t0, t1), event_count, seconds(t0, last_event), event_count / seconds(t0, last_event), coalesce_ms); 
+
+    boost::filesystem::remove_all(root); 
+    return 0; 
+} 
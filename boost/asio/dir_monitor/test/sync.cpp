@@ -119,3 +119,111 @@ BOOST_AUTO_TEST_CASE(dir_monitor_destruction)
 
     dir.create_file(TEST_FILE1); 
 } 
+
+BOOST_AUTO_TEST_CASE(recursive_directories) 
+{ 
+    directory dir(TEST_DIR1); 
+    boost::filesystem::create_directory(TEST_DIR1 "/" TEST_DIR2); 
+
+    boost::asio::dir_monitor dm(io_service); 
+    dm.add_directory(TEST_DIR1, true); 
+
+    // A subdirectory which existed before add_directory() was called 
+    { std::ofstream ofs(TEST_DIR1 "/" TEST_DIR2 "/" TEST_FILE1); } 
+
+    boost::asio::dir_monitor_event ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.dirname, TEST_DIR1 "/" TEST_DIR2); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE1); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+
+    // A subdirectory created afterwards is watched once its event is reported 
+    boost::filesystem::create_directory(TEST_DIR1 "/" TEST_DIR2 "/" TEST_DIR2); 
+
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.dirname, TEST_DIR1 "/" TEST_DIR2); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_DIR2); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+
+    { std::ofstream ofs(TEST_DIR1 "/" TEST_DIR2 "/" TEST_DIR2 "/" TEST_FILE2); } 
+
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.dirname, TEST_DIR1 "/" TEST_DIR2 "/" TEST_DIR2); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE2); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+} 
+
+BOOST_AUTO_TEST_CASE(coalesce_events) 
+{ 
+    directory dir(TEST_DIR1); 
+
+    boost::asio::dir_monitor dm(io_service); 
+    dm.set_coalesce_window(boost::posix_time::seconds(10)); 
+    dm.add_directory(TEST_DIR1); 
+
+    dir.create_file(TEST_FILE1); 
+    dir.remove_file(TEST_FILE1); 
+    dir.create_file(TEST_FILE1); 
+    { std::ofstream ofs(TEST_DIR1 "/" TEST_FILE1, std::ios::app); ofs << "1"; } 
+    { std::ofstream ofs(TEST_DIR1 "/" TEST_FILE1, std::ios::app); ofs << "2"; } 
+    dir.create_file(TEST_FILE2); 
+
+    boost::asio::dir_monitor_event ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE1); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE1); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::removed); 
+
+    // Differs from the last event of TEST_FILE1, so it is reported 
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE1); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+
+    // The second modification falls into the window and is dropped 
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE1); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::modified); 
+
+    ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE2); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+} 
+
+BOOST_AUTO_TEST_CASE(remove_recursive_keeps_added) 
+{ 
+    directory dir(TEST_DIR1); 
+    boost::filesystem::create_directory(TEST_DIR1 "/" TEST_DIR2); 
+
+    boost::asio::dir_monitor dm(io_service); 
+    dm.add_directory(TEST_DIR1, true); 
+    dm.add_directory(TEST_DIR1 "/" TEST_DIR2); 
+
+    // The subdirectory was added by itself too, so it is still watched 
+    dm.remove_directory(TEST_DIR1); 
+    dir.create_file(TEST_FILE1); 
+    { std::ofstream ofs(TEST_DIR1 "/" TEST_DIR2 "/" TEST_FILE2); } 
+
+    boost::asio::dir_monitor_event ev = dm.monitor(); 
+    BOOST_CHECK_EQUAL(ev.dirname, TEST_DIR1 "/" TEST_DIR2); 
+    BOOST_CHECK_EQUAL(ev.filename, TEST_FILE2); 
+    BOOST_CHECK_EQUAL(ev.type, boost::asio::dir_monitor_event::added); 
+} 
+
+#if !defined(_WIN32) && !defined(__WIN32__) && !defined(WIN32) 
+BOOST_AUTO_TEST_CASE(reactor_released) 
+{ 
+    directory dir(TEST_DIR1); 
+    boost::filesystem::path fd_dir("/proc/self/fd"); 
+    std::ptrdiff_t fds = std::distance(boost::filesystem::directory_iterator(fd_dir), boost::filesystem::directory_iterator()); 
+
+    { 
+        boost::asio::io_service ios; 
+        boost::asio::dir_monitor dm(ios); 
+        dm.add_directory(TEST_DIR1); 
+    } 
+
+    // The inotify descriptor goes away with the service 
+    BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(fd_dir), boost::filesystem::directory_iterator()), fds); 
+} 
+#endif 
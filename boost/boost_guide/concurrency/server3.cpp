@@ -0,0 +1,88 @@
+#include <std.hpp>
+using namespace std;
+
+#define BOOST_ASIO_DISABLE_STD_CHRONO
+#include <boost/asio.hpp>
+#include "../../context/asio_coro.hpp"
+using namespace boost::asio;
+
+// server2 的回调链改成 asio_coro.hpp 的协程：
+// 一个协程负责accept，每个连接再起一个协程顺序地 读-回写，直到对方关闭。
+// 所有协程都在 m_io 这一个线程里跑，栈从 m_stacks 复用。
+// m_stacks 要声明在 m_io 前面：~io_service 会 unwind 挂起的协程，把栈还给池。
+//////////////////////////////////////////
+
+class server
+{
+    typedef ip::tcp::acceptor     acceptor_type;
+    typedef ip::tcp::endpoint   endpoint_type;
+    typedef ip::tcp::socket   socket_type;
+
+private:
+    coro::StackPool m_stacks;
+    io_service m_io;
+    acceptor_type m_acceptor;
+public:
+    server():
+      m_acceptor(m_io,endpoint_type(ip::tcp::v4(), 6688))
+    {
+        coro::spawn(m_io, m_stacks,
+            [this](coro::Yield yield)
+            {   accept(yield);  });
+    }
+
+    void run()
+    {
+        m_io.run();
+    }
+
+private:
+    void accept(coro::Yield yield)
+    {
+        for(;;)
+        {
+            std::shared_ptr<socket_type> sock(new socket_type(m_io));
+            boost::system::error_code ec;
+
+            m_acceptor.async_accept(*sock, yield[ec]);
+            if (ec)
+            {   return;     }
+
+            //!! 对方可能已经RST，抛出的异常会从 m_io.run() 出去，整个服务就停了
+            auto ep = sock->remote_endpoint(ec);
+            if (ec)
+            {   continue;   }
+
+            cout << "client:";
+            cout << ep.address() << endl;
+
+            coro::spawn(m_io, m_stacks,
+                [this, sock](coro::Yield yield)
+                {   echo(*sock, yield);  });
+        }
+    }
+
+    void echo(socket_type& sock, coro::Yield yield)
+    {
+        boost::system::error_code ec;
+        async_write(sock, buffer("hello asio\n", 11), yield[ec]);
+
+        char buf[1024];
+        while (!ec)
+        {
+            auto len = sock.async_read_some(buffer(buf), yield[ec]);
+            if (ec)
+            {   break;  }
+
+            async_write(sock, buffer(buf, len), yield[ec]);
+        }
+        cout << "client closed." << endl;
+    }
+};
+
+
+int main()
+{
+    server svr;
+    svr.run();
+}
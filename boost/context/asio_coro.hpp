@@ -0,0 +1,337 @@
+/*
+ * 基于 boost::context 的有栈协程，挂在 asio 的 io_service 上，
+ * 连接处理可以像阻塞代码一样顺序写，不用回调链，也不用一个连接一个线程：
+ *
+ *   coro::StackPool pool;
+ *   coro::spawn(io, pool, [&]( coro::Yield yield ) {
+ *       ip::tcp::socket sock(io);
+ *       acceptor.async_accept(sock, yield);
+ *       error_code ec;
+ *       size_t n = sock.async_read_some(buffer(buf), yield[ec]);
+ *       async_write(sock, buffer(buf, n), yield);
+ *   });
+ *   io.run();
+ *
+ * 把 yield 当作完成回调传给任何 asio 异步操作：发起操作后协程切回 io_service，
+ * 操作完成时回调把协程切回来，返回值就是操作结果。带[ec]时错误写到ec里，否则抛 system_error。
+ * 协程里抛出的异常从 io.run() 里抛出来。
+ *
+ * 栈来自 StackPool：每个栈最低一页 PROT_NONE 做 guard page，溢出是 SIGSEGV 而不是悄悄踩坏别的内存；
+ * 协程结束后栈回到池里，下一个连接直接复用，省掉 mmap/mprotect/munmap。
+ * 池的状态由它和每个借出的栈共同持有：io_service 析构时 unwind 的协程即使晚于 StackPool 析构，
+ * 栈也能还回去。照常还是先声明 StackPool 再声明 io_service，让池活得比协程久。
+ *
+ * 约束：一个 io_service 只由一个线程 run（one loop per thread），协程总在这个线程里恢复，
+ * StackPool 也不加锁，每个 io_service 用自己的。
+ * io_service 析构时还挂起着的协程会被 unwind，栈上的对象照常析构。
+ */
+#ifndef _ASIO_CORO_HPP_
+#define _ASIO_CORO_HPP_
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/context/fiber.hpp>
+#include <boost/context/stack_context.hpp>
+
+namespace coro {
+
+class StackPool {
+public:
+    explicit StackPool( std::size_t stackSize = 64 * 1024, std::size_t maxCached = 1024 )
+        : state(std::make_shared<State>(stackSize, maxCached)) {}
+
+    StackPool( const StackPool& ) = delete;
+    StackPool& operator=( const StackPool& ) = delete;
+
+    boost::context::stack_context allocate()
+    { return state->allocate(); }
+
+    void deallocate( boost::context::stack_context &sctx )
+    { state->deallocate(sctx); }
+
+    // 可用栈大小（不含guard page）
+    std::size_t stack_size() const
+    { return state->size - state->pageSize; }
+
+    // 当前 mmap 着的栈数，包括池里空闲的
+    std::size_t mapped() const
+    { return state->nMapped; }
+
+private:
+    friend class PooledStack;
+
+    // 最后一个持有者（池或借出的栈）释放时才 munmap 空闲的栈
+    struct State {
+        State( std::size_t stackSize, std::size_t maxCached )
+            : pageSize(::sysconf(_SC_PAGESIZE)), maxCached(maxCached), nMapped(0)
+        { size = (stackSize + pageSize - 1) / pageSize * pageSize + pageSize; }
+
+        ~State()
+        {
+            for (void *base : freeList)
+                ::munmap(base, size);
+        }
+
+        boost::context::stack_context allocate()
+        {
+            void *base;
+            if (!freeList.empty()) {
+                base = freeList.back();
+                freeList.pop_back();
+            } else {
+                base = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+                if (base == MAP_FAILED)
+                    throw std::bad_alloc();
+                if (::mprotect(base, pageSize, PROT_NONE) != 0) {
+                    ::munmap(base, size);
+                    throw std::bad_alloc();
+                } // if
+                ++nMapped;
+            } // if
+
+            boost::context::stack_context sctx;
+            sctx.size = size;
+            sctx.sp = static_cast<char*>(base) + size;
+            return sctx;
+        }
+
+        void deallocate( boost::context::stack_context &sctx )
+        {
+            void *base = static_cast<char*>(sctx.sp) - size;
+            if (freeList.size() < maxCached) {
+                freeList.push_back(base);
+            } else {
+                ::munmap(base, size);
+                --nMapped;
+            } // if
+        }
+
+        std::size_t         pageSize;
+        std::size_t         size;
+        std::size_t         maxCached;
+        std::size_t         nMapped;
+        std::vector<void*>  freeList;
+    };
+
+    std::shared_ptr<State>  state;
+};
+
+// fiber 会复制 StackAllocator，所以传给它的是池状态的句柄；
+// 句柄持有状态，栈还回去之前 StackPool 先析构也不要紧
+class PooledStack {
+public:
+    explicit PooledStack( StackPool &pool ) : state(pool.state) {}
+
+    boost::context::stack_context allocate()
+    { return state->allocate(); }
+
+    void deallocate( boost::context::stack_context &sctx )
+    { state->deallocate(sctx); }
+
+private:
+    std::shared_ptr<StackPool::State>   state;
+};
+
+class Coroutine;
+
+// 完成回调的占位符，协程函数的参数
+class Yield {
+public:
+    explicit Yield( Coroutine *co ) : co(co), ec(0) {}
+
+    Yield operator[]( boost::system::error_code &ec ) const
+    {
+        Yield ret(*this);
+        ret.ec = &ec;
+        return ret;
+    }
+
+    Coroutine                   *co;
+    boost::system::error_code   *ec;
+};
+
+// 挂起时由还没完成的异步操作的回调持有 shared_ptr，运行时由恢复它的一方持有。
+// 回调没被调用就被销毁（io_service 析构）时最后一个引用消失，~fiber 把协程栈 unwind 掉。
+class Coroutine : public std::enable_shared_from_this<Coroutine> {
+public:
+    Coroutine( StackPool &pool, std::function<void(Yield)> fn )
+        : body(std::move(fn))
+        , self(std::allocator_arg, PooledStack(pool),
+                [this]( boost::context::fiber &&c ) {
+                    caller = std::move(c);
+                    try {
+                        body(Yield(this));
+                    } catch (const boost::context::detail::forced_unwind&) {
+                        throw;
+                    } catch (...) {
+                        error = std::current_exception();
+                    } // try
+                    return std::move(caller);
+                })
+    {}
+
+    Coroutine( const Coroutine& ) = delete;
+    Coroutine& operator=( const Coroutine& ) = delete;
+
+    // io_service 线程里调用，切进协程直到它下一次挂起或结束
+    void resume()
+    {
+        self = std::move(self).resume();
+        if (error) {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        } // if
+    }
+
+    // 协程里调用，切回 resume() 的调用者
+    void suspend()
+    { caller = std::move(caller).resume(); }
+
+private:
+    std::function<void(Yield)>  body;
+    std::exception_ptr          error;
+    boost::context::fiber       caller;
+    boost::context::fiber       self;       // 最后声明，最先析构
+};
+
+namespace detail {
+
+class HandlerBase {
+public:
+    explicit HandlerBase( const Yield &y ) : co(y.co->shared_from_this()), ec(y.ec) {}
+
+    std::shared_ptr<Coroutine>  co;
+    boost::system::error_code   *ec;
+
+protected:
+    void wake()
+    {
+        std::shared_ptr<Coroutine> c(std::move(co));
+        c->resume();
+    }
+};
+
+template < typename T >
+class Handler : public HandlerBase {
+public:
+    explicit Handler( const Yield &y ) : HandlerBase(y), value(0) {}
+
+    void operator()( const boost::system::error_code &e, T v )
+    {
+        *ec = e;
+        *value = std::move(v);
+        wake();
+    }
+
+    T   *value;
+};
+
+template <>
+class Handler<void> : public HandlerBase {
+public:
+    explicit Handler( const Yield &y ) : HandlerBase(y) {}
+
+    void operator()( const boost::system::error_code &e )
+    {
+        *ec = e;
+        wake();
+    }
+
+    void operator()()
+    { wake(); }
+};
+
+// 回调和协程都只在 io_service 线程里跑，发起操作后 get() 马上挂起，回调一定在挂起之后才执行
+class ResultBase {
+protected:
+    explicit ResultBase( HandlerBase &h ) : co(h.co.get()), userEc(h.ec)
+    {
+        if (!h.ec)
+            h.ec = &ec;
+    }
+
+    void wait()
+    {
+        co->suspend();
+        if (!userEc && ec)
+            throw boost::system::system_error(ec);
+    }
+
+    Coroutine                   *co;
+    boost::system::error_code   *userEc;
+    boost::system::error_code   ec;
+};
+
+} // namespace detail
+
+template < typename Fn >
+void spawn( boost::asio::io_service &io, StackPool &pool, Fn &&fn )
+{
+    std::shared_ptr<Coroutine> co = std::make_shared<Coroutine>(pool, std::forward<Fn>(fn));
+    boost::asio::post(io, [co]{ co->resume(); });
+}
+
+} // namespace coro
+
+
+namespace boost {
+namespace asio {
+
+template < typename T >
+class async_result<coro::Yield, void(boost::system::error_code, T)> : public coro::detail::ResultBase {
+public:
+    typedef coro::detail::Handler<T>    completion_handler_type;
+    typedef T                           return_type;
+
+    explicit async_result( completion_handler_type &h ) : ResultBase(h), value()
+    { h.value = &value; }
+
+    return_type get()
+    {
+        wait();
+        return std::move(value);
+    }
+
+private:
+    T   value;
+};
+
+template <>
+class async_result<coro::Yield, void(boost::system::error_code)> : public coro::detail::ResultBase {
+public:
+    typedef coro::detail::Handler<void> completion_handler_type;
+    typedef void                        return_type;
+
+    explicit async_result( completion_handler_type &h ) : ResultBase(h) {}
+
+    void get()
+    { wait(); }
+};
+
+// post(io, yield)：让出一次，排到已就绪的回调后面
+template <>
+class async_result<coro::Yield, void()> : public coro::detail::ResultBase {
+public:
+    typedef coro::detail::Handler<void> completion_handler_type;
+    typedef void                        return_type;
+
+    explicit async_result( completion_handler_type &h ) : ResultBase(h) {}
+
+    void get()
+    { wait(); }
+};
+
+} // namespace asio
+} // namespace boost
+
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * asio_coro.hpp 的开销：
+ *   1. 切换：fiber 来回切一次、协程经 io_service 让出一次(post(io, yield))、两个线程用条件变量来回切一次
+ *   2. 起协程：StackPool 复用栈 vs 每次 mmap/munmap（maxCached = 0）
+ *   3. echo 吞吐：同一个 echo 服务分别用 协程 / 回调链(server2的写法) / 一个连接一个线程 实现，
+ *      客户端是单独一个线程里的 asio 回调，conns 个连接各自不停地 写64字节-读回来
+ *
+ * c++ -o /tmp/coro_bench coro_bench.cpp -std=c++11 -O2 -pthread -lboost_context -lboost_system
+ * usage: coro_bench [seconds_per_run [max_conns]]
+ */
+#include "asio_coro.hpp"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define MSG_SIZE        64
+#define SWITCHES        2000000
+#define SPAWNS          200000
+
+using namespace boost::asio;
+typedef ip::tcp::socket socket_type;
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed( Clock::time_point t0 )
+{ return std::chrono::duration<double>(Clock::now() - t0).count(); }
+
+static void bench_fiber_switch()
+{
+    coro::StackPool pool;
+    long n = 0;
+    boost::context::fiber f(std::allocator_arg, coro::PooledStack(pool),
+            [&n]( boost::context::fiber &&c ) {
+                while (++n < SWITCHES)
+                    c = std::move(c).resume();
+                return std::move(c);
+            });
+    auto t0 = Clock::now();
+    while (f)
+        f = std::move(f).resume();
+    printf("  %-36s %7.1f ns\n", "fiber resume + yield", elapsed(t0) / SWITCHES * 1e9);
+}
+
+static void bench_coro_post()
+{
+    io_service io;
+    coro::StackPool pool;
+    coro::spawn(io, pool, [&io]( coro::Yield yield ) {
+        for (int i = 0; i < SWITCHES; ++i)
+            post(io, yield);
+    });
+    auto t0 = Clock::now();
+    io.run();
+    printf("  %-36s %7.1f ns\n", "coroutine post(io, yield)", elapsed(t0) / SWITCHES * 1e9);
+}
+
+static void bench_thread_switch()
+{
+    std::mutex mtx;
+    std::condition_variable cond;
+    int turn = 0, rounds = SWITCHES / 20;
+    auto pingpong = [&]( int me ) {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (int i = 0; i < rounds; ++i) {
+            cond.wait(lk, [&]{ return turn == me; });
+            turn = !me;
+            cond.notify_one();
+        } // for
+    };
+    auto t0 = Clock::now();
+    std::thread t(pingpong, 1);
+    pingpong(0);
+    t.join();
+    printf("  %-36s %7.1f ns\n", "thread condvar ping-pong", elapsed(t0) / rounds / 2 * 1e9);
+}
+
+static void bench_spawn( const char *name, std::size_t maxCached )
+{
+    io_service io;
+    coro::StackPool pool(64 * 1024, maxCached);
+    long done = 0;
+    auto t0 = Clock::now();
+    for (int i = 0; i < SPAWNS; ++i) {
+        coro::spawn(io, pool, [&done]( coro::Yield ) { ++done; });
+        if (!(i & 1023))
+            io.run(), io.restart();
+    } // for
+    io.run();
+    printf("  %-36s %7.1f ns%s\n", name, elapsed(t0) / SPAWNS * 1e9, done == SPAWNS ? "" : "  LOST");
+}
+
+// 三种 echo 服务：都只接受 conns 个连接，连接都关闭后退出
+
+static void coro_server( io_service &io, ip::tcp::acceptor &acceptor, int conns )
+{
+    coro::StackPool pool;
+    coro::spawn(io, pool, [&]( coro::Yield yield ) {
+        for (int i = 0; i < conns; ++i) {
+            std::shared_ptr<socket_type> sock(new socket_type(io));
+            acceptor.async_accept(*sock, yield);
+            sock->set_option(ip::tcp::no_delay(true));
+            coro::spawn(io, pool, [sock]( coro::Yield yield ) {
+                char buf[MSG_SIZE];
+                boost::system::error_code ec;
+                while (true) {
+                    std::size_t n = sock->async_read_some(buffer(buf), yield[ec]);
+                    if (ec || (async_write(*sock, buffer(buf, n), yield[ec]), ec))
+                        break;
+                } // while
+            });
+        } // for
+    });
+    io.run();
+}
+
+class CallbackSession : public std::enable_shared_from_this<CallbackSession> {
+public:
+    explicit CallbackSession( io_service &io ) : sock(io) {}
+
+    void read()
+    {
+        auto self = shared_from_this();
+        sock.async_read_some(buffer(buf), [self]( const boost::system::error_code &ec, std::size_t n ) {
+            if (!ec)
+                self->write(n);
+        });
+    }
+
+    void write( std::size_t n )
+    {
+        auto self = shared_from_this();
+        async_write(sock, buffer(buf, n), [self]( const boost::system::error_code &ec, std::size_t ) {
+            if (!ec)
+                self->read();
+        });
+    }
+
+    socket_type     sock;
+    char            buf[MSG_SIZE];
+};
+
+static void callback_accept( io_service &io, ip::tcp::acceptor &acceptor, int left )
+{
+    if (!left)
+        return;
+    auto session = std::make_shared<CallbackSession>(io);
+    acceptor.async_accept(session->sock, [&io, &acceptor, session, left]( const boost::system::error_code &ec ) {
+        if (ec)
+            return;
+        session->sock.set_option(ip::tcp::no_delay(true));
+        session->read();
+        callback_accept(io, acceptor, left - 1);
+    });
+}
+
+static void callback_server( io_service &io, ip::tcp::acceptor &acceptor, int conns )
+{
+    callback_accept(io, acceptor, conns);
+    io.run();
+}
+
+static void thread_server( io_service &io, ip::tcp::acceptor &acceptor, int conns )
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < conns; ++i) {
+        std::shared_ptr<socket_type> sock(new socket_type(io));
+        acceptor.accept(*sock);
+        sock->set_option(ip::tcp::no_delay(true));
+        threads.emplace_back([sock]{
+            char buf[MSG_SIZE];
+            boost::system::error_code ec;
+            while (true) {
+                std::size_t n = sock->read_some(buffer(buf), ec);
+                if (ec || (write(*sock, buffer(buf, n), ec), ec))
+                    break;
+            } // while
+        });
+    } // for
+    for (auto &t : threads)
+        t.join();
+}
+
+class EchoClient {
+public:
+    EchoClient( io_service &io, const std::atomic<bool> &stop ) : sock(io), stop(stop), count(0) {}
+
+    void start()
+    {
+        async_write(sock, buffer(buf), [this]( const boost::system::error_code &ec, std::size_t ) {
+            if (ec)
+                return;
+            async_read(sock, buffer(buf), [this]( const boost::system::error_code &ec, std::size_t ) {
+                if (ec)
+                    return;
+                ++count;
+                if (stop.load(std::memory_order_relaxed))
+                    sock.close();
+                else
+                    start();
+            });
+        });
+    }
+
+    socket_type                 sock;
+    const std::atomic<bool>     &stop;
+    long long                   count;
+    char                        buf[MSG_SIZE];
+};
+
+template < typename Server >
+static void bench_echo( const char *name, Server server, int conns, double seconds )
+{
+    io_service serverIo, clientIo;
+    ip::tcp::acceptor acceptor(serverIo, ip::tcp::endpoint(ip::address_v4::loopback(), 0), true);
+    ip::tcp::endpoint ep = acceptor.local_endpoint();
+    std::thread serverThread([&]{ server(serverIo, acceptor, conns); });
+
+    std::atomic<bool> stop(false);
+    std::vector<std::unique_ptr<EchoClient> > clients;
+    for (int i = 0; i < conns; ++i) {
+        clients.emplace_back(new EchoClient(clientIo, stop));
+        clients.back()->sock.connect(ep);
+        clients.back()->sock.set_option(ip::tcp::no_delay(true));
+    } // for
+
+    auto t0 = Clock::now();
+    for (auto &c : clients)
+        c->start();
+    std::thread clientThread([&]{ clientIo.run(); });
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    clientThread.join();
+    double secs = elapsed(t0);
+    serverThread.join();
+
+    long long total = 0;
+    for (auto &c : clients)
+        total += c->count;
+    printf("  %-20s %4d conns: %8.1f k round trips/s\n", name, conns, total / secs / 1e3);
+}
+
+int main( int argc, char **argv )
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    int maxConns = argc > 2 ? atoi(argv[2]) : 256;
+
+    printf("switch cost\n");
+    bench_fiber_switch();
+    bench_coro_post();
+    bench_thread_switch();
+
+    printf("spawn + finish\n");
+    bench_spawn("coroutine, pooled stacks", 1024);
+    bench_spawn("coroutine, mmap per stack", 0);
+
+    printf("echo, %d bytes\n", MSG_SIZE);
+    for (int n = 1; n <= maxConns; n *= 4) {
+        bench_echo("coroutine", coro_server, n, seconds);
+        bench_echo("callback", callback_server, n, seconds);
+        bench_echo("thread per conn", thread_server, n, seconds);
+    } // for
+
+    return 0;
+}
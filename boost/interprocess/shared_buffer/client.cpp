@@ -11,17 +11,19 @@
 using namespace boost::interprocess;
 
 static
-void do_routine( SharedBuffer *pSharedBuf )
+void do_routine( SharedMsgQueue *pQueue )
 {
     char buf[64];
-    BytesArray& writeBuf = pSharedBuf->writeBuf();
+    uint32_t ticket;
 
     for( int i = 0; i < 10; ++i ) {
         sprintf( buf, "test %d\n", i );
         DBG_STREAM(buf);
-        writeBuf.clear();
-        writeBuf.append( buf, strlen(buf) );
-        pSharedBuf->push();
+        // 在环上预留空间直接写入，commit后server可见
+        std::size_t len = strlen(buf);
+        char *dst = pQueue->prepare( len, ticket );
+        memcpy( dst, buf, len );
+        pQueue->commit( ticket );
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }
@@ -29,21 +31,21 @@ void do_routine( SharedBuffer *pSharedBuf )
 int main()
 {
     try {
-        SharedBuffer*                                                   pSharedBuf;
+        SharedMsgQueue*                                                 pQueue;
         std::unique_ptr<boost::interprocess::managed_shared_memory>     segment;
 
         segment.reset( new managed_shared_memory(open_only,"Encoder_Server_SharedBuffer") );
-        std::pair<SharedBuffer*, std::size_t> ret = segment->find<SharedBuffer>("SharedBuffer");
-        pSharedBuf = ret.first;
-        if( !pSharedBuf )
-            throw std::runtime_error("Cannot find object SharedBuffer in shared memory");
+        std::pair<SharedMsgQueue*, std::size_t> ret = segment->find<SharedMsgQueue>("SharedMsgQueue");
+        pQueue = ret.first;
+        if( !pQueue )
+            throw std::runtime_error("Cannot find object SharedMsgQueue in shared memory");
 
 		std::pair<int*, std::size_t> ret1 = segment->find<int>("IntTest");
 		int *p = ret1.first;
 		if ( p )
 			DBG_STREAM(*p);
 
-        do_routine(pSharedBuf);
+        do_routine(pQueue);
 
     } catch ( const std::exception &ex ) {
         std::cerr << "Exception caught: " << ex.what() << std::endl;
@@ -37,15 +37,15 @@ using namespace boost::interprocess;
  */
 
 static
-void do_routine( SharedBuffer *pSharedBuf )
+void do_routine( SharedMsgQueue *pQueue )
 {
-    const char *p = NULL;
-    const BytesArray &buf = pSharedBuf->readBuf();
+    SharedMsgQueue::Message msg;
 
     while( true ) {
-        pSharedBuf->pop();
-        p = buf.ptr();
-        std::cout.write( p, buf.size() );
+        // 数据直接在共享内存的环上读，用完release
+        pQueue->pop( msg );
+        std::cout.write( msg.data, msg.len );
+        pQueue->release( msg );
     }
 
     return;
@@ -69,15 +69,16 @@ int main()
         // std::cout << sizeof(void_alloc) << std::endl; // 8
 
         // construct the shared buffer obj in shared memory
-        SharedBufferPtr pSharedBuf(segment.construct<SharedBuffer>("SharedBuffer")(void_alloc, SHARED_BUFSIZE, INIT_FRAME_SIZE), 
-                std::bind(&managed_shared_memory::destroy_ptr<SharedBuffer>, &segment, std::placeholders::_1));
+        // 描述符和数据环在这里一次分配好，之后收发不再经过segment manager
+        std::shared_ptr<SharedMsgQueue> pQueue(segment.construct<SharedMsgQueue>("SharedMsgQueue")(void_alloc, MSG_QUEUE_SLOTS, MSG_QUEUE_BYTES), 
+                std::bind(&managed_shared_memory::destroy_ptr<SharedMsgQueue>, &segment, std::placeholders::_1));
 
 		int *p = segment.construct<int>("IntTest")(10);
 
 		//DBG("Base addr of shared mem is %lx", (long)(segment.get_address()));
 		//DBG("Addr of pSharedBuf is %lx", (long)(pSharedBuf.get()));
 
-        do_routine( pSharedBuf.get() );
+        do_routine( pQueue.get() );
 
     } catch ( const std::exception &ex ) {
         std::cerr << "Exception caught: " << ex.what() << std::endl;
@@ -7,7 +7,11 @@
 #include <boost/interprocess/sync/interprocess_mutex.hpp> 
 #include <boost/interprocess/sync/interprocess_condition.hpp> 
 #include <boost/interprocess/sync/scoped_lock.hpp> 
+#include <boost/interprocess/offset_ptr.hpp>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
 #include <functional>
 #include <cstring>
 // #include "LOG.h"
@@ -15,6 +19,8 @@
 #define SHARED_BUFSIZE              3
 #define INIT_FRAME_SIZE             (256*1024)
 #define ENCODER_SERVER_BUFSIZE      (5*1024*1024)       // 5MB
+#define MSG_QUEUE_SLOTS             64
+#define MSG_QUEUE_BYTES             (2*1024*1024)       // 2MB
 
 typedef boost::interprocess::managed_shared_memory::segment_manager         segment_manager_t;
 typedef boost::interprocess::allocator<void, segment_manager_t>             void_allocator;
@@ -124,6 +130,216 @@ protected:
     BytesArray                                                  readBuf_, writeBuf_;
 };
 
+/*
+ * 变长消息队列，多生产者多消费者，稳态下不加任何锁，也不经过segment manager。
+ * 构造时一次性从segment里分配描述符数组和数据环，之后只用atomic推进：
+ *  - head 高32位是描述符票号，低32位是数据环写位置，一次CAS同时占下两者，
+ *    所以票号顺序就是数据在环上的顺序。
+ *  - 描述符按Vyukov的bounded MPMC队列推进：seq == t 空闲，seq == t+1 可读。
+ *  - 消费者读完后release，数据环按票号顺序回收(releasePos/dataTail)，
+ *    回收之后描述符才交还给下一圈的生产者。
+ * 消息在环上是连续的，放不下时跳过环尾。只有队列满/空时才在mtx/cond上阻塞。
+ * 票号和位置都是uint32，按模2^32比较。
+ */
+class SharedMsgQueue {
+public:
+    struct Message {
+        uint32_t        ticket;
+        const char     *data;
+        uint32_t        len;
+    };
+
+    SharedMsgQueue( const void_allocator &void_alloc, std::size_t _Slots = MSG_QUEUE_SLOTS, 
+                    std::size_t _Bytes = MSG_QUEUE_BYTES )
+            : segMgr(void_alloc.get_segment_manager())
+            , slotMask(round_pow2(_Slots) - 1), dataMask(round_pow2(_Bytes) - 1)
+            , head(0), readPos(0), releasePos(0), dataTail(0), waiters(0)
+    {
+        slots = static_cast<Slot*>(segMgr->allocate(sizeof(Slot) * (slotMask + 1)));
+        data = static_cast<char*>(segMgr->allocate(dataMask + 1));
+        for (uint32_t i = 0; i <= slotMask; ++i)
+            new (&slots[i]) Slot(i);
+    }
+
+    ~SharedMsgQueue()
+    {
+        for (uint32_t i = 0; i <= slotMask; ++i)
+            slots[i].~Slot();
+        segMgr->deallocate(slots.get());
+        segMgr->deallocate(data.get());
+    }
+
+    // 单条消息的最大长度，保证跳过环尾后也一定放得下
+    std::size_t maxMsgSize() const { return (dataMask + 1) / 2; }
+
+    // 在环上预留len字节，直接往返回的地址写，写完commit；满时返回NULL
+    char* try_prepare( std::size_t len, uint32_t &ticket )
+    {
+        const uint32_t cap = dataMask + 1;
+        const uint32_t need = align8(len);
+        if (len > maxMsgSize())
+            throw std::length_error("SharedMsgQueue message too long");
+
+        uint64_t h = head.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t t = (uint32_t)(h >> 32), pos = (uint32_t)h;
+            Slot &slot = slots[t & slotMask];
+            int32_t dif = (int32_t)(slot.seq.load(std::memory_order_acquire) - t);
+            if (dif < 0)
+                return NULL;            // 描述符用完
+            if (dif > 0) {              // 别的生产者已经占了t
+                h = head.load(std::memory_order_relaxed);
+                continue;
+            } // if
+
+            uint32_t off = pos & dataMask;
+            uint32_t skip = (cap - off < need) ? cap - off : 0;
+            uint32_t end = pos + skip + need;
+            if (end - dataTail.load(std::memory_order_acquire) > cap)
+                return NULL;            // 数据环满
+
+            if (head.compare_exchange_weak(h, ((uint64_t)(t + 1) << 32) | end,
+                        std::memory_order_relaxed, std::memory_order_relaxed)) {
+                slot.data = data + ((pos + skip) & dataMask);
+                slot.len = (uint32_t)len;
+                slot.end = end;
+                ticket = t;
+                return slot.data.get();
+            } // if
+        } // while
+    }
+
+    char* prepare( std::size_t len, uint32_t &ticket )
+    {
+        char *p = try_prepare(len, ticket);
+        if (!p)
+            wait([&]{ return (p = try_prepare(len, ticket)) != NULL; });
+        return p;
+    }
+
+    void commit( uint32_t ticket )
+    {
+        slots[ticket & slotMask].seq.store(ticket + 1, std::memory_order_release);
+        wake();
+    }
+
+    void push( const void *src, std::size_t len )
+    {
+        uint32_t ticket;
+        char *dst = prepare(len, ticket);
+        ::memcpy(dst, src, len);
+        commit(ticket);
+    }
+
+    // 取出的消息数据仍在环上，用完后必须release
+    bool try_pop( Message &msg )
+    {
+        uint32_t t = readPos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot &slot = slots[t & slotMask];
+            int32_t dif = (int32_t)(slot.seq.load(std::memory_order_acquire) - (t + 1));
+            if (dif < 0)
+                return false;
+            if (dif > 0) {
+                t = readPos.load(std::memory_order_relaxed);
+                continue;
+            } // if
+            if (readPos.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+                msg.ticket = t;
+                msg.data = slot.data.get();
+                msg.len = slot.len;
+                return true;
+            } // if
+        } // while
+    }
+
+    void pop( Message &msg )
+    {
+        if (!try_pop(msg))
+            wait([&]{ return try_pop(msg); });
+    }
+
+    void release( const Message &msg )
+    {
+        slots[msg.ticket & slotMask].done.store(1);
+
+        // 按票号顺序回收，谁碰上连续已release的就顺手推进
+        while (true) {
+            uint32_t r = releasePos.load();
+            Slot &slot = slots[r & slotMask];
+            if (slot.seq.load() != r + 1 || !slot.done.load())
+                break;
+            if (!releasePos.compare_exchange_strong(r, r + 1))
+                continue;
+            uint32_t end = slot.end;
+            slot.done.store(0, std::memory_order_relaxed);
+            // 并发回收时end可能乱序到达，只允许dataTail前进
+            uint32_t tail = dataTail.load();
+            while ((int32_t)(end - tail) > 0 && !dataTail.compare_exchange_weak(tail, end));
+            slot.seq.store(r + slotMask + 1, std::memory_order_release);
+        } // while
+        wake();
+    }
+
+private:
+    struct Slot {
+        explicit Slot( uint32_t i ) : seq(i), done(0), len(0), end(0) {}
+
+        std::atomic<uint32_t>                   seq, done;
+        uint32_t                                len, end;
+        boost::interprocess::offset_ptr<char>   data;
+    };
+
+    static uint32_t round_pow2( std::size_t n )
+    {
+        uint32_t ret = 8;
+        while (ret < n)
+            ret <<= 1;
+        return ret;
+    }
+
+    static uint32_t align8( std::size_t n )
+    { return (uint32_t)((n + 7) & ~(std::size_t)7); }
+
+    // 只在满/空时进入；waiters计数与状态变化之间的fence保证不丢唤醒
+    template<typename Pred>
+    void wait( Pred pred )
+    {
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lk(mtx);
+        waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lk, pred);
+        waiters.fetch_sub(1);
+    }
+
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed)) {
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lk(mtx);
+            cond.notify_all();
+        } // if
+    }
+
+private:
+    boost::interprocess::offset_ptr<segment_manager_t>      segMgr;
+    boost::interprocess::offset_ptr<Slot>                   slots;
+    boost::interprocess::offset_ptr<char>                   data;
+    const uint32_t                                          slotMask, dataMask;
+
+    // 生产者、消费者、回收各自推进的计数放在不同的cache line
+    char                                                    pad0[64];
+    std::atomic<uint64_t>                                   head;
+    char                                                    pad1[64];
+    std::atomic<uint32_t>                                   readPos;
+    char                                                    pad2[64];
+    std::atomic<uint32_t>                                   releasePos, dataTail;
+    char                                                    pad3[64];
+    std::atomic<uint32_t>                                   waiters;
+    boost::interprocess::interprocess_mutex                 mtx;
+    boost::interprocess::interprocess_condition             cond;
+};
+
 
 typedef std::shared_ptr<SharedBuffer>       SharedBufferPtr;
 
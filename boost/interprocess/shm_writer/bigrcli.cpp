@@ -1,6 +1,5 @@
 #include "stream_buf.h"
 #include <boost/interprocess/managed_shared_memory.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/algorithm/string.hpp>
 #include <iostream>
@@ -47,14 +46,14 @@ try {
     // cout << endl;
     // return 0;
 
-    StreamBuf *pBuf = NULL;
+    SlotChannel *pChannel = NULL;
     std::shared_ptr<managed_shared_memory>   pShmSegment;
 
     try {
         pShmSegment = std::make_shared<managed_shared_memory>(open_only, SHM_NAME);
-        auto ret = pShmSegment->find<StreamBuf>("StreamBuf");  // return pair<type*, size_t>
-        pBuf = ret.first;
-        if (!pBuf)
+        auto ret = pShmSegment->find<SlotChannel>("SlotChannel");  // return pair<type*, size_t>
+        pChannel = ret.first;
+        if (!pChannel)
             RETVAL(-1, "Cannot load shared buffer object. "
                     "Please make sure that BigRLab apiserver has benn launched with -b option");
 
@@ -73,44 +72,40 @@ try {
         cmd.erase(cmd.size()-1);
     } // if
 
-    bufferstream stream(pBuf->buf, SHARED_STREAM_BUF_SIZE);
+    if (cmd.size() > SHM_SLOT_SIZE)
+        RETVAL(-1, "Command too long, max " << SHM_SLOT_SIZE << " bytes");
 
-    auto resetStream = [&] {
-        stream.clear();
-        stream.seekg(0, std::ios::beg);
-        stream.seekp(0, std::ios::beg);
-    };
+    //!! 不能用local_time
+    auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(FLAGS_timeout);
 
-    // clear state
-    pBuf->respReady = false;
+    // 每个client独占一个槽，多个client可同时有请求在途
+    int slot = pChannel->acquire(deadline);
+    if (slot < 0)
+        RETVAL(-1, "Wait for free shared buffer slot timeout. "
+                "Please make sure that BigRLab apiserver has benn launched with -b option");
+    SlotBuf &s = pChannel->slot(slot);
 
     // send cmd
-    {
-        resetStream();
-        pBuf->clear();
-        scoped_lock<interprocess_mutex> lk(pBuf->mtx);
-        stream << cmd << endl << flush;
-        pBuf->reqReady = true;
-        lk.unlock();
-        pBuf->condReq.notify_all();
-    }
+    memcpy(s.data, cmd.data(), cmd.size());
+    s.len = (uint32_t)cmd.size();
+    pChannel->post(slot);
 
     // waiting for server response
-    {
-        resetStream();
-        //!! 不能用local_time
-        auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(FLAGS_timeout);
-        scoped_lock<interprocess_mutex> lk(pBuf->mtx);
-        if (!pBuf->condResp.timed_wait(lk, deadline, [&]{ return pBuf->respReady; }))
-            RETVAL(-1, "Wait cmd response timeout. "
-                    "Please make sure that BigRLab apiserver has benn launched with -b option");
-        getline(stream, resp, '\0');
-        pBuf->respReady = false;
-        lk.unlock();
-        boost::trim(resp);
-        if (!resp.empty())
-            cout << resp << endl;
-    }
+    if (!pChannel->waitResponse(slot, deadline))
+        RETVAL(-1, "Wait cmd response timeout. "
+                "Please make sure that BigRLab apiserver has benn launched with -b option");
+    if (s.status == SlotBuf::TOO_LARGE) {
+        uint32_t len = s.len;
+        pChannel->release(slot);
+        RETVAL(-1, "Response of " << len << " bytes exceeds shared buffer slot size "
+                << SHM_SLOT_SIZE << ", not delivered");
+    } // if
+    resp.assign(s.data, s.len);
+    pChannel->release(slot);
+
+    boost::trim(resp);
+    if (!resp.empty())
+        cout << resp << endl;
 
     return 0;
 
@@ -0,0 +1,209 @@
+/*
+ * 单槽(StreamBuf)与多槽(SlotChannel)协议的往返延迟和吞吐对比
+ * usage: shm_bench [clients] [requests_per_client] [msg_size]
+ * server为fork出的子进程，做echo；client为本进程内的线程。
+ * 单槽协议本身不支持并发client，这里用一把额外的锁让client轮流使用。
+ */
+#include "stream_buf.h"
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
+#include <boost/algorithm/string.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define BENCH_SHM_NAME      "BigRLabShmBench"
+#define QUIT_CMD            "quit"
+
+using namespace boost::interprocess;
+using namespace std;
+
+typedef std::chrono::steady_clock   Clock;
+
+struct SingleSlot {
+    StreamBuf                   buf;
+    interprocess_mutex          clientMtx;
+};
+
+static void single_server( StreamBuf *pBuf )
+{
+    bufferstream stream(pBuf->buf, SHARED_STREAM_BUF_SIZE);
+    string line;
+    while (true) {
+        // 同 ShmWriter 原来的 readLine/writeLine
+        {
+            stream.clear();
+            stream.seekg(0, std::ios::beg);
+            scoped_lock<interprocess_mutex> lk(pBuf->mtx);
+            pBuf->condReq.wait( lk, [&]{return pBuf->reqReady;} );
+            getline(stream, line);
+            pBuf->reqReady = false;
+        }
+        {
+            pBuf->clear();
+            stream.clear();
+            stream.seekp(0, std::ios::beg);
+            scoped_lock<interprocess_mutex> lk(pBuf->mtx);
+            stream << line << endl << flush;
+            pBuf->respReady = true;
+            lk.unlock();
+            pBuf->condResp.notify_all();
+        }
+        if (line == QUIT_CMD)
+            return;
+    } // while
+}
+
+static bool single_request( SingleSlot *pSingle, const string &cmd, string &resp )
+{
+    StreamBuf *pBuf = &pSingle->buf;
+    scoped_lock<interprocess_mutex> clk(pSingle->clientMtx);
+    bufferstream stream(pBuf->buf, SHARED_STREAM_BUF_SIZE);
+    pBuf->respReady = false;
+    {
+        pBuf->clear();
+        scoped_lock<interprocess_mutex> lk(pBuf->mtx);
+        stream << cmd << endl << flush;
+        pBuf->reqReady = true;
+        lk.unlock();
+        pBuf->condReq.notify_all();
+    }
+    {
+        stream.clear();
+        stream.seekg(0, std::ios::beg);
+        scoped_lock<interprocess_mutex> lk(pBuf->mtx);
+        pBuf->condResp.wait(lk, [&]{ return pBuf->respReady; });
+        getline(stream, resp, '\0');
+        pBuf->respReady = false;
+    }
+    boost::trim(resp);
+    return true;
+}
+
+static void slot_server( SlotChannel *pChannel )
+{
+    string line;
+    while (true) {
+        int idx = pChannel->take();
+        SlotBuf &s = pChannel->slot(idx);
+        line.assign(s.data, s.len);
+        // echo，数据原样留在槽内
+        pChannel->respond(idx);
+        if (line == QUIT_CMD)
+            return;
+    } // while
+}
+
+static bool slot_request( SlotChannel *pChannel, const string &cmd, string &resp )
+{
+    auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(10);
+    int idx = pChannel->acquire(deadline);
+    if (idx < 0)
+        return false;
+    SlotBuf &s = pChannel->slot(idx);
+    memcpy(s.data, cmd.data(), cmd.size());
+    s.len = (uint32_t)cmd.size();
+    pChannel->post(idx);
+    if (!pChannel->waitResponse(idx, deadline))
+        return false;
+    resp.assign(s.data, s.len);
+    pChannel->release(idx);
+    return true;
+}
+
+template<typename Request>
+static void run( const char *name, Request request, int nClients, int nRequests, int msgSize )
+{
+    vector<vector<double>> latency(nClients);
+    vector<int> errors(nClients, 0);
+    vector<thread> clients;
+
+    auto start = Clock::now();
+    for (int c = 0; c < nClients; ++c) {
+        clients.emplace_back([&, c] {
+            string cmd, resp;
+            latency[c].reserve(nRequests);
+            for (int i = 0; i < nRequests; ++i) {
+                cmd = to_string(c) + ":" + to_string(i) + ":";
+                cmd.resize(std::max((int)cmd.size(), msgSize), 'x');
+                auto t0 = Clock::now();
+                if (!request(cmd, resp) || resp != cmd)
+                    ++errors[c];
+                latency[c].push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+            } // for i
+        });
+    } // for c
+    for (auto &t : clients)
+        t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    string resp;
+    request(QUIT_CMD, resp);
+
+    vector<double> all;
+    int nErrors = 0;
+    for (int c = 0; c < nClients; ++c) {
+        all.insert(all.end(), latency[c].begin(), latency[c].end());
+        nErrors += errors[c];
+    } // for
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[std::min(all.size() - 1, (size_t)(p * all.size()))]; };
+
+    printf("%-8s clients=%d msg=%dB: %.0f req/sec, p50 %.1f us, p99 %.1f us, max %.1f us, errors %d\n",
+            name, nClients, msgSize, all.size() / seconds, pct(0.5), pct(0.99), all.back(), nErrors);
+}
+
+int main( int argc, char **argv )
+try {
+    int nClients  = argc > 1 ? atoi(argv[1]) : 4;
+    int nRequests = argc > 2 ? atoi(argv[2]) : 20000;
+    int msgSize   = argc > 3 ? atoi(argv[3]) : 64;
+    if (nClients <= 0 || nRequests <= 0 || msgSize < 0 || msgSize > SHM_SLOT_SIZE) {
+        cerr << "usage: " << argv[0] << " [clients] [requests_per_client] [msg_size <= " << SHM_SLOT_SIZE << "]" << endl;
+        return -1;
+    } // if
+
+    struct shm_remove {
+        shm_remove() { shared_memory_object::remove(BENCH_SHM_NAME); }
+        ~shm_remove(){ shared_memory_object::remove(BENCH_SHM_NAME); }
+    } remover;
+
+    managed_shared_memory segment(create_only, BENCH_SHM_NAME, SHARED_BUF_SIZE + 2 * sizeof(SingleSlot));
+    SingleSlot  *pSingle  = segment.construct<SingleSlot>("SingleSlot")();
+    SlotChannel *pChannel = segment.construct<SlotChannel>("SlotChannel")();
+
+    // 映射是MAP_SHARED的，fork后子进程直接使用同一地址
+    auto bench = [&](const char *name, std::function<void()> server, std::function<bool(const string&, string&)> request) {
+        pid_t pid = fork();
+        if (pid < 0)
+            throw runtime_error("fork failed");
+        if (pid == 0) {
+            server();
+            _exit(0);
+        } // if
+        run(name, request, nClients, nRequests, msgSize);
+        waitpid(pid, NULL, 0);
+    };
+
+    bench("single", [&]{ single_server(&pSingle->buf); },
+            [&](const string &cmd, string &resp){ return single_request(pSingle, cmd, resp); });
+    bench("slots", [&]{ slot_server(pChannel); },
+            [&](const string &cmd, string &resp){ return slot_request(pChannel, cmd, resp); });
+
+    segment.destroy_ptr(pChannel);
+    segment.destroy_ptr(pSingle);
+
+    return 0;
+
+} catch (const std::exception &ex) {
+    cerr << "Exception caught by main: " << ex.what() << endl;
+    exit(-1);
+}
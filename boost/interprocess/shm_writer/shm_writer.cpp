@@ -13,40 +13,49 @@ void ShmWriter::init_shm()
 {
     pShmRemover.reset( new shm_remover );
     pShmSegment = boost::make_shared<managed_shared_memory>(create_only, SHM_NAME, SHARED_BUF_SIZE);
-    pStreamBuf.reset(pShmSegment->construct<StreamBuf>("StreamBuf")(),
-            [&](StreamBuf *p){ if (p) pShmSegment->destroy_ptr(p); });
-    pStream = boost::make_shared<bufferstream>(pStreamBuf->buf, SHARED_STREAM_BUF_SIZE);
+    pChannel.reset(pShmSegment->construct<SlotChannel>("SlotChannel")(),
+            [&](SlotChannel *p){ if (p) pShmSegment->destroy_ptr(p); });
 }
 
-void ShmWriter::resetStream()
+int ShmWriter::readRequest(string &line)
 {
-    pStream->clear();
-    pStream->seekg(0, std::ios::beg);
-    pStream->seekp(0, std::ios::beg);
+    int slot = pChannel->take();
+    SlotBuf &s = pChannel->slot(slot);
+    line.assign(s.data, s.len);
+    DLOG(INFO) << "Received cmd from shared buffer slot " << slot << ": " << line;
+    return slot;
+}
+
+bool ShmWriter::writeResponse(int slot, const string &msg)
+{
+    SlotBuf &s = pChannel->slot(slot);
+    // 放不下就告诉client，不截断
+    if (msg.size() > SHM_SLOT_SIZE) {
+        LOG(ERROR) << "Response of " << msg.size() << " bytes exceeds shared buffer slot size " << SHM_SLOT_SIZE;
+        s.status = SlotBuf::TOO_LARGE;
+        s.len = (uint32_t)std::min(msg.size(), (size_t)UINT32_MAX);
+        pChannel->respond(slot);
+        return false;
+    } // if
+    memcpy(s.data, msg.data(), msg.size());
+    s.status = SlotBuf::OK;
+    s.len = (uint32_t)msg.size();
+    return pChannel->respond(slot);
 }
 
 bool ShmWriter::readLine(string &line)
 {
-    bool ret = false;
-    resetStream();
-    scoped_lock<interprocess_mutex> lk(pStreamBuf->mtx);
-    // read msg from client
-    pStreamBuf->condReq.wait( lk, [&]{return pStreamBuf->reqReady;} );
-    ret = getline(*pStream, line);
-    pStreamBuf->reqReady = false;
-    DLOG(INFO) << "Received cmd from shared buffer: " << line;
-    return ret;
+    curSlot = readRequest(line);
+    return true;
 }
 
 void ShmWriter::writeLine(const string &msg)
 {
-    pStreamBuf->clear();
-    resetStream();
-    scoped_lock<interprocess_mutex> lk(pStreamBuf->mtx);
-    *pStream << msg << endl << flush;
-    pStreamBuf->respReady = true;
-    lk.unlock();
-    pStreamBuf->condResp.notify_all();
+    if (curSlot < 0)
+        return;
+    if (!writeResponse(curSlot, msg))
+        DLOG(INFO) << "Response to slot " << curSlot << " not delivered";
+    curSlot = -1;
 }
 
 } // namespace BigRLab
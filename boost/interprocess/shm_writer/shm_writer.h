@@ -4,9 +4,7 @@
 #include "common_utils.h"
 #include "stream_buf.h"
 #include <string>
-#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
 
 namespace BigRLab {
 
@@ -17,21 +15,24 @@ class ShmWriter : public Writer {
     };
 
 public:
-    ShmWriter()
+    ShmWriter() : curSlot(-1)
     { init_shm();}
 
     virtual bool readLine( std::string &line );
     virtual void writeLine( const std::string &msg );
 
+    // 多个请求可同时在途，多线程server可直接用槽号应答
+    int readRequest( std::string &line );
+    bool writeResponse( int slot, const std::string &msg );
+
 private:
     void init_shm();
-    void resetStream();
 
 private:
     boost::shared_ptr<shm_remover>                                pShmRemover;
     boost::shared_ptr<boost::interprocess::managed_shared_memory> pShmSegment;
-    boost::shared_ptr<StreamBuf>                                  pStreamBuf;
-    boost::shared_ptr<boost::interprocess::bufferstream>          pStream;
+    boost::shared_ptr<SlotChannel>                                pChannel;
+    int                                                           curSlot;   // readLine/writeLine 当前处理的槽
 };
 
 } // namespace BigRLab
@@ -2,14 +2,27 @@
 #define _STREAM_BUF_H_
 
 #include <cstring>
-#include <boost/interprocess/sync/interprocess_mutex.hpp> 
-#include <boost/interprocess/sync/interprocess_condition.hpp> 
-#include <boost/interprocess/sync/scoped_lock.hpp> 
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <sys/types.h>
+#include <signal.h>
+#include <unistd.h>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
-#define SHARED_BUF_SIZE          (1024*1024)
-#define SHARED_STREAM_BUF_SIZE   (SHARED_BUF_SIZE - 1024)
 #define SHM_NAME    "BigRLabShellBuffer"
 
+// 单槽协议(StreamBuf)，保留用于对比测试
+#define SHARED_STREAM_BUF_SIZE   (1024*1024 - 1024)
+
+// 多槽协议(SlotChannel)
+#define SHM_SLOT_COUNT           16
+#define SHM_SLOT_SIZE            (256*1024)
+#define SHARED_BUF_SIZE          (SHM_SLOT_COUNT * (SHM_SLOT_SIZE + 1024) + 65536)
+
 
 // 不是stdin那样阻塞，应该看做是文件stream
 // 同步是必须的
@@ -26,4 +39,147 @@ struct StreamBuf {
     boost::interprocess::interprocess_condition  condReq, condResp;
 };
 
+
+/*
+ * 一个槽就是一次请求/响应的全部空间，数据为 len + data 的二进制格式，
+ * 不再用bufferstream解析，也不需要每次memset整个缓冲区。
+ * 状态流转:
+ *  client: FREE -> CLAIMED -> REQUEST            server: REQUEST -> PROCESSING -> RESPONSE
+ *  client: RESPONSE -> FREE, 超时则 -> ABANDONED, 由server回收为FREE
+ * client进程崩溃时槽不会有人释放：槽记下owner的pid，acquire/take/respond时发现owner已不存在就回收。
+ * 响应超过SHM_SLOT_SIZE时不截断，server置 status = TOO_LARGE, len 为实际长度，由client报错。
+ * 拥有槽的一方在锁外读写数据，状态切换都在channel的锁内完成。
+ */
+struct SlotBuf {
+    enum State : uint32_t { FREE, CLAIMED, REQUEST, PROCESSING, RESPONSE, ABANDONED };
+
+    enum Status : uint32_t { OK, TOO_LARGE };
+
+    SlotBuf() : state(FREE), status(OK), len(0), owner(0) {}
+
+    uint32_t  state;
+    uint32_t  status;     // 响应是否有效
+    uint32_t  len;        // TOO_LARGE 时为响应的实际长度，data中无内容
+    pid_t     owner;      // 占用该槽的client进程
+    boost::interprocess::interprocess_condition  condResp;   // 只唤醒本槽的client
+    char      data[SHM_SLOT_SIZE];
+};
+
+struct SlotChannel {
+    typedef boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex>   Lock;
+    typedef boost::posix_time::ptime                                                     Deadline;
+
+    // 没有新的释放通知时，acquire 每隔这么久检查一次崩溃client占用的槽
+    static boost::posix_time::time_duration reapInterval()
+    { return boost::posix_time::seconds(1); }
+
+    static bool alive( pid_t pid )
+    { return ::kill(pid, 0) == 0 || errno == EPERM; }
+
+    SlotChannel() : reqHead(0), reqCount(0) {}
+
+    SlotBuf& slot( int idx ) { return slots[idx]; }
+
+    // client: 取得一个空闲槽，超时返回 -1
+    int acquire( const Deadline &deadline )
+    {
+        Lock lk(mtx);
+        int idx = -1;
+        auto found = [&]()->bool {
+            for (int i = 0; i < SHM_SLOT_COUNT; ++i)
+                if (slots[i].state == SlotBuf::FREE) { idx = i; return true; }
+            // 由client持有的槽，owner已退出则直接接管
+            for (int i = 0; i < SHM_SLOT_COUNT; ++i)
+                if ((slots[i].state == SlotBuf::CLAIMED || slots[i].state == SlotBuf::RESPONSE)
+                        && !alive(slots[i].owner))
+                { idx = i; return true; }
+            return false;
+        };
+        while (!found()) {
+            Deadline now = boost::posix_time::microsec_clock::universal_time();
+            if (now >= deadline)
+                return -1;
+            condFree.timed_wait(lk, std::min(deadline, now + reapInterval()));
+        } // while
+        slots[idx].state = SlotBuf::CLAIMED;
+        slots[idx].status = SlotBuf::OK;
+        slots[idx].owner = ::getpid();
+        return idx;
+    }
+
+    // client: 数据已写入槽内，提交给server
+    void post( int idx )
+    {
+        Lock lk(mtx);
+        slots[idx].state = SlotBuf::REQUEST;
+        reqQueue[(reqHead + reqCount) % SHM_SLOT_COUNT] = idx;
+        ++reqCount;
+        lk.unlock();
+        condReq.notify_one();
+    }
+
+    // client: 等待本槽的响应，超时则放弃该槽交由server回收
+    bool waitResponse( int idx, const Deadline &deadline )
+    {
+        SlotBuf &s = slots[idx];
+        Lock lk(mtx);
+        if (s.condResp.timed_wait(lk, deadline, [&]{ return s.state == SlotBuf::RESPONSE; }))
+            return true;
+        s.state = SlotBuf::ABANDONED;
+        return false;
+    }
+
+    // client: 响应已读走
+    void release( int idx )
+    {
+        Lock lk(mtx);
+        slots[idx].state = SlotBuf::FREE;
+        lk.unlock();
+        condFree.notify_one();
+    }
+
+    // server: 阻塞直到有请求，返回槽号
+    int take()
+    {
+        Lock lk(mtx);
+        while (true) {
+            condReq.wait(lk, [&]{ return reqCount > 0; });
+            int idx = reqQueue[reqHead];
+            reqHead = (reqHead + 1) % SHM_SLOT_COUNT;
+            --reqCount;
+            SlotBuf &s = slots[idx];
+            if (s.state == SlotBuf::REQUEST && alive(s.owner)) {
+                s.state = SlotBuf::PROCESSING;
+                return idx;
+            } // if
+            // 排队期间client已超时或退出
+            s.state = SlotBuf::FREE;
+            condFree.notify_one();
+        } // while
+    }
+
+    // server: 响应已写入槽内，返回false表示client已放弃
+    bool respond( int idx )
+    {
+        SlotBuf &s = slots[idx];
+        Lock lk(mtx);
+        if (s.state == SlotBuf::ABANDONED || !alive(s.owner)) {
+            s.state = SlotBuf::FREE;
+            lk.unlock();
+            condFree.notify_one();
+            return false;
+        } // if
+        s.state = SlotBuf::RESPONSE;
+        lk.unlock();
+        s.condResp.notify_one();
+        return true;
+    }
+
+    SlotBuf   slots[SHM_SLOT_COUNT];
+    int       reqQueue[SHM_SLOT_COUNT];     // 按提交顺序处理
+    int       reqHead, reqCount;
+    boost::interprocess::interprocess_mutex      mtx;
+    boost::interprocess::interprocess_condition  condReq, condFree;
+};
+
 #endif
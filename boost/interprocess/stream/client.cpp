@@ -7,6 +7,10 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
 
 #define SLEEP_MILLISECONDS(x) std::this_thread::sleep_for(std::chrono::milliseconds(x))
 #define TIMEOUT         5000
@@ -14,8 +18,47 @@
 using namespace boost::interprocess;
 using namespace std;
 
-int main()
+static void usage(const char *prog)
+{
+    cerr << "usage: " << prog << " [-s spin_us] [-n requests] [-l load_threads]" << endl
+         << "  -s  spin spin_us microseconds before blocking, when server runs with -s" << endl
+         << "  -n  send requests back to back and report round trip latency" << endl
+         << "  -l  keep load_threads busy threads running during the benchmark" << endl;
+}
+
+static void print_stats(const char *name, const SeqEvent &ev)
+{
+    uint64_t ready = ev.ready, spun = ev.spun, blocked = ev.blocked;
+    uint64_t total = ready + spun + blocked;
+    if (!total)
+        total = 1;
+    printf("%s waits: ready %llu (%.1f%%), spun %llu (%.1f%%), blocked %llu (%.1f%%)\n", name,
+            (unsigned long long)ready, 100.0 * ready / total,
+            (unsigned long long)spun, 100.0 * spun / total,
+            (unsigned long long)blocked, 100.0 * blocked / total);
+}
+
+int main(int argc, char **argv)
 try {
+    int spinUs = 0, nRequests = 0, nLoad = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:l:")) != -1) {
+        switch (opt) {
+        case 's':
+            spinUs = atoi(optarg);
+            break;
+        case 'n':
+            nRequests = atoi(optarg);
+            break;
+        case 'l':
+            nLoad = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        } // switch
+    } // while
+
     managed_shared_memory segment( open_only, "MySharedMemory" );
 
     auto ret = segment.find<StreamBuf>("StreamBuf");  // return pair<type*, size_t>
@@ -27,14 +70,34 @@ try {
 
     uint32_t count = 0;
     string strResp;
-    while (true) {
-        SLEEP_MILLISECONDS(100);
 
+    // 一次请求/响应，bench模式下只读第一行
+    auto roundTrip = [&](bool printAll)->bool {
         // Clear errors and rewind
         // 每次从头开始写，否则缓存很快用光
         stream.clear();
         stream.seekp(0, std::ios::beg);
 
+        if (pBuf->seqMode) {
+            // 上一次响应之后server不再碰buf，可直接写
+            uint32_t lastResp = pBuf->respEvent.seq.load();
+            stream << "Client send msg " << ++count << endl << flush;
+            pBuf->reqEvent.post();
+            if (!pBuf->respEvent.timed_wait(lastResp, spinUs, TIMEOUT)) {
+                cerr << "Wait server response timeout!" << endl;
+                return false;
+            } // if timeout
+            stream.clear();
+            stream.seekg(0, std::ios::beg);
+            if (printAll) {
+                while (getline(stream, strResp))
+                    cout << strResp << endl;
+            } else {
+                getline(stream, strResp);
+            } // if
+            return true;
+        } // if
+
         // send msg to server
         scoped_lock<interprocess_mutex> lk(pBuf->mtx);
         stream << "Client send msg " << ++count << endl << flush;
@@ -49,14 +112,58 @@ try {
         auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(TIMEOUT);
         if (!pBuf->condResp.timed_wait(lk, deadline, [&]{ return pBuf->respReady; })) {
             cerr << "Wait server response timeout!" << endl;
-            return 0;
+            return false;
         } // if timeout
         // pBuf->condResp.wait(lk, [&]{ return pBuf->respReady; });
-        while (getline(stream, strResp))
-            cout << strResp << endl;
+        if (printAll) {
+            while (getline(stream, strResp))
+                cout << strResp << endl;
+        } else {
+            getline(stream, strResp);
+        } // if
         pBuf->respReady = false;
         lk.unlock();
-    } // while
+        return true;
+    };
+
+    if (nRequests <= 0) {
+        while (true) {
+            SLEEP_MILLISECONDS(100);
+            if (!roundTrip(true))
+                return 0;
+        } // while
+    } // if
+
+    // benchmark
+    std::atomic<bool> stop(false);
+    vector<thread> load;
+    for (int i = 0; i < nLoad; ++i)
+        load.emplace_back([&]{ while (!stop.load(std::memory_order_relaxed)); });
+
+    vector<double> latency;
+    latency.reserve(nRequests);
+    for (int i = 0; i < nRequests; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!roundTrip(false))
+            break;
+        latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    } // for
+
+    stop = true;
+    for (auto &t : load)
+        t.join();
+
+    if (latency.empty())
+        return 0;
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&](double p) { return latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))]; };
+    printf("%s mode, spin %d us, load %d: %lu round trips, p50 %.2f us, p99 %.2f us, max %.2f us\n",
+            pBuf->seqMode ? "seq" : "condition", spinUs, nLoad, latency.size(),
+            pct(0.5), pct(0.99), latency.back());
+    if (pBuf->seqMode) {
+        print_stats("client", pBuf->respEvent);
+        print_stats("server", pBuf->reqEvent);
+    } // if
 
     return 0;
 
@@ -6,6 +6,7 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <unistd.h>
 
 #define SLEEP_MILLISECONDS(x) std::this_thread::sleep_for(std::chrono::milliseconds(x))
 
@@ -24,9 +25,34 @@ uint32_t get_number(const string &s)
     return ret;
 }
 
+static void usage(const char *prog)
+{
+    cerr << "usage: " << prog << " [-s spin_us] [-q]" << endl
+         << "  -s  use sequence counters, spin spin_us microseconds before blocking (0 = block at once)" << endl
+         << "  -q  do not print every request" << endl;
+}
 
-int main()
+
+int main(int argc, char **argv)
 try {
+    bool seqMode = false, quiet = false;
+    int  spinUs = 0;
+    int  opt;
+    while ((opt = getopt(argc, argv, "s:q")) != -1) {
+        switch (opt) {
+        case 's':
+            seqMode = true;
+            spinUs = atoi(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        } // switch
+    } // while
+
     struct shm_remove {
         shm_remove() { shared_memory_object::remove("MySharedMemory"); }
         ~shm_remove(){ shared_memory_object::remove("MySharedMemory"); }
@@ -36,31 +62,50 @@ try {
             "MySharedMemory",
             SHARED_BUF_SIZE);
 
-    std::shared_ptr<StreamBuf> pBuf(segment.construct<StreamBuf>("StreamBuf")(),
+    std::shared_ptr<StreamBuf> pBuf(segment.construct<StreamBuf>("StreamBuf")(seqMode),
             [&](StreamBuf *p){ if (p) segment.destroy_ptr(p); });
-    
+
     // StreamBuf *pBuf = segment.construct<StreamBuf>("StreamBuf")(这里填构造参数);
 
     // 非正常退出，ctrl-c exit() sh_remover析构是不会被执行的，智能指针也一样。
     // exit(0);
-    
+
     bufferstream stream(pBuf->buf, STREAM_BUF_SIZE);
 
     string line;
+    uint32_t lastReq = 0;
     while (true) {
         // Clear errors and rewind
         // 每次从头开始写，否则缓存很快用光
         stream.clear();
         stream.seekg(0, std::ios::beg);
 
+        if (seqMode) {
+            // client写完请求后才递增reqEvent.seq，此时独占buf，不需要加锁
+            lastReq = pBuf->reqEvent.wait(lastReq, spinUs);
+            if (!getline(stream, line))
+                line.clear();
+            if (!quiet)
+                cout << "Server reads line: " << line << endl;
+
+            stream.clear();
+            stream.seekp(0, std::ios::beg);
+            stream << "Server response msg " << get_number(line) << endl << flush;
+            stream << "Server new line" << endl << flush;
+            pBuf->respEvent.post();
+            continue;
+        } // if
+
         scoped_lock<interprocess_mutex> lk(pBuf->mtx);
 
         // read msg from client
         pBuf->condReq.wait( lk, [&]{return pBuf->reqReady;} );
-        if (getline(stream, line))
-            cout << "Server reads line: " << line << endl;
-        else
+        if (getline(stream, line)) {
+            if (!quiet)
+                cout << "Server reads line: " << line << endl;
+        } else {
             cout << "Server reads line fail!" << endl;
+        } // if
         pBuf->reqReady = false;
 
         // response client
@@ -2,25 +2,132 @@
 #define _STREAM_BUF_H_
 
 #include <cstring>
-#include <boost/interprocess/sync/interprocess_mutex.hpp> 
-#include <boost/interprocess/sync/interprocess_condition.hpp> 
-#include <boost/interprocess/sync/scoped_lock.hpp> 
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #define STREAM_BUF_SIZE    4096
 
+inline void cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/*
+ * 序号事件：通知方递增seq，等待方先自旋spinUs微秒观察seq变化，
+ * 超时才加锁在condition上睡眠。waiters与seq都是seq_cst，
+ * 通知方要么被等待方看到新seq，要么看到waiters>0而去notify，不会丢失唤醒。
+ * 统计由等待方更新：ready 进入时已就绪，spun 自旋期间就绪，blocked 走了condition。
+ */
+struct SeqEvent {
+    SeqEvent() : seq(0), waiters(0), ready(0), spun(0), blocked(0) {}
+
+    void post()
+    {
+        seq.fetch_add(1);
+        if (waiters.load()) {
+            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lk(mtx);
+            cond.notify_all();
+        } // if
+    }
+
+    // 等待seq不等于last，返回新seq
+    uint32_t wait( uint32_t last, int spinUs )
+    {
+        uint32_t cur;
+        if (poll(last, spinUs, cur))
+            return cur;
+
+        blocked.fetch_add(1, std::memory_order_relaxed);
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lk(mtx);
+        waiters.fetch_add(1);
+        cond.wait(lk, [&]{ return (cur = seq.load()) != last; });
+        waiters.fetch_sub(1);
+        return cur;
+    }
+
+    // 同wait，但最多阻塞timeoutMs毫秒，超时返回false；deadline只在真要阻塞时才计算
+    bool timed_wait( uint32_t last, int spinUs, int timeoutMs )
+    {
+        uint32_t cur;
+        if (poll(last, spinUs, cur))
+            return true;
+
+        blocked.fetch_add(1, std::memory_order_relaxed);
+        //!! 不能用local_time
+        auto deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeoutMs);
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lk(mtx);
+        waiters.fetch_add(1);
+        bool ok = cond.timed_wait(lk, deadline, [&]{ return (cur = seq.load()) != last; });
+        waiters.fetch_sub(1);
+        return ok;
+    }
+
+private:
+    // 不阻塞的部分：已就绪或自旋期间就绪返回true，cur为新seq
+    bool poll( uint32_t last, int spinUs, uint32_t &cur )
+    {
+        cur = seq.load(std::memory_order_acquire);
+        if (cur != last) {
+            ready.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        } // if
+
+        // 单CPU时对方必须抢到CPU才能通知，自旋只会白白占满时间片
+        static const bool smp = std::thread::hardware_concurrency() > 1;
+        if (spinUs > 0 && smp) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spinUs);
+            do {
+                // 每64次pause才看一次时钟
+                for (int i = 0; i < 64; ++i) {
+                    cpu_relax();
+                    cur = seq.load(std::memory_order_acquire);
+                    if (cur != last) {
+                        spun.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    } // if
+                } // for
+            } while (std::chrono::steady_clock::now() < deadline);
+        } // if
+        return false;
+    }
+
+public:
+    std::atomic<uint32_t>   seq, waiters;
+    std::atomic<uint64_t>   ready, spun, blocked;
+    boost::interprocess::interprocess_mutex      mtx;
+    boost::interprocess::interprocess_condition  cond;
+};
+
 // 不是stdin那样阻塞，应该看做是文件stream
 // 同步是必须的
+// seqMode由server设定：false 用reqReady/respReady + condReq/condResp，
+// true 用reqEvent/respEvent，可先自旋再阻塞
 struct StreamBuf {
-    StreamBuf() : reqReady(false), respReady(false)
+    StreamBuf( bool _SeqMode = false ) : reqReady(false), respReady(false), seqMode(_SeqMode)
     { memset(buf, 0, sizeof(buf)); }
 
     char buf[STREAM_BUF_SIZE];
     bool reqReady, respReady;
     boost::interprocess::interprocess_mutex      mtx;
     boost::interprocess::interprocess_condition  condReq, condResp;
+
+    bool         seqMode;
+    SeqEvent     reqEvent, respEvent;
 };
 
 
 
 #endif
-
@@ -0,0 +1,386 @@
+/*
+ * Asynchronous, batched file backend for Boost.Log
+ *
+ * Used with sinks::unlocked_sink: every logging thread formats its records
+ * itself and appends the text to a ring buffer of its own, so the caller
+ * never takes a lock. A writer thread collects whatever the rings hold and
+ * writes it with one writev() per batch. Records of one thread keep their
+ * order; records of different threads are interleaved per batch.
+ *
+ * Rotation works like text_file_backend with
+ *   keywords::file_name = "sample_%N.log",
+ *   keywords::rotation_size = 10 * 1024 * 1024,
+ *   keywords::time_based_rotation = sinks::file::rotation_at_time_point(0, 0, 0)
+ * File names may hold %N or %<width>N for the file counter plus any strftime
+ * placeholder. Files are only switched at record boundaries.
+ */
+#ifndef _ASYNC_FILE_BACKEND_HPP_
+#define _ASYNC_FILE_BACKEND_HPP_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <boost/function.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/log/core/record_view.hpp>
+#include <boost/log/expressions/formatter.hpp>
+#include <boost/log/utility/formatting_ostream.hpp>
+#include <boost/log/sinks/basic_sink_backend.hpp>
+
+class async_file_backend :
+    public boost::log::sinks::basic_sink_backend<
+        boost::log::sinks::combine_requirements<
+            boost::log::sinks::concurrent_feeding,
+            boost::log::sinks::flushing
+        >::type
+    >
+{
+public:
+    typedef boost::function0<bool>      time_based_rotation_predicate;
+
+    explicit async_file_backend( const std::string &file_name_pattern,
+                                 std::size_t rotation_size = 0,
+                                 const time_based_rotation_predicate &time_based_rotation = time_based_rotation_predicate(),
+                                 std::size_t thread_buffer_size = 1024 * 1024,
+                                 std::chrono::microseconds flush_interval = std::chrono::milliseconds(1) )
+        : m_pattern(file_name_pattern)
+        , m_rotation_size(rotation_size)
+        , m_time_based_rotation(time_based_rotation)
+        , m_buffer_size(round_pow2(thread_buffer_size))
+        , m_flush_interval(flush_interval)
+        , m_fd(-1), m_file_counter(0), m_file_size(0)
+        , m_id(next_id())
+        , m_thread_buffer(&async_file_backend::thread_exit)
+        , m_running(true)
+        , m_passes(0)
+        , m_blocked(0)
+    {
+        open_file();
+        m_writer = std::thread(&async_file_backend::writer, this);
+    }
+
+    ~async_file_backend()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_writer_mutex);
+            m_running = false;
+        }
+        m_writer_cond.notify_one();
+        m_writer.join();
+        if (m_fd != -1)
+            ::close(m_fd);
+        // Threads still alive free their buffer on exit.
+        for (std::size_t i = 0; i < m_buffers.size(); ++i)
+            if (m_buffers[i]->closed.exchange(true))
+                delete m_buffers[i];
+    }
+
+    // Must be set before logging starts; the default writes the message only.
+    void set_formatter( const boost::log::formatter &fmt )
+    { m_formatter = fmt; }
+
+    // Called concurrently on the logging threads.
+    void consume( const boost::log::record_view &rec )
+    {
+        // thread_specific_ptr is keyed by its address: a thread that logged to
+        // a destroyed backend may still hold that one's buffer here when a new
+        // backend lives at the same address.
+        thread_buffer *buf = m_thread_buffer.get();
+        if (!buf || buf->owner != m_id)
+            buf = register_thread();
+
+        buf->text.clear();
+        m_formatter(rec, buf->stream);
+        buf->stream.flush();
+        buf->text.push_back('\n');
+        push(*buf, buf->text.data(), buf->text.size());
+    }
+
+    // Returns once everything logged before the call is written.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lk(m_writer_mutex);
+        // The pass running now may have looked at a buffer already; the one
+        // after it starts after this call.
+        unsigned long target = m_passes + 2;
+        m_writer_cond.notify_one();
+        m_flushed_cond.wait(lk, [&]{ return m_passes >= target || !m_running; });
+    }
+
+    // Times a logging thread found its buffer full and had to wait for the writer.
+    unsigned long blocked_count() const { return m_blocked.load(std::memory_order_relaxed); }
+
+private:
+    // Single producer (the logging thread), single consumer (the writer).
+    struct thread_buffer
+    {
+        thread_buffer( std::size_t size, unsigned long id )
+            : owner(id), data(size), stream(text), head(0), tail(0), closed(false) {}
+
+        const unsigned long                     owner;      // id of the backend that drains it
+        std::vector<char>                       data;
+        std::string                             text;       // formatting area of the owning thread
+        boost::log::formatting_ostream          stream;
+        char                                    pad0[64];
+        std::atomic<std::size_t>                head;       // written by the logging thread
+        char                                    pad1[64];
+        std::atomic<std::size_t>                tail;       // written by the writer thread
+        std::atomic<bool>                       closed;     // set by whichever of thread and backend goes first
+    };
+
+    static std::size_t round_pow2( std::size_t n )
+    {
+        std::size_t ret = 4096;
+        while (ret < n)
+            ret <<= 1;
+        return ret;
+    }
+
+    static unsigned long next_id()
+    {
+        static std::atomic<unsigned long> id(0);
+        return ++id;
+    }
+
+    static void thread_exit( thread_buffer *buf )
+    {
+        // The writer drains and frees it, unless the backend is gone already.
+        if (buf->closed.exchange(true))
+            delete buf;
+    }
+
+    thread_buffer* register_thread()
+    {
+        thread_buffer *buf = new thread_buffer(m_buffer_size, m_id);
+        {
+            std::lock_guard<std::mutex> lk(m_buffers_mutex);
+            m_buffers.push_back(buf);
+        }
+        // A stale buffer is passed to thread_exit(); its backend has closed it.
+        m_thread_buffer.reset(buf);
+        return buf;
+    }
+
+    void push( thread_buffer &buf, const char *p, std::size_t len )
+    {
+        const std::size_t mask = m_buffer_size - 1;
+        std::size_t head = buf.head.load(std::memory_order_relaxed);
+        while (len) {
+            std::size_t used = head - buf.tail.load(std::memory_order_acquire);
+            std::size_t room = m_buffer_size - used;
+            if (!room) {
+                // The writer has fallen behind; records are never dropped.
+                m_blocked.fetch_add(1, std::memory_order_relaxed);
+                m_writer_cond.notify_one();
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            std::size_t n = std::min(len, room);
+            std::size_t off = head & mask;
+            std::size_t first = std::min(n, m_buffer_size - off);
+            std::memcpy(&buf.data[off], p, first);
+            std::memcpy(&buf.data[0], p + first, n - first);
+            head += n;
+            p += n;
+            len -= n;
+            buf.head.store(head, std::memory_order_release);
+            // Wake the writer early once half of the buffer is in use.
+            if (used < m_buffer_size / 2 && used + n >= m_buffer_size / 2)
+                m_writer_cond.notify_one();
+        }
+    }
+
+    std::string compose_file_name()
+    {
+        std::string pattern;
+        for (std::size_t i = 0; i < m_pattern.size(); ++i) {
+            if (m_pattern[i] == '%') {
+                std::size_t j = i + 1;
+                int width = 0;
+                while (j < m_pattern.size() && m_pattern[j] >= '0' && m_pattern[j] <= '9')
+                    width = width * 10 + (m_pattern[j++] - '0');
+                if (j < m_pattern.size() && m_pattern[j] == 'N') {
+                    char num[32];
+                    std::snprintf(num, sizeof(num), "%0*u", width, m_file_counter);
+                    pattern += num;
+                    i = j;
+                    continue;
+                }
+            }
+            pattern += m_pattern[i];
+        }
+
+        std::time_t now = std::time(NULL);
+        std::tm tm;
+        localtime_r(&now, &tm);
+        char name[PATH_MAX];
+        if (!std::strftime(name, sizeof(name), pattern.c_str(), &tm))
+            return pattern;
+        return name;
+    }
+
+    void open_file()
+    {
+        std::string name = compose_file_name();
+        int fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+            throw std::runtime_error("async_file_backend: cannot open " + name + ": " + std::strerror(errno));
+        if (m_fd != -1)
+            ::close(m_fd);
+        m_fd = fd;
+        m_file_size = 0;
+        ++m_file_counter;
+    }
+
+    void write_all( struct iovec *iov, int cnt )
+    {
+        while (cnt) {
+            ssize_t n = ::writev(m_fd, iov, cnt);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;     // nowhere to report it; the records are lost
+            }
+            m_file_size += n;
+            while (cnt && (std::size_t)n >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --cnt;
+            }
+            if (cnt) {
+                iov->iov_base = (char*)iov->iov_base + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+
+    // One pass over all thread buffers; returns the number of bytes written.
+    std::size_t drain()
+    {
+        std::vector<thread_buffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lk(m_buffers_mutex);
+            buffers = m_buffers;
+        }
+
+        const std::size_t mask = m_buffer_size - 1;
+        std::size_t total = 0;
+        bool at_boundary = true;
+        std::size_t i = 0;
+        while (i < buffers.size()) {
+            // At most two slices per buffer, so IOV_MAX / 2 buffers per writev;
+            // empty buffers count too, their heads are stored all the same.
+            struct iovec iov[IOV_MAX];
+            std::size_t heads[IOV_MAX / 2];
+            std::size_t first = i;
+            int cnt = 0;
+            for (; i < buffers.size() && i - first < IOV_MAX / 2; ++i) {
+                thread_buffer &buf = *buffers[i];
+                std::size_t tail = buf.tail.load(std::memory_order_relaxed);
+                std::size_t head = buf.head.load(std::memory_order_acquire);
+                heads[i - first] = head;
+                if (head == tail)
+                    continue;
+                std::size_t off = tail & mask;
+                std::size_t len = head - tail;
+                std::size_t part = std::min(len, m_buffer_size - off);
+                iov[cnt].iov_base = &buf.data[off];
+                iov[cnt++].iov_len = part;
+                if (part < len) {
+                    iov[cnt].iov_base = &buf.data[0];
+                    iov[cnt++].iov_len = len - part;
+                }
+                // A record longer than the free space is pushed in pieces.
+                at_boundary = at_boundary && buf.data[(head - 1) & mask] == '\n';
+                total += len;
+            }
+            if (cnt)
+                write_all(iov, cnt);
+            for (std::size_t k = first; k < i; ++k)
+                buffers[k]->tail.store(heads[k - first], std::memory_order_release);
+        }
+
+        if (total && at_boundary &&
+                ((m_rotation_size && m_file_size >= m_rotation_size) ||
+                 (!m_time_based_rotation.empty() && m_time_based_rotation())))
+            open_file();
+
+        // Buffers of exited threads go away once empty.
+        {
+            std::lock_guard<std::mutex> lk(m_buffers_mutex);
+            for (std::size_t k = 0; k < m_buffers.size();) {
+                thread_buffer *buf = m_buffers[k];
+                if (buf->closed.load(std::memory_order_acquire) &&
+                        buf->head.load(std::memory_order_acquire) == buf->tail.load(std::memory_order_relaxed)) {
+                    m_buffers[k] = m_buffers.back();
+                    m_buffers.pop_back();
+                    delete buf;
+                } else {
+                    ++k;
+                }
+            }
+        }
+        return total;
+    }
+
+    void writer()
+    {
+        std::unique_lock<std::mutex> lk(m_writer_mutex);
+        while (true) {
+            bool running = m_running;
+            lk.unlock();
+            std::size_t n = drain();
+            lk.lock();
+            ++m_passes;
+            m_flushed_cond.notify_all();
+            if (!running && !n)
+                break;
+            // Sleeping between passes is what makes the batches; a buffer
+            // reaching half full cuts the wait short.
+            if (running)
+                m_writer_cond.wait_for(lk, m_flush_interval);
+        }
+    }
+
+private:
+    const std::string                               m_pattern;
+    const std::size_t                               m_rotation_size;
+    time_based_rotation_predicate                   m_time_based_rotation;
+    const std::size_t                               m_buffer_size;
+    const std::chrono::microseconds                 m_flush_interval;
+    boost::log::formatter                           m_formatter;
+
+    // writer thread only
+    int                                             m_fd;
+    unsigned                                        m_file_counter;
+    std::size_t                                     m_file_size;
+
+    const unsigned long                             m_id;
+    boost::thread_specific_ptr<thread_buffer>       m_thread_buffer;
+    std::mutex                                      m_buffers_mutex;    // registration only
+    std::vector<thread_buffer*>                     m_buffers;
+
+    std::mutex                                      m_writer_mutex;
+    std::condition_variable                         m_writer_cond;
+    std::condition_variable                         m_flushed_cond;
+    bool                                            m_running;
+    unsigned long                                   m_passes;
+    std::thread                                     m_writer;
+    std::atomic<unsigned long>                      m_blocked;
+};
+
+#endif
@@ -0,0 +1,147 @@
+// compile: c++ -o /tmp/async_sink_bench async_sink_bench.cpp -DBOOST_LOG_DYN_LINK -std=c++11 -O2 -pthread -lboost_log -lboost_log_setup -lboost_thread -lboost_filesystem -lboost_system
+// usage: async_sink_bench [records [max_threads]]
+/*
+ * Logging throughput and caller-side latency of the synchronous file sink
+ * from sink_demo_指定log文件.cpp against async_file_backend, both with the
+ * same file name pattern, rotation size, midnight rotation and format.
+ * Throughput counts until the last record is on its way to the file
+ * (sink->flush()), latency is the time spent inside BOOST_LOG_SEV.
+ */
+#include "async_file_backend.hpp"
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/unlocked_frontend.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/log/utility/setup/file.hpp>
+#include <boost/log/utility/setup/formatter_parser.hpp>
+#include <boost/log/utility/setup/common_attributes.hpp>
+#include <boost/log/sources/severity_logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/smart_ptr/make_shared_object.hpp>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace logging = boost::log;
+namespace src = boost::log::sources;
+namespace sinks = boost::log::sinks;
+namespace keywords = boost::log::keywords;
+
+#define LOG_DIR     "async_sink_bench_logs"
+// more thread buffers than one writev() of drain() can take (IOV_MAX / 2)
+#define MANY_THREADS    600
+
+//[ same settings as example_tutorial_file_advanced
+boost::shared_ptr< sinks::sink > init_sync()
+{
+    return logging::add_file_log
+    (
+        keywords::file_name = LOG_DIR "/sample_%N.log",
+        keywords::rotation_size = 10 * 1024 * 1024,
+        keywords::time_based_rotation = sinks::file::rotation_at_time_point(0, 0, 0),
+        keywords::format = "[%TimeStamp%]: %Message%"
+    );
+}
+//]
+
+boost::shared_ptr< sinks::sink > init_async()
+{
+    typedef sinks::unlocked_sink< async_file_backend > async_sink;
+    boost::shared_ptr< async_file_backend > backend = boost::make_shared< async_file_backend >(
+        LOG_DIR "/sample_%N.log",
+        10 * 1024 * 1024,
+        sinks::file::rotation_at_time_point(0, 0, 0));
+    backend->set_formatter(logging::parse_formatter("[%TimeStamp%]: %Message%"));
+
+    boost::shared_ptr< async_sink > sink = boost::make_shared< async_sink >(backend);
+    logging::core::get()->add_sink(sink);
+    return sink;
+}
+
+static void run(bool async, int nThreads, int nRecords)
+{
+    boost::filesystem::remove_all(LOG_DIR);
+    boost::filesystem::create_directory(LOG_DIR);
+
+    boost::shared_ptr< sinks::sink > sink = async ? init_async() : init_sync();
+
+    int perThread = nRecords / nThreads;
+    std::vector< std::vector<double> > latency(nThreads);
+    std::vector<std::thread> threads;
+    std::atomic<int> started(0);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < nThreads; ++i) {
+        threads.emplace_back([&, i]{
+            using namespace logging::trivial;
+            src::severity_logger< severity_level > lg;
+            std::vector<double> &lat = latency[i];
+            lat.reserve(perThread);
+            for (int j = 0; j < perThread; ++j) {
+                auto t = std::chrono::steady_clock::now();
+                BOOST_LOG_SEV(lg, info) << "thread " << i << " record " << j << " of the benchmark";
+                lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+                // after the first record every thread has its buffer; let them all register
+                // before going on, so MANY_THREADS buffers really are drained together
+                if (j == 0 && ++started < nThreads)
+                    while (started.load() < nThreads)
+                        std::this_thread::yield();
+            } // for
+        });
+    } // for
+    for (auto &t : threads)
+        t.join();
+    sink->flush();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    logging::core::get()->remove_sink(sink);
+    unsigned long blocked = 0;
+    if (async)
+        blocked = boost::static_pointer_cast< sinks::unlocked_sink< async_file_backend > >(sink)->locked_backend()->blocked_count();
+    sink.reset();
+
+    std::vector<double> all;
+    for (auto &v : latency)
+        all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[std::min(all.size() - 1, (size_t)(p * all.size()))]; };
+
+    int files = 0;
+    boost::uintmax_t bytes = 0;
+    for (boost::filesystem::directory_iterator it(LOG_DIR), end; it != end; ++it) {
+        ++files;
+        bytes += boost::filesystem::file_size(it->path());
+    } // for
+
+    printf("%-5s %2d threads: %9.0f records/sec, caller p50 %6.2f us, p99 %7.2f us, max %8.1f us, %d files %llu bytes",
+            async ? "async" : "sync", nThreads, all.size() / secs, pct(0.5), pct(0.99), all.back(),
+            files, (unsigned long long)bytes);
+    if (async)
+        printf(", blocked %lu", blocked);
+    printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int nRecords = argc > 1 ? atoi(argv[1]) : 1000000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 32;
+
+    logging::add_common_attributes();
+
+    for (int n = 1; n <= maxThreads; n *= 2) {
+        run(false, n, nRecords);
+        run(true, n, nRecords);
+    } // for
+    run(false, MANY_THREADS, nRecords);
+    run(true, MANY_THREADS, nRecords);
+
+    boost::filesystem::remove_all(LOG_DIR);
+    return 0;
+}
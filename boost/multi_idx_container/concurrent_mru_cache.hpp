@@ -0,0 +1,265 @@
+/* Sharded concurrent MRU cache built on the mru_list layout of
+ * mru_queue.cpp: a multi_index_container with a sequenced index for
+ * recency and a hashed index for lookup.
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#ifndef CONCURRENT_MRU_CACHE_HPP
+#define CONCURRENT_MRU_CACHE_HPP
+
+#include <boost/config.hpp> /* keep it first to prevent nasty warns in MSVC */
+#include <boost/functional/hash.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Bytes charged for an entry: the node itself plus what the key and value
+ * own on the heap. Specialize or pass another functor for other types.
+ */
+
+template<typename T>
+struct mru_cache_heap_size
+{
+  std::size_t operator()(const T&)const{return 0;}
+};
+
+template<typename Char,typename Traits,typename Alloc>
+struct mru_cache_heap_size<std::basic_string<Char,Traits,Alloc> >
+{
+  std::size_t operator()(const std::basic_string<Char,Traits,Alloc>& s)const
+  {
+    return s.capacity()*sizeof(Char);
+  }
+};
+
+template<typename Key,typename Value>
+struct mru_cache_default_charge
+{
+  std::size_t operator()(const Key& k,const Value& v)const
+  {
+    /* two index links plus a hash bucket slot per node, roughly */
+    return sizeof(Key)+sizeof(Value)+6*sizeof(void*)+
+           mru_cache_heap_size<Key>()(k)+mru_cache_heap_size<Value>()(v);
+  }
+};
+
+struct mru_cache_stats
+{
+  mru_cache_stats():hits(0),misses(0),inserts(0),updates(0),evictions(0),
+                    items(0),bytes(0){}
+
+  std::uint64_t hits,misses,inserts,updates,evictions;
+  std::size_t   items,bytes;
+};
+
+/* Recency is approximated CLOCK-style: the sequenced index is the clock
+ * ring, a hit only sets the entry's reference bit, and eviction sweeps a
+ * hand over the ring giving referenced entries a second chance. Hits
+ * therefore never relink nodes, which keeps the shard lock hold time to a
+ * hash lookup and a copy of the value.
+ *
+ * Keys are spread over a power-of-two number of shards, each with its own
+ * lock and an equal part of the byte capacity. Value is copied out by
+ * get(); use a shared_ptr for anything expensive to copy.
+ */
+
+template<
+  typename Key,typename Value,
+  typename Hash=boost::hash<Key>,
+  typename Charge=mru_cache_default_charge<Key,Value>
+>
+class concurrent_mru_cache
+{
+  struct entry
+  {
+    entry(const Key& k,const Value& v,std::size_t c):
+      key(k),value(v),charge(c),referenced(false){}
+
+    /* only the key is indexed; the rest changes under the shard lock */
+    Key                 key;
+    mutable Value       value;
+    mutable std::size_t charge;
+    mutable bool        referenced;
+  };
+
+  typedef boost::multi_index::multi_index_container<
+    entry,
+    boost::multi_index::indexed_by<
+      boost::multi_index::sequenced<>,
+      boost::multi_index::hashed_unique<
+        boost::multi_index::member<entry,Key,&entry::key>,Hash>
+    >
+  > item_list;
+
+  typedef typename item_list::iterator                 iterator;
+  typedef typename item_list::template nth_index<1>::type key_index;
+
+  struct BOOST_ALIGNMENT(64) shard
+  {
+    shard():hand(il.end()),bytes(0){}
+
+    mutable boost::mutex mtx;
+    item_list      il;
+    iterator       hand;     /* next eviction candidate */
+    std::size_t    capacity,bytes;
+    mru_cache_stats st;
+  };
+
+public:
+  typedef Key   key_type;
+  typedef Value mapped_type;
+
+  concurrent_mru_cache(
+    std::size_t capacity_bytes,std::size_t num_shards=16,
+    const Hash& h=Hash(),const Charge& c=Charge()):
+    hash(h),charge(c),shards(round_pow2(num_shards)),
+    shard_mask(shards.size()-1)
+  {
+    for(std::size_t i=0;i<shards.size();++i){
+      shards[i].capacity=capacity_bytes/shards.size();
+    }
+  }
+
+  /* Copies the cached value into v and marks the entry as recently used. */
+
+  bool get(const Key& k,Value& v)
+  {
+    shard& s=shard_of(k);
+    boost::lock_guard<boost::mutex> lk(s.mtx);
+    const key_index& ki=s.il.template get<1>();
+    typename key_index::const_iterator it=ki.find(k);
+    if(it==ki.end()){
+      ++s.st.misses;
+      return false;
+    }
+    it->referenced=true;
+    v=it->value;
+    ++s.st.hits;
+    return true;
+  }
+
+  /* Inserts or replaces; evicts from the shard until it fits. An entry
+   * larger than a whole shard is not cached.
+   */
+
+  void put(const Key& k,const Value& v)
+  {
+    std::size_t c=charge(k,v);
+    shard& s=shard_of(k);
+    boost::lock_guard<boost::mutex> lk(s.mtx);
+    key_index& ki=s.il.template get<1>();
+    typename key_index::iterator it=ki.find(k);
+    if(it!=ki.end()){
+      s.bytes=s.bytes-it->charge+c;
+      it->value=v;
+      it->charge=c;
+      it->referenced=true;
+      ++s.st.updates;
+    }
+    else{
+      if(c>s.capacity)return;
+
+      /* just behind the hand: the last entry the sweep reaches */
+      s.il.insert(s.hand,entry(k,v,c));
+      s.bytes+=c;
+      ++s.st.inserts;
+    }
+    evict(s);
+  }
+
+  bool erase(const Key& k)
+  {
+    shard& s=shard_of(k);
+    boost::lock_guard<boost::mutex> lk(s.mtx);
+    key_index& ki=s.il.template get<1>();
+    typename key_index::iterator it=ki.find(k);
+    if(it==ki.end())return false;
+    iterator pos=s.il.template project<0>(it);
+    if(pos==s.hand)++s.hand;
+    s.bytes-=pos->charge;
+    s.il.erase(pos);
+    return true;
+  }
+
+  void clear()
+  {
+    for(std::size_t i=0;i<shards.size();++i){
+      shard& s=shards[i];
+      boost::lock_guard<boost::mutex> lk(s.mtx);
+      s.il.clear();
+      s.hand=s.il.end();
+      s.bytes=0;
+    }
+  }
+
+  /* Sums the per-shard counters; each shard is read under its lock, the
+   * total is not a single snapshot.
+   */
+
+  mru_cache_stats stats()const
+  {
+    mru_cache_stats ret;
+    for(std::size_t i=0;i<shards.size();++i){
+      const shard& s=shards[i];
+      boost::lock_guard<boost::mutex> lk(s.mtx);
+      ret.hits+=s.st.hits;
+      ret.misses+=s.st.misses;
+      ret.inserts+=s.st.inserts;
+      ret.updates+=s.st.updates;
+      ret.evictions+=s.st.evictions;
+      ret.items+=s.il.size();
+      ret.bytes+=s.bytes;
+    }
+    return ret;
+  }
+
+  std::size_t num_shards()const{return shards.size();}
+
+private:
+  static std::size_t round_pow2(std::size_t n)
+  {
+    std::size_t ret=1;
+    while(ret<n)ret<<=1;
+    return ret;
+  }
+
+  shard& shard_of(const Key& k)
+  {
+    /* hashed_unique uses the low bits of the same hash; take high ones */
+    std::uint64_t h=static_cast<std::uint64_t>(hash(k))*0x9E3779B97F4A7C15ull;
+    return shards[(h>>40)&shard_mask];
+  }
+
+  void evict(shard& s)
+  {
+    while(s.bytes>s.capacity&&!s.il.empty()){
+      if(s.hand==s.il.end())s.hand=s.il.begin();
+      if(s.hand->referenced){
+        s.hand->referenced=false;
+        ++s.hand;
+      }
+      else{
+        s.bytes-=s.hand->charge;
+        s.hand=s.il.erase(s.hand);
+        ++s.st.evictions;
+      }
+    }
+  }
+
+  Hash               hash;
+  Charge             charge;
+  std::vector<shard> shards;
+  std::size_t        shard_mask;
+};
+
+#endif
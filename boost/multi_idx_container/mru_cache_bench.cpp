@@ -0,0 +1,207 @@
+/* Read-through benchmark of concurrent_mru_cache under Zipfian keys.
+ *
+ * Every thread looks keys up and inserts the value on a miss. The baseline
+ * is the mru_list of mru_queue.cpp turned into a byte-bounded key/value
+ * cache behind a single mutex, relocating the node to the front on every
+ * hit (exact LRU).
+ *
+ * c++ -o mru_cache_bench mru_cache_bench.cpp -std=c++11 -O2 -DNDEBUG -pthread -lboost_thread -lboost_system
+ * usage: mru_cache_bench [ops [keys [capacity_mb [max_threads]]]]
+ */
+
+#include "concurrent_mru_cache.hpp"
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace boost::multi_index;
+
+/* YCSB's Zipfian generator (Gray et al., "Quickly generating billion-record
+ * synthetic databases"); rank 0 is the hottest item.
+ */
+
+class zipfian
+{
+public:
+  zipfian(std::uint64_t n_,double theta_):n(n_),theta(theta_)
+  {
+    double zeta2=1.0+std::pow(0.5,theta);
+    zetan=0;
+    for(std::uint64_t i=1;i<=n;++i)zetan+=1.0/std::pow((double)i,theta);
+    alpha=1.0/(1.0-theta);
+    eta=(1.0-std::pow(2.0/n,1.0-theta))/(1.0-zeta2/zetan);
+    half_pow_theta=std::pow(0.5,theta);
+  }
+
+  template<typename Rng>
+  std::uint64_t operator()(Rng& rng)const
+  {
+    double u=std::uniform_real_distribution<double>(0.0,1.0)(rng);
+    double uz=u*zetan;
+    if(uz<1.0)return 0;
+    if(uz<1.0+half_pow_theta)return 1;
+    return std::min<std::uint64_t>(n-1,(std::uint64_t)(n*std::pow(eta*u-eta+1.0,alpha)));
+  }
+
+private:
+  std::uint64_t n;
+  double        theta,zetan,alpha,eta,half_pow_theta;
+};
+
+/* scatter ranks so hot keys do not sit next to each other */
+inline std::uint64_t scramble(std::uint64_t x)
+{
+  x^=x>>33;x*=0xff51afd7ed558ccdull;
+  x^=x>>33;x*=0xc4ceb9fe1a85ec53ull;
+  x^=x>>33;
+  return x;
+}
+
+inline std::string make_value(std::uint64_t key)
+{
+  return std::string(64+key%193,'a'+key%26);
+}
+
+/* exact LRU: mru_list with values and a byte bound, one lock */
+
+class locked_lru
+{
+  struct entry
+  {
+    entry(std::uint64_t k,const std::string& v):key(k),value(v){}
+    std::uint64_t       key;
+    mutable std::string value;
+  };
+
+  typedef multi_index_container<
+    entry,
+    indexed_by<
+      sequenced<>,
+      hashed_unique<member<entry,std::uint64_t,&entry::key> >
+    >
+  > item_list;
+
+public:
+  explicit locked_lru(std::size_t capacity_):capacity(capacity_),bytes(0),hits(0),misses(0),evictions(0){}
+
+  bool get(std::uint64_t k,std::string& v)
+  {
+    boost::lock_guard<boost::mutex> lk(mtx);
+    item_list::nth_index<1>::type& ki=il.get<1>();
+    item_list::nth_index<1>::type::iterator it=ki.find(k);
+    if(it==ki.end()){
+      ++misses;
+      return false;
+    }
+    il.relocate(il.begin(),il.project<0>(it));       /* put in front */
+    v=it->value;
+    ++hits;
+    return true;
+  }
+
+  void put(std::uint64_t k,const std::string& v)
+  {
+    mru_cache_default_charge<std::uint64_t,std::string> charge;
+    boost::lock_guard<boost::mutex> lk(mtx);
+    std::pair<item_list::iterator,bool> p=il.push_front(entry(k,v));
+    if(!p.second)return;
+    bytes+=charge(k,p.first->value);
+    while(bytes>capacity){
+      bytes-=charge(il.back().key,il.back().value);
+      il.pop_back();
+      ++evictions;
+    }
+  }
+
+  mru_cache_stats stats()const
+  {
+    mru_cache_stats ret;
+    ret.hits=hits;
+    ret.misses=misses;
+    ret.evictions=evictions;
+    ret.items=il.size();
+    ret.bytes=bytes;
+    return ret;
+  }
+
+private:
+  boost::mutex  mtx;
+  item_list     il;
+  std::size_t   capacity,bytes;
+  std::uint64_t hits,misses,evictions;
+};
+
+template<typename Cache>
+void run(const char* name,Cache& cache,const std::vector<std::vector<std::uint64_t> >& streams)
+{
+  std::vector<std::thread> threads;
+  auto t0=std::chrono::steady_clock::now();
+  for(std::size_t t=0;t<streams.size();++t){
+    threads.emplace_back([&,t]{
+      std::string v;
+      const std::vector<std::uint64_t>& keys=streams[t];
+      for(std::size_t i=0;i<keys.size();++i){
+        if(!cache.get(keys[i],v))cache.put(keys[i],make_value(keys[i]));
+      }
+    });
+  }
+  for(auto& th:threads)th.join();
+  double secs=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+  std::size_t ops=0;
+  for(auto& s:streams)ops+=s.size();
+  mru_cache_stats st=cache.stats();
+  std::printf("  %-12s %2lu threads: %6.2f Mops/s, hit ratio %5.1f%%, evictions %8llu, %7lu items %6.1f MB\n",
+    name,(unsigned long)streams.size(),ops/secs/1e6,
+    100.0*st.hits/(st.hits+st.misses),(unsigned long long)st.evictions,
+    (unsigned long)st.items,st.bytes/1048576.0);
+}
+
+int main(int argc,char* argv[])
+{
+  std::size_t ops=argc>1?std::atol(argv[1]):4000000;
+  std::uint64_t keys=argc>2?std::atol(argv[2]):1000000;
+  std::size_t capacity=(argc>3?std::atol(argv[3]):32)<<20;
+  int max_threads=argc>4?std::atoi(argv[4]):16;
+
+  const double thetas[]={0.8,0.99};
+  for(double theta:thetas){
+    zipfian zipf(keys,theta);
+    std::printf("zipfian theta %.2f, %llu keys, %lu MB, %lu ops\n",
+      theta,(unsigned long long)keys,(unsigned long)(capacity>>20),(unsigned long)ops);
+    for(int n=1;n<=max_threads;n*=2){
+      std::vector<std::vector<std::uint64_t> > streams(n);
+      for(int t=0;t<n;++t){
+        std::mt19937_64 rng(t+1);
+        streams[t].resize(ops/n);
+        for(auto& k:streams[t])k=scramble(zipf(rng));
+      }
+
+      {
+        locked_lru lru(capacity);
+        run("locked LRU",lru,streams);
+      }
+      {
+        concurrent_mru_cache<std::uint64_t,std::string> cache(capacity,1);
+        run("CLOCK x1",cache,streams);
+      }
+      {
+        concurrent_mru_cache<std::uint64_t,std::string> cache(capacity,64);
+        run("CLOCK x64",cache,streams);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * 读多写少的shared mutex，可以直接替换 boost::shared_mutex，
+ * 包括 upgrade_lockable_adapter / shared_lock / upgrade_lock / upgrade_to_unique_lock 的用法。
+ *
+ * boost::shared_mutex 每次lock_shared都要改同一个state，所有核抢一条cache line。
+ * 这里每个线程固定用一个读者槽（READER_SLOTS个，各占一条cache line）：
+ *   读者: 自己槽 +1，再看state有没有WRITER；有则 -1 退回去等写者结束
+ *   写者: 在mutex下置WRITER，再扫所有槽，等读者计数全部归零
+ * 两边都是"先写自己的、再读对方的"，都用seq_cst，不会同时漏看对方。
+ * 没有写者时，读锁只有自己槽上的一次原子加减，不碰任何共享的cache line。
+ *
+ * upgrade锁与boost语义相同：与读者共存，与写者及其他upgrade互斥，可升级为写锁。
+ * 写者等待时新读者会让路（写者优先），所以已持有读锁的线程不能再递归加读锁。
+ */
+#ifndef _READER_BIASED_SHARED_MUTEX_HPP_
+#define _READER_BIASED_SHARED_MUTEX_HPP_
+
+#include <atomic>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/chrono.hpp>
+
+#define READER_SLOTS      64
+
+class reader_biased_shared_mutex {
+public:
+    reader_biased_shared_mutex() : state(0)
+    {
+        for (int i = 0; i < READER_SLOTS; ++i)
+            slots[i].readers.store(0, std::memory_order_relaxed);
+    }
+
+    reader_biased_shared_mutex( const reader_biased_shared_mutex& ) = delete;
+    reader_biased_shared_mutex& operator=( const reader_biased_shared_mutex& ) = delete;
+
+    // 读锁
+    void lock_shared()
+    {
+        std::atomic<int> &cnt = my_slot();
+        while (true) {
+            cnt.fetch_add(1, std::memory_order_seq_cst);
+            if (!(state.load(std::memory_order_seq_cst) & WRITER))
+                return;
+            back_off(cnt);
+            boost::unique_lock<boost::mutex> lk(mtx);
+            while (state.load(std::memory_order_seq_cst) & WRITER)
+                cond.wait(lk);
+        } // while
+    }
+
+    bool try_lock_shared()
+    {
+        std::atomic<int> &cnt = my_slot();
+        cnt.fetch_add(1, std::memory_order_seq_cst);
+        if (!(state.load(std::memory_order_seq_cst) & WRITER))
+            return true;
+        back_off(cnt);
+        return false;
+    }
+
+    template < class Clock, class Duration >
+    bool try_lock_shared_until( const boost::chrono::time_point<Clock, Duration> &deadline )
+    {
+        std::atomic<int> &cnt = my_slot();
+        while (true) {
+            cnt.fetch_add(1, std::memory_order_seq_cst);
+            if (!(state.load(std::memory_order_seq_cst) & WRITER))
+                return true;
+            back_off(cnt);
+            boost::unique_lock<boost::mutex> lk(mtx);
+            while (state.load(std::memory_order_seq_cst) & WRITER)
+                if (cond.wait_until(lk, deadline) == boost::cv_status::timeout)
+                    return false;
+        } // while
+    }
+
+    template < class Rep, class Period >
+    bool try_lock_shared_for( const boost::chrono::duration<Rep, Period> &rel )
+    { return try_lock_shared_until(boost::chrono::steady_clock::now() + rel); }
+
+    void unlock_shared()
+    { back_off(my_slot()); }
+
+    // 写锁
+    void lock()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        while (state.load(std::memory_order_relaxed) & (WRITER | UPGRADER))
+            cond.wait(lk);
+        state.fetch_or(WRITER, std::memory_order_seq_cst);
+        while (has_readers())
+            cond.wait(lk);
+    }
+
+    bool try_lock()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx, boost::try_to_lock);
+        if (!lk.owns_lock() || (state.load(std::memory_order_relaxed) & (WRITER | UPGRADER)))
+            return false;
+        state.fetch_or(WRITER, std::memory_order_seq_cst);
+        if (!has_readers())
+            return true;
+        release(lk, WRITER);
+        return false;
+    }
+
+    template < class Clock, class Duration >
+    bool try_lock_until( const boost::chrono::time_point<Clock, Duration> &deadline )
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        while (state.load(std::memory_order_relaxed) & (WRITER | UPGRADER))
+            if (cond.wait_until(lk, deadline) == boost::cv_status::timeout)
+                return false;
+        state.fetch_or(WRITER, std::memory_order_seq_cst);
+        while (has_readers()) {
+            if (cond.wait_until(lk, deadline) == boost::cv_status::timeout && has_readers()) {
+                // 让被挡住的读者继续
+                release(lk, WRITER);
+                return false;
+            } // if
+        } // while
+        return true;
+    }
+
+    template < class Rep, class Period >
+    bool try_lock_for( const boost::chrono::duration<Rep, Period> &rel )
+    { return try_lock_until(boost::chrono::steady_clock::now() + rel); }
+
+    void unlock()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        release(lk, WRITER);
+    }
+
+    // upgrade锁：不进读者槽，只占UPGRADER位，读者照常进出
+    void lock_upgrade()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        while (state.load(std::memory_order_relaxed) & (WRITER | UPGRADER))
+            cond.wait(lk);
+        state.fetch_or(UPGRADER, std::memory_order_seq_cst);
+    }
+
+    bool try_lock_upgrade()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx, boost::try_to_lock);
+        if (!lk.owns_lock() || (state.load(std::memory_order_relaxed) & (WRITER | UPGRADER)))
+            return false;
+        state.fetch_or(UPGRADER, std::memory_order_seq_cst);
+        return true;
+    }
+
+    void unlock_upgrade()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        release(lk, UPGRADER);
+    }
+
+    // 持有UPGRADER时其他写者进不来，置WRITER后只需等读者退出
+    void unlock_upgrade_and_lock()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        state.fetch_or(WRITER, std::memory_order_seq_cst);
+        state.fetch_and(~UPGRADER, std::memory_order_seq_cst);
+        while (has_readers())
+            cond.wait(lk);
+    }
+
+    void unlock_and_lock_upgrade()
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        state.fetch_or(UPGRADER, std::memory_order_seq_cst);
+        release(lk, WRITER);
+    }
+
+    // 先进自己的读者槽再放锁，中间不会有写者插进来
+    void unlock_and_lock_shared()
+    {
+        my_slot().fetch_add(1, std::memory_order_seq_cst);
+        unlock();
+    }
+
+    void unlock_upgrade_and_lock_shared()
+    {
+        my_slot().fetch_add(1, std::memory_order_seq_cst);
+        unlock_upgrade();
+    }
+
+private:
+    static const unsigned WRITER = 1;
+    static const unsigned UPGRADER = 2;
+
+    struct alignas(64) Slot {
+        std::atomic<int>    readers;
+    };
+
+    // 每个线程第一次用到时分一个槽，之后固定不变，lock/unlock必然落在同一槽
+    std::atomic<int>& my_slot()
+    {
+        static std::atomic<unsigned> next(0);
+        static thread_local unsigned idx = next.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+        return slots[idx].readers;
+    }
+
+    // 读者离开（或让路）；有写者在等排空就叫醒它
+    void back_off( std::atomic<int> &cnt )
+    {
+        cnt.fetch_sub(1, std::memory_order_seq_cst);
+        if (state.load(std::memory_order_seq_cst) & WRITER) {
+            boost::lock_guard<boost::mutex> lk(mtx);
+            cond.notify_all();
+        } // if
+    }
+
+    bool has_readers() const
+    {
+        for (int i = 0; i < READER_SLOTS; ++i)
+            if (slots[i].readers.load(std::memory_order_seq_cst))
+                return true;
+        return false;
+    }
+
+    void release( boost::unique_lock<boost::mutex> &lk, unsigned bit )
+    {
+        state.fetch_and(~bit, std::memory_order_seq_cst);
+        lk.unlock();
+        cond.notify_all();
+    }
+
+private:
+    Slot                        slots[READER_SLOTS];
+    alignas(64) std::atomic<unsigned> state;
+    boost::mutex                mtx;
+    boost::condition_variable   cond;
+};
+
+
+#endif
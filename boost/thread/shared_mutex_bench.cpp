@@ -0,0 +1,114 @@
+/*
+ * c++ -o /tmp/shared_mutex_bench shared_mutex_bench.cpp -std=c++11 -O2 -pthread -lboost_thread -lboost_chrono -lboost_system
+ * usage: shared_mutex_bench [seconds_per_run [max_threads]]
+ *
+ * 读多写少的配置表，用法同 shared_upgrade_lockable_adapter.cpp：
+ * 表继承 upgrade_lockable_adapter<Mutex>，读者 shared_lock，
+ * 写者 upgrade_lock + upgrade_to_unique_lock。
+ * 比较 boost::shared_mutex 与 reader_biased_shared_mutex 读锁吞吐随线程数的变化，
+ * 分别测纯读和另有一个写者每毫秒改一次表。
+ * 写者成对修改"version"和"version_check"，读者在读锁下核对两者相等。
+ */
+#include "reader_biased_shared_mutex.hpp"
+#include <boost/thread.hpp>
+#include <boost/thread/lockable_adapter.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TABLE_SIZE      64
+
+template < typename Mutex >
+struct ConfigTable : public std::map<std::string, long>
+                   , public boost::upgrade_lockable_adapter<Mutex>
+{
+    ConfigTable()
+    {
+        for (int i = 0; i < TABLE_SIZE; ++i)
+            (*this)["key" + std::to_string(i)] = i;
+        (*this)["version"] = 0;
+        (*this)["version_check"] = 0;
+    }
+};
+
+template < typename Mutex >
+static void run( const char *name, int nThreads, double seconds, bool withWriter )
+{
+    ConfigTable<Mutex> table;
+    std::vector<std::string> keys;
+    for (int i = 0; i < TABLE_SIZE; ++i)
+        keys.push_back("key" + std::to_string(i));
+
+    std::atomic<bool> stop(false);
+    std::atomic<long long> reads(0), torn(0), writes(0);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&, t]{
+            long long n = 0, bad = 0, sum = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; ++i, ++n) {
+                    boost::shared_lock<ConfigTable<Mutex> > lock(table);
+                    sum += table.find(keys[(t + i) % TABLE_SIZE])->second;
+                    if (!(i & 15) && table.find("version")->second != table.find("version_check")->second)
+                        ++bad;
+                } // for
+            } // while
+            reads += n;
+            torn += bad;
+            if (sum == -1)
+                printf("impossible\n");
+        });
+    } // for
+
+    std::thread writer;
+    if (withWriter) {
+        writer = std::thread([&]{
+            while (!stop.load(std::memory_order_relaxed)) {
+                {
+                    boost::upgrade_lock<ConfigTable<Mutex> > lock(table);
+                    boost::upgrade_to_unique_lock<ConfigTable<Mutex> > uniqueLock(lock);
+                    ++table["version"];
+                    std::this_thread::yield();      // 让读者有机会撞上写锁
+                    ++table["version_check"];
+                }
+                ++writes;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } // while
+        });
+    } // if
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+    if (writer.joinable())
+        writer.join();
+
+    printf("  %-28s %2d readers%s: %8.2f M read locks/s", name, nThreads,
+            withWriter ? " + writer" : "         ", reads / seconds / 1e6);
+    if (withWriter)
+        printf(", %lld writes", (long long)writes);
+    printf("%s\n", torn ? "  TORN READS" : "");
+}
+
+int main( int argc, char **argv )
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 64;
+
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    for (int w = 0; w < 2; ++w) {
+        for (int n = 1; n <= maxThreads; n *= 2) {
+            run<boost::shared_mutex>("boost::shared_mutex", n, seconds, w);
+            run<reader_biased_shared_mutex>("reader_biased_shared_mutex", n, seconds, w);
+        } // for
+    } // for
+
+    return 0;
+}
@@ -5,3 +5,4 @@ nvcc -gencode arch=compute_30,code=sm_30 -o test work.cpp work_impl.cpp gpu.cu -
 
 
 
+# binary DBG records, decode with ../macro/binlog_decode: add -DDBG_BINLOG -std=c++11
@@ -15,7 +15,11 @@
 #define ALLOCATOR(type) std::allocator<type>
 
 
-#ifdef _DEBUG
+#if defined(_DEBUG) && defined(DBG_BINLOG)
+#include "../macro/BINLOG.h"
+#define DBG(...) BINLOG(__VA_ARGS__)
+
+#elif defined(_DEBUG)
 #define DBG(...) do { \
             struct timeval __dbg_timeval;   \
             gettimeofday( &__dbg_timeval, NULL );   \
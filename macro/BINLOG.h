@@ -0,0 +1,350 @@
+#ifndef _BINLOG_H
+#define _BINLOG_H
+
+/*
+ * 二进制日志：热路径上不做任何格式化。
+ * BINLOG("fmt", args...) 每个调用点第一次执行时登记 (fmt, 文件, 行号, 函数, 参数类型串)，
+ * 得到一个id；之后每次只往本线程的缓冲区写 id + TSC + 原始参数，
+ * 缓冲区满或线程退出时一次write()到日志文件。
+ * 文件由 binlog_decode 离线还原成与 DBG 相同的文本。
+ *
+ * 文件格式（本机字节序）：
+ *   "BINLOG1\0" uint64 tsc_hz
+ *   记录: uint32 id, uint32 size(含头), uint64 tsc, 参数...
+ *     id == BINLOG_ID_FORMAT  登记: uint32 fmt_id, uint32 line, 然后 sig\0 file\0 func\0 fmt\0
+ *     id == BINLOG_ID_SYNC    时间同步: int64 CLOCK_REALTIME纳秒
+ *   参数按类型串: i int32, I int64, u uint32, U uint64, d double, p 指针, s uint32长度+字节
+ *
+ * 格式串必须是字面量（保存的是指针对应的内容，只登记一次）。
+ * 不调用 binlog::open() 时，第一次登记会打开 $BINLOG_FILE，缺省 binlog.out。
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#define BINLOG_MAGIC            "BINLOG1"
+#define BINLOG_ID_FORMAT        0xFFFFFFFFu
+#define BINLOG_ID_SYNC          0xFFFFFFFEu
+#define BINLOG_BUFFER_SIZE      (64 * 1024)
+
+//!! 参数只求值一次；if(0) printf 只为让编译器照常检查格式串与参数
+#define BINLOG(...) do { \
+            static binlog::Site __binlog_site(__FILE__, __LINE__, __func__); \
+            binlog::write_record(__binlog_site, __VA_ARGS__); \
+            if (0) printf(__VA_ARGS__); \
+        } while(0)
+
+#define BINLOG_COND(cond, ...) do { \
+            if(cond) BINLOG(__VA_ARGS__);  \
+        } while(0)
+
+
+namespace binlog {
+
+struct RecordHead {
+    uint32_t    id;
+    uint32_t    size;
+    uint64_t    tsc;
+};
+
+inline uint64_t tsc()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+inline int64_t realtime_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// 参数类型 -> 类型字符，存储类型
+template < typename T, typename Enable = void >
+struct ArgTraits;
+
+template < typename T >
+struct ArgTraits< T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type > {
+    static const bool wide = sizeof(T) > 4;
+    static const bool sign = std::is_enum<T>::value || std::is_signed<T>::value;
+    static const char tag = wide ? (sign ? 'I' : 'U') : (sign ? 'i' : 'u');
+    typedef typename std::conditional<wide,
+                typename std::conditional<sign, int64_t, uint64_t>::type,
+                typename std::conditional<sign, int32_t, uint32_t>::type>::type StoreType;
+    static size_t size( T ) { return sizeof(StoreType); }
+    static char* put( char *p, T v )
+    { StoreType s = (StoreType)v; memcpy(p, &s, sizeof(s)); return p + sizeof(s); }
+};
+
+template < typename T >
+struct ArgTraits< T, typename std::enable_if<std::is_floating_point<T>::value>::type > {
+    static const char tag = 'd';
+    static size_t size( T ) { return sizeof(double); }
+    static char* put( char *p, T v )
+    { double d = v; memcpy(p, &d, sizeof(d)); return p + sizeof(d); }
+};
+
+struct StringArg {
+    static const char tag = 's';
+    static size_t size( const char *s ) { return sizeof(uint32_t) + (s ? strlen(s) : 0); }
+    static char* put( char *p, const char *s )
+    {
+        uint32_t len = s ? strlen(s) : 0;
+        memcpy(p, &len, sizeof(len));
+        memcpy(p + sizeof(len), s, len);
+        return p + sizeof(len) + len;
+    }
+};
+
+//!! 没有std::string：if(0) printf 的格式检查不接受它，同DBG一样传 c_str()
+template <> struct ArgTraits< const char* > : StringArg {};
+template <> struct ArgTraits< char* > : StringArg {};
+
+template < typename T >
+struct ArgTraits< T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type > {
+    static const char tag = 'p';
+    static size_t size( const void* ) { return sizeof(uint64_t); }
+    static char* put( char *p, const void *v )
+    { uint64_t u = (uintptr_t)v; memcpy(p, &u, sizeof(u)); return p + sizeof(u); }
+};
+
+template < typename T >
+struct Arg : ArgTraits< typename std::decay<T>::type > {};
+
+template < typename... Args >
+const char* signature()
+{
+    static const char sig[] = { Arg<Args>::tag..., 0 };
+    return sig;
+}
+
+inline size_t args_size() { return 0; }
+template < typename T, typename... Args >
+inline size_t args_size( const T &v, const Args&... args )
+{ return Arg<T>::size(v) + args_size(args...); }
+
+inline char* put_args( char *p ) { return p; }
+template < typename T, typename... Args >
+inline char* put_args( char *p, const T &v, const Args&... args )
+{ return put_args(Arg<T>::put(p, v), args...); }
+
+
+// 全局：文件与格式登记表，只在登记、打开和刷缓冲时加锁
+class Writer {
+public:
+    static Writer& instance()
+    {
+        static Writer w;
+        return w;
+    }
+
+    void open( const char *path )
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        openLocked(path);
+    }
+
+    uint32_t registerFormat( const char *file, int line, const char *func, const char *fmt, const char *sig )
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        uint32_t id = formats.size();
+        std::vector<char> rec(sizeof(RecordHead) + 2 * sizeof(uint32_t));
+        RecordHead head = { BINLOG_ID_FORMAT, 0, tsc() };
+        uint32_t u[2] = { id, (uint32_t)line };
+        memcpy(&rec[sizeof(head)], u, sizeof(u));
+        const char *strs[] = { sig, file, func, fmt };
+        for (const char *s : strs)
+            rec.insert(rec.end(), s, s + strlen(s) + 1);
+        head.size = rec.size();
+        memcpy(&rec[0], &head, sizeof(head));
+        formats.push_back(rec);
+
+        if (fd < 0) {
+            const char *path = getenv("BINLOG_FILE");
+            openLocked(path ? path : "binlog.out");
+        } else {
+            writeAll(&rec[0], rec.size());
+        } // if
+        return id;
+    }
+
+    void write( const char *data, size_t len )
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        writeAll(data, len);
+    }
+
+private:
+    Writer() : fd(-1), tscHz(0) {}
+    ~Writer() { if (fd >= 0) ::close(fd); }
+
+    // 开文件时测一次TSC频率，解码时再用文件里的同步记录校正
+    void calibrate()
+    {
+        int64_t ns0 = realtime_ns();
+        uint64_t t0 = tsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        int64_t ns1 = realtime_ns();
+        uint64_t t1 = tsc();
+        tscHz = (uint64_t)((double)(t1 - t0) * 1e9 / (ns1 - ns0));
+    }
+
+    void openLocked( const char *path )
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror(path);
+            return;
+        } // if
+        if (!tscHz)
+            calibrate();
+
+        char header[8 + sizeof(uint64_t)] = BINLOG_MAGIC;
+        memcpy(header + 8, &tscHz, sizeof(tscHz));
+        writeAll(header, sizeof(header));
+        for (auto &rec : formats)
+            writeAll(&rec[0], rec.size());
+    }
+
+    void writeAll( const char *p, size_t len )
+    {
+        while (fd >= 0 && len) {
+            ssize_t n = ::write(fd, p, len);
+            if (n < 0)
+                return;
+            p += n;
+            len -= n;
+        } // while
+    }
+
+private:
+    std::mutex                      mtx;
+    int                             fd;
+    uint64_t                        tscHz;
+    std::vector< std::vector<char> > formats;
+};
+
+
+// 线程缓冲：只保存完整记录，每块以一条时间同步记录开头
+class ThreadBuffer {
+public:
+    ThreadBuffer() : data(BINLOG_BUFFER_SIZE), cur(NULL), end(NULL) { reset(); }
+    ~ThreadBuffer() { flush(); }
+
+    char* reserve( size_t len )
+    {
+        if (cur + len > end) {
+            flush();
+            if (len > data.size() - syncSize) {
+                data.resize(len + syncSize);
+                reset();
+            } // if
+        } // if
+        char *p = cur;
+        cur += len;
+        return p;
+    }
+
+    void flush()
+    {
+        if (cur - &data[0] > (ptrdiff_t)syncSize)
+            Writer::instance().write(&data[0], cur - &data[0]);
+        reset();
+    }
+
+private:
+    static const size_t syncSize = sizeof(RecordHead) + sizeof(int64_t);
+
+    void reset()
+    {
+        RecordHead head = { BINLOG_ID_SYNC, (uint32_t)syncSize, tsc() };
+        int64_t ns = realtime_ns();
+        memcpy(&data[0], &head, sizeof(head));
+        memcpy(&data[sizeof(head)], &ns, sizeof(ns));
+        cur = &data[0] + syncSize;
+        end = &data[0] + data.size();
+    }
+
+private:
+    std::vector<char>   data;
+    char                *cur, *end;
+};
+
+inline ThreadBuffer& thread_buffer()
+{
+    static thread_local ThreadBuffer buf;
+    return buf;
+}
+
+// 每个BINLOG调用点一个，常量初始化，第一次写记录时才登记格式
+struct Site {
+    static const uint32_t UNSET = BINLOG_ID_FORMAT;
+
+    constexpr Site( const char *_File, int _Line, const char *_Func )
+            : file(_File), line(_Line), func(_Func), id(UNSET) {}
+
+    uint32_t registerOnce( const char *fmt, const char *sig )
+    {
+        static std::mutex mtx;
+        std::lock_guard<std::mutex> lk(mtx);
+        uint32_t ret = id.load(std::memory_order_relaxed);
+        if (ret == UNSET) {
+            ret = Writer::instance().registerFormat(file, line, func, fmt, sig);
+            id.store(ret, std::memory_order_release);
+        } // if
+        return ret;
+    }
+
+    const char              *file;
+    int                     line;
+    const char              *func;
+    std::atomic<uint32_t>   id;
+};
+
+template < typename... Args >
+inline void write_record( Site &site, const char *fmt, const Args&... args )
+{
+    uint32_t id = site.id.load(std::memory_order_acquire);
+    if (__builtin_expect(id == Site::UNSET, 0))
+        id = site.registerOnce(fmt, signature<Args...>());
+    RecordHead head = { id, (uint32_t)(sizeof(RecordHead) + args_size(args...)), tsc() };
+    char *p = thread_buffer().reserve(head.size);
+    memcpy(p, &head, sizeof(head));
+    put_args(p + sizeof(head), args...);
+}
+
+// 指定日志文件；已登记的格式会重写到新文件
+inline void open( const char *path )
+{ Writer::instance().open(path); }
+
+// 把本线程缓冲写到文件，其他线程在缓冲满或退出时写
+inline void flush()
+{ thread_buffer().flush(); }
+
+} // namespace binlog
+
+
+#endif
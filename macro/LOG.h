@@ -8,6 +8,11 @@
 #include <sys/time.h>
 
 
+#ifdef DBG_BINLOG
+//!! 二进制模式：只记格式id、TSC和原始参数，用 binlog_decode 还原成下面的文本格式
+#include "BINLOG.h"
+#define DBG(...) BINLOG(__VA_ARGS__)
+#else
 //!! __VA_ARGS__ 只是原样展开...
 #define DBG(...) do { \
             struct timeval __dbg_timeval;   \
@@ -18,6 +23,7 @@
             fprintf( stdout, __VA_ARGS__ ); \
             fprintf( stdout, "\n" ); \
         } while(0)
+#endif
 
 //!! args可以是包含空格和其他任意符号如<<的字符串
 #define DBG_STREAM(args) do { \
@@ -0,0 +1,97 @@
+/*
+ * 每条记录的开销：文本 DBG（gettimeofday + 4次fprintf）对比 BINLOG。
+ *
+ * c++ -o binlog_bench binlog_bench.cpp -std=c++11 -O2 -pthread
+ * usage: binlog_bench [records_per_thread [max_threads]]
+ * 结果输出到stderr；生成 binlog_bench.txt 与 binlog_bench.bin，后者用 binlog_decode 查看。
+ */
+#include "LOG.h"
+#include "BINLOG.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+static double g_nsPerTick;
+
+static void calibrate()
+{
+    auto t0 = chrono::steady_clock::now();
+    uint64_t c0 = binlog::tsc();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    uint64_t c1 = binlog::tsc();
+    g_nsPerTick = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / (c1 - c0);
+}
+
+// 同一条语句两种写法
+static void log_text( int i, unsigned doc, const char *word, double score )
+{ DBG("thread %d doc %u term %s score %.4f", i, doc, word, score); }
+
+static void log_binary( int i, unsigned doc, const char *word, double score )
+{ BINLOG("thread %d doc %u term %s score %.4f", i, doc, word, score); }
+
+static void run( const char *name, void (*fn)(int, unsigned, const char*, double), int nThreads, int nRecords )
+{
+    static const char *words[] = { "alpha", "beta", "gamma", "delta" };
+    vector<thread> threads;
+    vector< vector<double> > lat(nThreads);
+
+    // 吞吐：不计时每一条
+    auto t0 = chrono::steady_clock::now();
+    for (int t = 0; t < nThreads; ++t)
+        threads.emplace_back([&, t]{
+            for (int j = 0; j < nRecords; ++j)
+                fn(t, j, words[j & 3], j * 0.5);
+        });
+    for (auto &th : threads)
+        th.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    threads.clear();
+
+    // 延迟：rdtsc计时，另跑一遍
+    for (int t = 0; t < nThreads; ++t)
+        threads.emplace_back([&, t]{
+            vector<double> &v = lat[t];
+            v.reserve(nRecords);
+            for (int j = 0; j < nRecords; ++j) {
+                uint64_t c = binlog::tsc();
+                fn(t, j, words[j & 3], j * 0.5);
+                v.push_back((binlog::tsc() - c) * g_nsPerTick);
+            } // for
+        });
+    for (auto &th : threads)
+        th.join();
+
+    vector<double> all;
+    for (auto &v : lat)
+        all.insert(all.end(), v.begin(), v.end());
+    sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[min(all.size() - 1, (size_t)(p * all.size()))]; };
+    fprintf(stderr, "%-6s %2d threads: %10.0f records/sec (%6.1f ns/record), caller p50 %7.1f ns, p99 %8.1f ns\n",
+            name, nThreads, (double)nThreads * nRecords / secs, secs * 1e9 / nThreads / nRecords, pct(0.5), pct(0.99));
+}
+
+int main( int argc, char **argv )
+{
+    int nRecords = argc > 1 ? atoi(argv[1]) : 1000000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+
+    calibrate();
+    if (!freopen("binlog_bench.txt", "w", stdout)) {
+        perror("binlog_bench.txt");
+        return -1;
+    } // if
+    binlog::open("binlog_bench.bin");
+
+    for (int n = 1; n <= maxThreads; n *= 2) {
+        run("DBG", log_text, n, nRecords);
+        run("BINLOG", log_binary, n, nRecords);
+    } // for
+    binlog::flush();
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ * 把 BINLOG.h 写的二进制日志还原成与 DBG 相同的文本：
+ * [秒,微秒] file:line in func(): message
+ *
+ * c++ -o binlog_decode binlog_decode.cpp -std=c++11 -O2
+ * usage: binlog_decode [-s] [-r] file
+ *   -s  按时间戳排序（不同线程的记录按缓冲块交错写入）
+ *   -r  时间戳输出原始TSC
+ */
+#include "BINLOG.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+using namespace std;
+
+struct Format {
+    string  sig, file, func, fmt;
+    uint32_t line;
+};
+
+struct Line {
+    uint64_t    tsc;
+    string      text;
+};
+
+// 按类型串取出的一个参数；i/u 按存储宽度(32位)给出有符号和无符号两种解释，同printf
+struct Value {
+    char        type;
+    int64_t     i;
+    uint64_t    u;
+    double      d;
+    string      s;
+};
+
+static bool read_args( const char *p, const char *end, const string &sig, vector<Value> &vals )
+{
+    vals.clear();
+    for (char t : sig) {
+        Value v;
+        v.type = t;
+        v.i = 0; v.u = 0; v.d = 0;
+        switch (t) {
+        case 'i': { int32_t x; if (p + 4 > end) return false; memcpy(&x, p, 4); p += 4; v.i = x; v.u = (uint32_t)x; v.d = x; break; }
+        case 'u': { uint32_t x; if (p + 4 > end) return false; memcpy(&x, p, 4); p += 4; v.u = x; v.i = (int32_t)x; v.d = x; break; }
+        case 'I': { int64_t x; if (p + 8 > end) return false; memcpy(&x, p, 8); p += 8; v.i = x; v.u = (uint64_t)x; v.d = x; break; }
+        case 'U':
+        case 'p': { uint64_t x; if (p + 8 > end) return false; memcpy(&x, p, 8); p += 8; v.u = x; v.i = (int64_t)x; v.d = x; break; }
+        case 'd': { double x; if (p + 8 > end) return false; memcpy(&x, p, 8); p += 8; v.d = x; v.i = (int64_t)x; v.u = (uint64_t)x; break; }
+        case 's': {
+            uint32_t len;
+            if (p + 4 > end) return false;
+            memcpy(&len, p, 4); p += 4;
+            if (p + len > end) return false;
+            v.s.assign(p, len); p += len;
+            break;
+        }
+        default:
+            return false;
+        } // switch
+        vals.push_back(v);
+    } // for
+    return true;
+}
+
+// 按printf格式串逐个转换说明符套用参数，长度修饰符按实际存储类型重写
+static string format_message( const string &fmt, const vector<Value> &vals )
+{
+    string out;
+    size_t argi = 0;
+    char buf[512];
+    auto next = [&]()->const Value* { return argi < vals.size() ? &vals[argi++] : NULL; };
+
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] != '%') {
+            out += fmt[i];
+            continue;
+        } // if
+        if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+            out += '%';
+            ++i;
+            continue;
+        } // if
+
+        string spec = "%";
+        size_t j = i + 1;
+        while (j < fmt.size() && strchr("-+ #0'", fmt[j]))
+            spec += fmt[j++];
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1) {
+                if (j >= fmt.size() || fmt[j] != '.')
+                    break;
+                spec += fmt[j++];
+            } // if
+            if (j < fmt.size() && fmt[j] == '*') {
+                const Value *v = next();
+                spec += to_string(v ? v->i : 0);
+                ++j;
+            } else {
+                while (j < fmt.size() && isdigit((unsigned char)fmt[j]))
+                    spec += fmt[j++];
+            } // if
+        } // for
+        // h/hh 还要截断，其余长度修饰符由存储类型决定
+        int shortBits = 0;
+        while (j < fmt.size() && strchr("hlLqjzt", fmt[j])) {
+            if (fmt[j] == 'h')
+                shortBits = shortBits ? 8 : 16;
+            ++j;
+        } // while
+        if (j >= fmt.size()) {
+            out += fmt.substr(i);
+            break;
+        } // if
+        char conv = fmt[j];
+        i = j;
+
+        const Value *v = next();
+        if (!v) {
+            out += "<missing>";
+            continue;
+        } // if
+        switch (conv) {
+        case 'd': case 'i': {
+            long long x = v->i;
+            if (shortBits == 16)
+                x = (short)x;
+            else if (shortBits == 8)
+                x = (signed char)x;
+            snprintf(buf, sizeof(buf), (spec + "lld").c_str(), x);
+            break;
+        }
+        case 'u': case 'o': case 'x': case 'X': {
+            unsigned long long x = v->u;
+            if (shortBits == 16)
+                x = (unsigned short)x;
+            else if (shortBits == 8)
+                x = (unsigned char)x;
+            snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), x);
+            break;
+        }
+        case 'c':
+            snprintf(buf, sizeof(buf), (spec + "c").c_str(), (int)v->i);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            snprintf(buf, sizeof(buf), (spec + conv).c_str(), v->d);
+            break;
+        case 's':
+            if (v->type == 's') {
+                // 字符串可能比buf长
+                int n = snprintf(NULL, 0, (spec + "s").c_str(), v->s.c_str());
+                vector<char> big(n + 1);
+                snprintf(&big[0], big.size(), (spec + "s").c_str(), v->s.c_str());
+                out += &big[0];
+                continue;
+            } // if
+            snprintf(buf, sizeof(buf), "<not a string>");
+            break;
+        case 'p':
+            snprintf(buf, sizeof(buf), (spec + "p").c_str(), (void*)(uintptr_t)v->u);
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+            break;
+        } // switch
+        out += buf;
+    } // for
+    return out;
+}
+
+int main( int argc, char **argv )
+{
+    bool sortByTime = false, rawTsc = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "sr")) != -1) {
+        switch (opt) {
+        case 's':
+            sortByTime = true;
+            break;
+        case 'r':
+            rawTsc = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s] [-r] file\n", argv[0]);
+            return -1;
+        } // switch
+    } // while
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-s] [-r] file\n", argv[0]);
+        return -1;
+    } // if
+
+    ifstream ifs(argv[optind], ios::binary);
+    if (!ifs) {
+        perror(argv[optind]);
+        return -1;
+    } // if
+    vector<char> data((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+    const size_t headSize = 8 + sizeof(uint64_t);
+    if (data.size() < headSize || memcmp(&data[0], BINLOG_MAGIC, 8)) {
+        fprintf(stderr, "%s: not a binlog file\n", argv[optind]);
+        return -1;
+    } // if
+    uint64_t tscHz;
+    memcpy(&tscHz, &data[8], sizeof(tscHz));
+
+    // 第一遍：收集同步点，用最早和最晚的两个换算TSC
+    const char *begin = &data[0] + headSize, *end = &data[0] + data.size();
+    uint64_t tsc0 = 0, tsc1 = 0;
+    int64_t ns0 = 0, ns1 = 0;
+    bool haveSync = false;
+    for (const char *p = begin; p + sizeof(binlog::RecordHead) <= end;) {
+        binlog::RecordHead head;
+        memcpy(&head, p, sizeof(head));
+        if (head.size < sizeof(head) || p + head.size > end)
+            break;
+        if (head.id == BINLOG_ID_SYNC && head.size >= sizeof(head) + sizeof(int64_t)) {
+            int64_t ns;
+            memcpy(&ns, p + sizeof(head), sizeof(ns));
+            if (!haveSync || head.tsc < tsc0) { tsc0 = head.tsc; ns0 = ns; }
+            if (!haveSync || head.tsc > tsc1) { tsc1 = head.tsc; ns1 = ns; }
+            haveSync = true;
+        } // if
+        p += head.size;
+    } // for
+    double nsPerTick = tscHz ? 1e9 / tscHz : 1.0;
+    // 间隔太短时频率误差大，仍用写入端的标定值
+    if (haveSync && tsc1 > tsc0 && ns1 - ns0 > 1000000000ll)
+        nsPerTick = (double)(ns1 - ns0) / (tsc1 - tsc0);
+
+    // 第二遍：解码
+    map<uint32_t, Format> formats;
+    vector<Line> lines;
+    vector<Value> vals;
+    char stamp[64];
+    const char *p = begin;
+    for (; p + sizeof(binlog::RecordHead) <= end;) {
+        binlog::RecordHead head;
+        memcpy(&head, p, sizeof(head));
+        if (head.size < sizeof(head) || p + head.size > end)
+            break;
+        const char *body = p + sizeof(head), *next = p + head.size;
+        p = next;
+
+        if (head.id == BINLOG_ID_SYNC)
+            continue;
+        if (head.id == BINLOG_ID_FORMAT) {
+            uint32_t u[2];
+            if (body + sizeof(u) > next)
+                continue;
+            memcpy(u, body, sizeof(u));
+            body += sizeof(u);
+            Format f;
+            f.line = u[1];
+            string *strs[] = { &f.sig, &f.file, &f.func, &f.fmt };
+            for (string *s : strs) {
+                const char *z = (const char*)memchr(body, 0, next - body);
+                if (!z)
+                    break;
+                s->assign(body, z);
+                body = z + 1;
+            } // for
+            formats[u[0]] = f;
+            continue;
+        } // if
+
+        Line line;
+        line.tsc = head.tsc;
+        if (rawTsc) {
+            snprintf(stamp, sizeof(stamp), "[%llu] ", (unsigned long long)head.tsc);
+        } else {
+            int64_t ns = ns0 + (int64_t)(((double)head.tsc - (double)tsc0) * nsPerTick);
+            snprintf(stamp, sizeof(stamp), "[%010llu,%06llu] ",
+                    (unsigned long long)(ns / 1000000000ll), (unsigned long long)(ns % 1000000000ll / 1000));
+        } // if
+        line.text = stamp;
+
+        auto it = formats.find(head.id);
+        if (it == formats.end()) {
+            line.text += "<unknown format id " + to_string(head.id) + ">";
+        } else {
+            const Format &f = it->second;
+            line.text += f.file + ":" + to_string(f.line) + " in " + f.func + "(): ";
+            if (read_args(body, next, f.sig, vals))
+                line.text += format_message(f.fmt, vals);
+            else
+                line.text += "<truncated record>";
+        } // if
+
+        if (sortByTime)
+            lines.push_back(line);
+        else
+            printf("%s\n", line.text.c_str());
+    } // for
+
+    if (sortByTime) {
+        stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b) { return a.tsc < b.tsc; });
+        for (auto &l : lines)
+            printf("%s\n", l.text.c_str());
+    } // if
+
+    if (p != end)
+        fprintf(stderr, "%s: %lu trailing bytes ignored\n", argv[optind], (unsigned long)(end - p));
+
+    return 0;
+}
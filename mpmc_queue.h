@@ -0,0 +1,434 @@
+#ifndef _MPMC_QUEUE_H_
+#define _MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/chrono.hpp>
+
+/*
+ * EventCount: 条件（队列非空/非满）本身由无锁结构维护，这里只负责睡眠与唤醒。
+ * 等待方: key = prepareWait(); 再检查一次条件; 成立则cancelWait()，否则wait(key)。
+ * 通知方: 先让条件成立（发布slot），再notify()。
+ * state高32位是epoch，低32位是等待者数。没有等待者时notify()只有一个fence加一次load，
+ * 不碰mutex；等待者先登记再复查条件，通知方先发布再查等待者，两边都有seq_cst fence，
+ * 不会出现双方都没看到对方的情况。
+ */
+class EventCount {
+public:
+    EventCount() : state(0) {}
+
+    uint32_t prepareWait()
+    {
+        uint64_t prev = state.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return (uint32_t)(prev >> 32);
+    }
+
+    void cancelWait()
+    { state.fetch_sub(1, std::memory_order_seq_cst); }
+
+    void wait( uint32_t key )
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        while (epoch() == key)
+            cond.wait(lk);
+        state.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // 超时返回false
+    bool wait_until( uint32_t key, const boost::chrono::steady_clock::time_point &deadline )
+    {
+        boost::unique_lock<boost::mutex> lk(mtx);
+        bool ret = cond.wait_until(lk, deadline, [&]{ return epoch() != key; });
+        state.fetch_sub(1, std::memory_order_seq_cst);
+        return ret;
+    }
+
+    void notify( bool all = false )
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!(state.load(std::memory_order_relaxed) & WAITER_MASK))
+            return;
+        state.fetch_add(EPOCH_INC, std::memory_order_seq_cst);
+        // 等待方在锁内比较epoch，加一次锁保证不会在比较和睡眠之间错过通知
+        { boost::lock_guard<boost::mutex> lk(mtx); }
+        if (all)
+            cond.notify_all();
+        else
+            cond.notify_one();
+    }
+
+private:
+    static const uint64_t WAITER_MASK = 0xFFFFFFFFull;
+    static const uint64_t EPOCH_INC = 1ull << 32;
+
+    uint32_t epoch() const
+    { return (uint32_t)(state.load(std::memory_order_seq_cst) >> 32); }
+
+    std::atomic<uint64_t>         state;
+    boost::mutex                  mtx;
+    boost::condition_variable     cond;
+};
+
+
+/*
+ * 有界MPMC队列，Dmitry Vyukov的序号slot算法：
+ * slot.seq == pos      空闲，等待入队位置pos的生产者
+ * slot.seq == pos + 1  已写入，等待出队位置pos的消费者
+ * 出队后seq = pos + capacity，留给下一轮的生产者
+ * 生产者/消费者各自CAS一个位置计数器，除此之外互不干扰。
+ * push_bulk/pop_bulk 一次CAS认领连续的多个slot。
+ * 只在满/空时通过EventCount阻塞，接口与SharedQueue一致。
+ *
+ * T可以是只能move的类型，也可以有非平凡的析构函数；
+ * 要求move构造不抛异常（否则认领了的slot无法交还）；pop()还要求T可默认构造。
+ */
+template < typename T >
+class MpmcQueue {
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "MpmcQueue requires a nothrow move constructor");
+
+    struct Slot {
+        std::atomic<std::size_t>    seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type  storage;
+
+        T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+public:
+    explicit MpmcQueue( std::size_t _Capacity = 1024 )
+                : capacity(roundPow2(_Capacity)), mask(capacity - 1)
+                , slots(new Slot[capacity])
+                , enqPos(0), deqPos(0)
+    {
+        for (std::size_t i = 0; i < capacity; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue()
+    {
+        clear();
+        delete [] slots;
+    }
+
+    MpmcQueue( const MpmcQueue& ) = delete;
+    MpmcQueue& operator=( const MpmcQueue& ) = delete;
+
+    // 不阻塞，满了返回false，此时elem保持原样
+    bool try_push( T&& elem )
+    {
+        std::size_t pos;
+        if (!claimPush(pos, 1))
+            return false;
+        publish(pos, std::move(elem));
+        notEmpty.notify();
+        return true;
+    }
+
+    bool try_push( const T& elem )
+    {
+        T tmp(elem);
+        return try_push(std::move(tmp));
+    }
+
+    bool try_pop( T& retval )
+    {
+        std::size_t pos;
+        if (!claimPop(pos, 1))
+            return false;
+        consume(pos, [&]( T &&v ) { retval = std::move(v); });
+        notFull.notify();
+        return true;
+    }
+
+    void push( T&& elem )
+    {
+        for (int i = 0; i < YIELD_TRIES; ++i) {
+            if (try_push(std::move(elem)))
+                return;
+            std::this_thread::yield();
+        } // for
+        while (!try_push(std::move(elem))) {
+            uint32_t key = notFull.prepareWait();
+            if (try_push(std::move(elem))) {
+                notFull.cancelWait();
+                return;
+            } // if
+            notFull.wait(key);
+        } // while
+    }
+
+    void push( const T& elem )
+    {
+        T tmp(elem);
+        push(std::move(tmp));
+    }
+
+    void pop( T& retval )
+    {
+        for (int i = 0; i < YIELD_TRIES; ++i) {
+            if (try_pop(retval))
+                return;
+            std::this_thread::yield();
+        } // for
+        while (!try_pop(retval)) {
+            uint32_t key = notEmpty.prepareWait();
+            if (try_pop(retval)) {
+                notEmpty.cancelWait();
+                return;
+            } // if
+            notEmpty.wait(key);
+        } // while
+    }
+
+    T pop()
+    {
+        T retval;
+        this->pop( retval );
+        return retval;
+    }
+
+    // timeout单位毫秒，与SharedQueue相同
+    bool timed_push( T&& elem, std::size_t timeout )
+    {
+        auto deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(timeout);
+        while (!try_push(std::move(elem))) {
+            uint32_t key = notFull.prepareWait();
+            if (try_push(std::move(elem))) {
+                notFull.cancelWait();
+                return true;
+            } // if
+            if (!notFull.wait_until(key, deadline))
+                return try_push(std::move(elem));
+        } // while
+        return true;
+    }
+
+    bool timed_push( const T& elem, std::size_t timeout )
+    {
+        T tmp(elem);
+        return timed_push(std::move(tmp), timeout);
+    }
+
+    bool timed_pop( T& retval, std::size_t timeout )
+    {
+        auto deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(timeout);
+        while (!try_pop(retval)) {
+            uint32_t key = notEmpty.prepareWait();
+            if (try_pop(retval)) {
+                notEmpty.cancelWait();
+                return true;
+            } // if
+            if (!notEmpty.wait_until(key, deadline))
+                return try_pop(retval);
+        } // while
+        return true;
+    }
+
+    /*
+     * 从[first, last) move入队，尽量一次认领连续的多个slot。
+     * try_push_bulk 不阻塞，返回入队个数；push_bulk 全部入队才返回。
+     */
+    template < typename Iter >
+    std::size_t try_push_bulk( Iter first, Iter last )
+    {
+        std::size_t n = std::distance(first, last), done = 0;
+        while (done < n) {
+            std::size_t pos, k = claimPush(pos, n - done);
+            if (!k)
+                break;
+            for (std::size_t i = 0; i < k; ++i, ++first)
+                publish(pos + i, std::move(*first));
+            done += k;
+        } // while
+        if (done)
+            notEmpty.notify(done > 1);
+        return done;
+    }
+
+    template < typename Iter >
+    void push_bulk( Iter first, Iter last )
+    {
+        int tries = 0;
+        while (first != last) {
+            std::size_t k = try_push_bulk(first, last);
+            std::advance(first, k);
+            if (k || first == last)
+                continue;
+            if (tries++ < YIELD_TRIES) {
+                std::this_thread::yield();
+                continue;
+            } // if
+            uint32_t key = notFull.prepareWait();
+            k = try_push_bulk(first, last);
+            if (k) {
+                notFull.cancelWait();
+                std::advance(first, k);
+                continue;
+            } // if
+            notFull.wait(key);
+        } // while
+    }
+
+    /*
+     * 最多出队maxCount个，写到out（输出迭代器）。
+     * try_pop_bulk 不阻塞；pop_bulk 队列空时阻塞直到至少拿到一个。
+     */
+    template < typename OutIter >
+    std::size_t try_pop_bulk( OutIter out, std::size_t maxCount )
+    {
+        std::size_t done = 0;
+        while (done < maxCount) {
+            std::size_t pos, k = claimPop(pos, maxCount - done);
+            if (!k)
+                break;
+            for (std::size_t i = 0; i < k; ++i)
+                consume(pos + i, [&]( T &&v ) { *out = std::move(v); ++out; });
+            done += k;
+        } // while
+        if (done)
+            notFull.notify(done > 1);
+        return done;
+    }
+
+    template < typename OutIter >
+    std::size_t pop_bulk( OutIter out, std::size_t maxCount )
+    {
+        for (int tries = 0; ; ++tries) {
+            std::size_t k = try_pop_bulk(out, maxCount);
+            if (k || !maxCount)
+                return k;
+            if (tries < YIELD_TRIES) {
+                std::this_thread::yield();
+                continue;
+            } // if
+            uint32_t key = notEmpty.prepareWait();
+            k = try_pop_bulk(out, maxCount);
+            if (k) {
+                notEmpty.cancelWait();
+                return k;
+            } // if
+            notEmpty.wait(key);
+        } // for
+    }
+
+    void clear()
+    {
+        std::size_t pos;
+        while (claimPop(pos, 1))
+            consume(pos, []( T&& ) {});
+        notFull.notify(true);
+    }
+
+    // 并发时只是近似值
+    std::size_t size() const
+    {
+        std::size_t deq = deqPos.load(std::memory_order_relaxed);
+        std::size_t enq = enqPos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() >= capacity; }
+
+private:
+    // 阻塞前先让出几次CPU：对方往往马上就会push/pop，省掉一次睡眠和唤醒
+    static const int YIELD_TRIES = 16;
+
+    static std::size_t roundPow2( std::size_t n )
+    {
+        std::size_t ret = 2;
+        while (ret < n)
+            ret <<= 1;
+        return ret;
+    }
+
+    // 认领从pos开始最多want个连续的空闲slot，返回个数
+    std::size_t claimPush( std::size_t &pos, std::size_t want )
+    {
+        pos = enqPos.load(std::memory_order_relaxed);
+        while (true) {
+            std::size_t k = 0;
+            while (k < want && k < capacity) {
+                std::size_t seq = slots[(pos + k) & mask].seq.load(std::memory_order_acquire);
+                if (seq != pos + k)
+                    break;
+                ++k;
+            } // while
+            if (!k) {
+                std::size_t seq = slots[pos & mask].seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                if (dif < 0)
+                    return 0;       // 满
+                pos = enqPos.load(std::memory_order_relaxed);
+                continue;
+            } // if
+            if (enqPos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+                return k;
+        } // while
+    }
+
+    std::size_t claimPop( std::size_t &pos, std::size_t want )
+    {
+        pos = deqPos.load(std::memory_order_relaxed);
+        while (true) {
+            std::size_t k = 0;
+            while (k < want && k < capacity) {
+                std::size_t seq = slots[(pos + k) & mask].seq.load(std::memory_order_acquire);
+                if (seq != pos + k + 1)
+                    break;
+                ++k;
+            } // while
+            if (!k) {
+                std::size_t seq = slots[pos & mask].seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (dif < 0)
+                    return 0;       // 空
+                pos = deqPos.load(std::memory_order_relaxed);
+                continue;
+            } // if
+            if (deqPos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+                return k;
+        } // while
+    }
+
+    void publish( std::size_t pos, T&& elem )
+    {
+        Slot &slot = slots[pos & mask];
+        new (&slot.storage) T(std::move(elem));
+        slot.seq.store(pos + 1, std::memory_order_release);
+    }
+
+    // 先把元素move出来、交还slot，再交给sink；sink抛异常也不会卡住队列
+    template < typename Sink >
+    void consume( std::size_t pos, Sink sink )
+    {
+        Slot &slot = slots[pos & mask];
+        T tmp(std::move(*slot.value()));
+        slot.value()->~T();
+        slot.seq.store(pos + capacity, std::memory_order_release);
+        sink(std::move(tmp));
+    }
+
+private:
+    const std::size_t             capacity, mask;
+    Slot                          *slots;
+    char                          pad0[64];
+    std::atomic<std::size_t>      enqPos;
+    char                          pad1[64];
+    std::atomic<std::size_t>      deqPos;
+    char                          pad2[64];
+    EventCount                    notEmpty, notFull;
+};
+
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * MpmcQueue 对比 SharedQueue(shared_queue_condvar.cpp) 和 boost::lockfree::queue
+ * n个生产者、n个消费者，共传递total个元素，队列容量1024。
+ * boost::lockfree::queue 只能放平凡析构的类型，move-only的unique_ptr只比较前两个。
+ *
+ * c++ -o /tmp/mpmc_queue_bench mpmc_queue_bench.cpp -std=c++11 -O2 -pthread -lboost_thread -lboost_chrono -lboost_system
+ * usage: mpmc_queue_bench [total [max_threads]]
+ */
+#include "mpmc_queue.h"
+#include "shared_queue_condvar.cpp"
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define QUEUE_CAPACITY      1024
+#define BULK_SIZE           32
+
+using namespace std;
+
+static atomic<long long> g_checksum;
+
+// 每个生产者make(i)产生元素，每个消费者用value()取回数值累加，最后核对总和
+template < typename Producer, typename Consumer >
+static void run( const char *name, int n, int total, Producer producer, Consumer consumer )
+{
+    g_checksum = 0;
+    int perThread = total / n;
+    vector<thread> threads;
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        threads.emplace_back(producer, perThread);
+        threads.emplace_back(consumer, perThread);
+    } // for
+    for (auto &t : threads)
+        t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    long long items = (long long)perThread * n;
+    long long expect = (long long)n * perThread * (perThread - 1) / 2;
+    printf("  %-28s %2dP/%2dC: %7.2f Mops/s%s\n", name, n, n, items / secs / 1e6,
+            g_checksum == expect ? "" : "  CHECKSUM MISMATCH");
+}
+
+typedef unique_ptr<string> StrPtr;
+
+static StrPtr make_str( int i ) { return StrPtr(new string(to_string(i))); }
+static int str_value( const StrPtr &p ) { return atoi(p->c_str()); }
+
+int main( int argc, char **argv )
+{
+    int total = argc > 1 ? atoi(argv[1]) : 2000000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 16;
+
+    printf("int, %d items\n", total);
+    for (int n = 1; n <= maxThreads; n *= 2) {
+        {
+            SharedQueue<int> q(QUEUE_CAPACITY);
+            run("SharedQueue", n, total,
+                [&]( int cnt ) { for (int i = 0; i < cnt; ++i) q.push(i); },
+                [&]( int cnt ) { long long s = 0; for (int i = 0; i < cnt; ++i) s += q.pop(); g_checksum += s; });
+        }
+        {
+            boost::lockfree::queue<int, boost::lockfree::capacity<QUEUE_CAPACITY> > q;
+            run("boost::lockfree::queue", n, total,
+                [&]( int cnt ) { for (int i = 0; i < cnt; ++i) while (!q.push(i)) boost::this_thread::yield(); },
+                [&]( int cnt ) {
+                    long long s = 0;
+                    int v;
+                    for (int i = 0; i < cnt; ++i) {
+                        while (!q.pop(v))
+                            boost::this_thread::yield();
+                        s += v;
+                    } // for
+                    g_checksum += s;
+                });
+        }
+        {
+            MpmcQueue<int> q(QUEUE_CAPACITY);
+            run("MpmcQueue", n, total,
+                [&]( int cnt ) { for (int i = 0; i < cnt; ++i) q.push(i); },
+                [&]( int cnt ) { long long s = 0; for (int i = 0; i < cnt; ++i) s += q.pop(); g_checksum += s; });
+        }
+        {
+            MpmcQueue<int> q(QUEUE_CAPACITY);
+            run("MpmcQueue bulk " BOOST_STRINGIZE(BULK_SIZE), n, total,
+                [&]( int cnt ) {
+                    vector<int> batch;
+                    for (int i = 0; i < cnt; i += BULK_SIZE) {
+                        batch.clear();
+                        for (int j = i; j < cnt && j < i + BULK_SIZE; ++j)
+                            batch.push_back(j);
+                        q.push_bulk(batch.begin(), batch.end());
+                    } // for
+                },
+                [&]( int cnt ) {
+                    long long s = 0;
+                    int buf[BULK_SIZE];
+                    while (cnt > 0) {
+                        int k = q.pop_bulk(buf, min(cnt, BULK_SIZE));
+                        for (int j = 0; j < k; ++j)
+                            s += buf[j];
+                        cnt -= k;
+                    } // while
+                    g_checksum += s;
+                });
+        }
+    } // for
+
+    printf("unique_ptr<string>, %d items\n", total);
+    for (int n = 1; n <= maxThreads; n *= 2) {
+        {
+            SharedQueue<StrPtr> q(QUEUE_CAPACITY);
+            run("SharedQueue", n, total,
+                [&]( int cnt ) { for (int i = 0; i < cnt; ++i) q.push(make_str(i)); },
+                [&]( int cnt ) { long long s = 0; for (int i = 0; i < cnt; ++i) s += str_value(q.pop()); g_checksum += s; });
+        }
+        {
+            MpmcQueue<StrPtr> q(QUEUE_CAPACITY);
+            run("MpmcQueue", n, total,
+                [&]( int cnt ) { for (int i = 0; i < cnt; ++i) q.push(make_str(i)); },
+                [&]( int cnt ) { long long s = 0; for (int i = 0; i < cnt; ++i) s += str_value(q.pop()); g_checksum += s; });
+        }
+        {
+            MpmcQueue<StrPtr> q(QUEUE_CAPACITY);
+            run("MpmcQueue bulk " BOOST_STRINGIZE(BULK_SIZE), n, total,
+                [&]( int cnt ) {
+                    vector<StrPtr> batch;
+                    for (int i = 0; i < cnt; i += BULK_SIZE) {
+                        batch.clear();
+                        for (int j = i; j < cnt && j < i + BULK_SIZE; ++j)
+                            batch.push_back(make_str(j));
+                        q.push_bulk(batch.begin(), batch.end());
+                    } // for
+                },
+                [&]( int cnt ) {
+                    long long s = 0;
+                    vector<StrPtr> buf;
+                    while (cnt > 0) {
+                        buf.clear();
+                        int k = q.pop_bulk(back_inserter(buf), min(cnt, BULK_SIZE));
+                        for (auto &p : buf)
+                            s += str_value(p);
+                        cnt -= k;
+                    } // while
+                    g_checksum += s;
+                });
+        }
+    } // for
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/chrono.hpp>
 
+// 每次push/pop都要加锁并notify；有界的无锁替代见 mpmc_queue.h 的 MpmcQueue，接口相同
 template < typename T >
 class SharedQueue : private std::deque<T> {
     typedef typename std::deque<T>   BaseType;